@@ -0,0 +1,66 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_BOUNDEDQUEUE_H
+#define SEARCH_ENGINE_BOUNDEDQUEUE_H
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/* Потокобезопасная очередь ограниченной ёмкости между стадиями конвейера.
+ * push блокируется, пока очередь заполнена, pop - пока она пуста.
+ * После close() новые элементы не принимаются, а pop отдаёт остаток и затем nullopt.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : _capacity(capacity == 0 ? 1 : capacity) {}
+
+    // false, если очередь уже закрыта
+    bool push(T value) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_full.wait(lock, [this] { return _closed || _items.size() < _capacity; });
+        if (_closed) {
+            return false;
+        }
+        _items.push_back(std::move(value));
+        _not_empty.notify_one();
+        return true;
+    }
+
+    // nullopt - очередь закрыта и пуста
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_empty.wait(lock, [this] { return _closed || !_items.empty(); });
+        if (_items.empty()) {
+            return std::nullopt;
+        }
+        T value = std::move(_items.front());
+        _items.pop_front();
+        _not_full.notify_one();
+        return value;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _not_empty.notify_all();
+        _not_full.notify_all();
+    }
+
+private:
+    const size_t _capacity;
+    std::deque<T> _items;
+    bool _closed = false;
+    std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+};
+
+#endif //SEARCH_ENGINE_BOUNDEDQUEUE_H
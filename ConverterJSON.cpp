@@ -4,8 +4,256 @@
 
 #include "ConverterJSON.h"
 #include "SearchServer.h"
+#include "BoundedQueue.h"
+#include "UringLoader.h"
+#include "ParallelFor.h"
+#include <cmath>
+#include <thread>
 const std::string ConverterJSON::APP_VERSION = "1.0";
 
+namespace {
+
+/* SAX-обработчик requests.json. Разбирает только массив "requests" в корневом объекте,
+ * всё остальное пропускается без построения DOM.
+ */
+class RequestsSaxHandler : public nlohmann::json_sax<json> {
+public:
+    explicit RequestsSaxHandler(std::vector<std::string>& requests) : _requests(requests) {}
+
+    bool null() override { return _scalar(); }
+    bool boolean(bool) override { return _scalar(); }
+    bool number_integer(number_integer_t) override { return _scalar(); }
+    bool number_unsigned(number_unsigned_t) override { return _scalar(); }
+    bool number_float(number_float_t, const string_t&) override { return _scalar(); }
+    bool binary(binary_t&) override { return _scalar(); }
+
+    bool string(string_t& val) override {
+        if (_in_requests && _depth == 2) {
+            _requests.push_back(std::move(val));
+            return true;
+        }
+        return _scalar();
+    }
+
+    bool key(string_t& val) override {
+        if (_depth == 1) {
+            _requests_key = (val == "requests");
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        _container_value();
+        ++_depth;
+        return true;
+    }
+
+    bool end_object() override {
+        return _end_container();
+    }
+
+    bool start_array(std::size_t) override {
+        if (_depth == 1 && _requests_key) {
+            // Повторный ключ "requests" заменяет предыдущий, как и в DOM
+            _requests.clear();
+            _found = true;
+            _non_string = false;
+            _in_requests = true;
+            _requests_key = false;
+        } else {
+            _container_value();
+        }
+        ++_depth;
+        return true;
+    }
+
+    bool end_array() override {
+        return _end_container();
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        _error_message = ex.what();
+        return false;
+    }
+
+    RequestsParseStatus status() const {
+        if (!_error_message.empty()) {
+            return RequestsParseStatus::SyntaxError;
+        }
+        if (!_found) {
+            return RequestsParseStatus::MissingRequests;
+        }
+        return _non_string ? RequestsParseStatus::NonStringRequest : RequestsParseStatus::Ok;
+    }
+
+    const std::string& error_message() const { return _error_message; }
+
+private:
+    bool _scalar() {
+        if (_in_requests && _depth == 2) {
+            _non_string = true;
+        } else if (_depth == 1 && _requests_key) {
+            // "requests" есть, но это не массив
+            _found = false;
+            _requests_key = false;
+        }
+        return true;
+    }
+
+    void _container_value() {
+        if (_in_requests && _depth == 2) {
+            _non_string = true;
+        } else if (_depth == 1 && _requests_key) {
+            _found = false;
+            _requests_key = false;
+        }
+    }
+
+    bool _end_container() {
+        --_depth;
+        if (_in_requests && _depth == 1) {
+            _in_requests = false;
+        }
+        return true;
+    }
+
+    std::vector<std::string>& _requests;
+    std::string _error_message;
+    size_t _depth = 0;
+    bool _requests_key = false;
+    bool _in_requests = false;
+    bool _found = false;
+    bool _non_string = false;
+};
+
+/* SAX-обработчик config.json. Скалярные поля секции "config" собираются в маленький объект,
+ * строки массива "files" перемещаются прямо в список путей.
+ */
+class ConfigSaxHandler : public nlohmann::json_sax<json> {
+public:
+    ConfigSaxHandler(json& config, std::vector<std::string>& files) : _config(config), _files(files) {}
+
+    bool null() override { return _scalar(nullptr); }
+    bool boolean(bool val) override { return _scalar(val); }
+    bool number_integer(number_integer_t val) override { return _scalar(val); }
+    bool number_unsigned(number_unsigned_t val) override { return _scalar(val); }
+    bool number_float(number_float_t val, const string_t&) override { return _scalar(val); }
+    bool binary(binary_t&) override { return _scalar(nullptr); }
+
+    bool string(string_t& val) override {
+        if (_section == Section::Files && _depth == 2) {
+            _files.push_back(std::move(val));
+            return true;
+        }
+        return _scalar(std::move(val));
+    }
+
+    bool key(string_t& val) override {
+        if (_depth == 1) {
+            _root_key = std::move(val);
+        } else if (_depth == 2 && _section == Section::Config) {
+            _config_key = std::move(val);
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        if (_depth == 1 && _root_key == "config") {
+            _section = Section::Config;
+            _config = json::object();
+        } else {
+            _nested_value();
+        }
+        ++_depth;
+        return true;
+    }
+
+    bool end_object() override {
+        return _end_container();
+    }
+
+    bool start_array(std::size_t) override {
+        if (_depth == 1 && _root_key == "files") {
+            _section = Section::Files;
+            _files.clear();
+            _has_files = true;
+        } else {
+            _nested_value();
+        }
+        ++_depth;
+        return true;
+    }
+
+    bool end_array() override {
+        return _end_container();
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        _error_message = ex.what();
+        return false;
+    }
+
+    bool has_files() const { return _has_files; }
+    bool non_string_files() const { return _non_string_files; }
+
+private:
+    enum class Section { None, Config, Files };
+
+    template <typename T>
+    bool _scalar(T&& val) {
+        if (_section == Section::Config && _depth == 2) {
+            _config[_config_key] = std::forward<T>(val);
+        } else if (_section == Section::Files && _depth == 2) {
+            _non_string_files = true;
+        } else if (_depth == 1 && _root_key == "config") {
+            // "config": null или скаляр - секция считается пустой
+            _config = nullptr;
+        }
+        return true;
+    }
+
+    void _nested_value() {
+        if (_section == Section::Files && _depth == 2) {
+            _non_string_files = true;
+        } else if (_depth == 1 && _root_key == "config") {
+            _config = nullptr;
+        }
+        // Вложенные объекты внутри "config" не используются и пропускаются
+    }
+
+    bool _end_container() {
+        --_depth;
+        if (_depth == 1) {
+            _section = Section::None;
+        }
+        return true;
+    }
+
+    json& _config;
+    std::vector<std::string>& _files;
+    std::string _error_message;
+    std::string _root_key;
+    std::string _config_key;
+    Section _section = Section::None;
+    size_t _depth = 0;
+    bool _has_files = false;
+    bool _non_string_files = false;
+};
+
+// Потоков на ядро самое большее - больше из настроек не берётся
+constexpr size_t MAX_THREADS_PER_CORE = 4;
+
+/* Число потоков из настройки key: отрицательное значение заменяется на default_value,
+* слишком большое урезается до MAX_THREADS_PER_CORE на ядро. 0 (по числу ядер) остаётся как есть.
+*/
+size_t threads_setting(const json& config, const char* key, int64_t default_value) {
+    const int64_t value = config.value(key, default_value);
+    const size_t limit = MAX_THREADS_PER_CORE * ResolveThreadsCount(0);
+    return std::min(value < 0 ? (size_t)default_value : (size_t)value, limit);
+}
+
+} // namespace
+
 ConverterJSON::ConverterJSON(
     const std::string& config_path,
     const std::string& requests_path,
@@ -25,22 +273,19 @@ void ConverterJSON::system_load_config() {
     }
 
     std::ifstream config_file(m_config_path);
-    json data;
-    try {
-        data = json::parse(config_file);
-    } catch (json::parse_error& e) {
+    std::vector<std::string> listed_files;
+    ConfigSaxHandler handler(m_config_data, listed_files);
+    if (!json::sax_parse(config_file, &handler)) {
         throw std::runtime_error("Error decoding JSON from " + m_config_path);
     }
 
-    if (!data.contains("config") || data["config"].is_null()) {
+    if (!m_config_data.is_object()) {
         throw std::runtime_error("config file is empty");
     }
 
-    auto& config_data = data["config"];
-
-    m_name = config_data.value("name", "");
-    m_version = config_data.value("version", "");
-    m_max_responses = config_data.value("max_responses", 5);
+    m_name = m_config_data.value("name", "");
+    m_version = m_config_data.value("version", "");
+    m_max_responses = m_config_data.value("max_responses", 5);
 
     if (!m_name.empty()) {
         std::cout << "Starting " << m_name << "..." << std::endl;
@@ -56,11 +301,13 @@ void ConverterJSON::system_load_config() {
     }
 
     // Загрузка и проверка путей к файлам
-    if (data.contains("files") && data["files"].is_array()) {
-        for (const auto& file_path_json : data["files"]) {
-            std::string file_path = file_path_json.get<std::string>();
+    if (handler.non_string_files()) {
+        throw std::runtime_error("config.json 'files' field contains non-string elements");
+    }
+    if (handler.has_files()) {
+        for (std::string& file_path : listed_files) {
             if (fs::exists(file_path)) {
-                m_file_paths.push_back(file_path);
+                m_file_paths.push_back(std::move(file_path));
             } else {
                 std::cerr << "Error: File not found (skipping): " << file_path << std::endl;
             }
@@ -76,11 +323,8 @@ void ConverterJSON::system_load_config() {
 std::vector<std::string> ConverterJSON::GetTextDocuments() {
     std::vector<std::string> documents;
 
-    // Используем m_config_data, загруженную и проверенную в конструкторе
-    const auto& files_array = m_config_data.at("files");
-
-    for (const auto& file_path_json : files_array) {
-        std::string file_path = file_path_json.get<std::string>();
+    // Используем пути, загруженные и проверенные в конструкторе
+    for (const std::string& file_path : m_file_paths) {
         std::ifstream document_file(file_path);
 
         // Проверка существования файла
@@ -98,11 +342,92 @@ std::vector<std::string> ConverterJSON::GetTextDocuments() {
     return documents;
 }
 
+std::vector<DocumentBuffer> ConverterJSON::LoadTextDocuments(size_t threads_count) {
+    if (m_config_data.value("io_backend", "mmap") == "uring") {
+        return UringLoader::LoadDocuments(m_file_paths, UringLoader::DEFAULT_QUEUE_DEPTH, threads_count);
+    }
+    return DocumentLoader::LoadDocuments(m_file_paths, threads_count);
+}
+
 int ConverterJSON::GetResponsesLimit() {
     // Возвращаю значение config.json
     return m_max_responses;
 }
 
+RequestsParseStatus ConverterJSON::ParseRequestsSax(std::istream& input, std::vector<std::string>& requests,
+                                                    std::string& error_message) {
+    requests.clear();
+    RequestsSaxHandler handler(requests);
+    json::sax_parse(input, &handler);
+
+    RequestsParseStatus status = handler.status();
+    if (status != RequestsParseStatus::Ok) {
+        error_message = handler.error_message();
+        requests.clear();
+    }
+    return status;
+}
+
+RequestsParseStatus ConverterJSON::ParseRequestsDom(std::istream& input, std::vector<std::string>& requests,
+                                                    std::string& error_message) {
+    requests.clear();
+    json data;
+    try {
+        data = json::parse(input);
+    } catch (json::parse_error& e) {
+        error_message = e.what();
+        return RequestsParseStatus::SyntaxError;
+    }
+
+    if (!data.contains("requests") || !data["requests"].is_array()) {
+        return RequestsParseStatus::MissingRequests;
+    }
+    try {
+        requests = data["requests"].get<std::vector<std::string>>();
+    } catch (const std::exception& e) {
+        return RequestsParseStatus::NonStringRequest;
+    }
+    return RequestsParseStatus::Ok;
+}
+
+size_t ConverterJSON::GetIndexMemoryBudget() const {
+    const double budget_mb = m_config_data.value("index_memory_budget_mb", 0.0);
+    return budget_mb > 0 ? (size_t)(budget_mb * 1024 * 1024) : 0;
+}
+
+size_t ConverterJSON::GetMaxTermExpansions() const {
+    const int expansions = m_config_data.value("max_term_expansions", 128);
+    return expansions > 0 ? (size_t)expansions : 1;
+}
+
+bool ConverterJSON::GetFuzzySearch() const {
+    return m_config_data.value("fuzzy_search", false);
+}
+
+bool ConverterJSON::GetStemming() const {
+    return m_config_data.value("stemming", false);
+}
+
+std::string ConverterJSON::GetRanking() const {
+    return m_config_data.value("ranking", std::string("count"));
+}
+
+size_t ConverterJSON::GetIndexShards() const {
+    return threads_setting(m_config_data, "index_shards", 1);
+}
+
+size_t ConverterJSON::GetQueryThreads() const {
+    return threads_setting(m_config_data, "query_threads", 1);
+}
+
+size_t ConverterJSON::GetIndexingThreads() const {
+    return threads_setting(m_config_data, "indexing_threads", 0);
+}
+
+size_t ConverterJSON::GetImpactBits() const {
+    return m_config_data.value("impact_bits", 0u);
+}
+
 //Метод возвращает список запросов из файла requests.json
 std::vector<std::string> ConverterJSON::GetRequests() {
     std::vector<std::string> requests_list;
@@ -113,30 +438,71 @@ std::vector<std::string> ConverterJSON::GetRequests() {
     }
 
     std::ifstream requests_file(m_requests_path);
-    json data;
-    try {
-        data = json::parse(requests_file);
-    } catch (json::parse_error& e) {
-        std::cerr << "Error decoding JSON from " << m_requests_path << ": " << e.what() << std::endl;
-        return requests_list;
-    }
-
-    if (data.contains("requests") && data["requests"].is_array()) {
-        try {
-            requests_list = data["requests"].get<std::vector<std::string>>();
-        } catch (const std::exception& e) {
+    std::string error_message;
+    switch (ParseRequestsSax(requests_file, requests_list, error_message)) {
+        case RequestsParseStatus::Ok:
+            break;
+        case RequestsParseStatus::SyntaxError:
+            std::cerr << "Error decoding JSON from " << m_requests_path << ": " << error_message << std::endl;
+            return requests_list;
+        case RequestsParseStatus::NonStringRequest:
             std::cerr << "Error: 'requests' field in " << m_requests_path
                       << " contains non-string elements. Skipping processing." << std::endl;
-        }
-    } else {
-        std::cerr << "Warning: " << m_requests_path
-                  << " is missing the 'requests' array." << std::endl;
+            break;
+        case RequestsParseStatus::MissingRequests:
+            std::cerr << "Warning: " << m_requests_path
+                      << " is missing the 'requests' array." << std::endl;
+            break;
     }
 
     std::cout << "Loaded " << requests_list.size() << " request(s) from " << m_requests_path << std::endl;
     return requests_list;
 }
 
+std::string ConverterJSON::_make_request_id(size_t request_number) {
+    std::string request_id = "request";
+    request_id += (request_number < 10 ? "00" : (request_number < 100 ? "0" : "")) + std::to_string(request_number);
+    return request_id;
+}
+
+double ConverterJSON::_truncate_rank(float rank) {
+    // std::to_string даёт 6 знаков с округлением, затем строка обрезалась до трёх
+    const long long millionths = std::llround((double)rank * 1e6);
+    return (double)(millionths / 1000) / 1000.0;
+}
+
+json ConverterJSON::_make_answer_entry(const std::vector<RelativeIndex>& query_results, int max_responses) {
+    json request_entry;
+
+    if (query_results.empty()) {
+        request_entry["result"] = "false";
+    } else {
+        request_entry["result"] = "true";
+
+        // Ограничиваем количество ответов
+        size_t limit = std::min((size_t)max_responses, query_results.size());
+        if (limit == 1) {
+            const auto& match = query_results[0];
+            request_entry["docid"] = match.doc_id;
+            request_entry["rank"] = _truncate_rank(match.rank);
+        }
+        // Если найдено > 1 ответа, используем "relevance"
+        else if (limit > 1) {
+            json relevance_array = json::array();
+
+            for (size_t i = 0; i < limit; ++i) {
+                const auto& match = query_results[i];
+                relevance_array.push_back({
+                    {"docid", match.doc_id},
+                    {"rank", _truncate_rank(match.rank)}
+                });
+            }
+            request_entry["relevance"] = relevance_array;
+        }
+    }
+    return request_entry;
+}
+
 void ConverterJSON::putAnswers(const std::vector<std::vector<RelativeIndex>>& search_results) {
     json root_answers;
     json answers_obj;
@@ -145,42 +511,7 @@ void ConverterJSON::putAnswers(const std::vector<std::vector<RelativeIndex>>& se
     int max_responses = GetResponsesLimit();
 
     for (const auto& query_results : search_results) {
-        std::string request_id = "request";
-        request_id+= (request_id_counter < 10 ? "00" : (request_id_counter < 100 ? "0" : "")) + std::to_string(request_id_counter++);
-
-        json request_entry;
-
-        if (query_results.empty()) {
-            request_entry["result"] = "false";
-        } else {
-            request_entry["result"] = "true";
-
-            // Ограничиваем количество ответов
-            size_t limit = std::min((size_t)max_responses, query_results.size());
-            if (limit == 1) {
-                const auto& match = query_results[0];
-                request_entry["docid"] = match.doc_id;
-                request_entry["rank"] = std::stod(std::to_string(match.rank).substr(0, std::to_string(match.rank).find('.') + 4));
-            }
-            // Если найдено > 1 ответа, используем "relevance"
-            else if (limit > 1) {
-                json relevance_array = json::array();
-
-                for (size_t i = 0; i < limit; ++i) {
-                    const auto& match = query_results[i];
-                    std::string rank_str = std::to_string(match.rank);
-                    double formatted_rank = std::stod(rank_str.substr(0, rank_str.find('.') + 4));
-
-                    relevance_array.push_back({
-                        {"docid", match.doc_id},
-                        {"rank", formatted_rank}
-                    });
-                }
-                request_entry["relevance"] = relevance_array;
-            }
-        }
-
-        answers_obj[request_id] = request_entry;
+        answers_obj[_make_request_id(request_id_counter++)] = _make_answer_entry(query_results, max_responses);
     }
 
     root_answers["answers"] = answers_obj;
@@ -192,4 +523,102 @@ void ConverterJSON::putAnswers(const std::vector<std::vector<RelativeIndex>>& se
     } catch (const std::exception& e) {
         std::cerr << "Error writing file " << m_answers_path << ": " << e.what() << std::endl;
     }
-}
\ No newline at end of file
+}
+
+bool ConverterJSON::IsRequestStream() const {
+    return fs::path(m_requests_path).extension() == ".jsonl";
+}
+
+size_t ConverterJSON::StreamAnswers(SearchServer& server, size_t workers_count, size_t queue_capacity) {
+    std::ifstream requests_file(m_requests_path);
+    if (!requests_file.is_open()) {
+        std::cerr << "Error: " << m_requests_path << " not found." << std::endl;
+        return 0;
+    }
+
+    std::ofstream answers_file(m_answers_path);
+    if (!answers_file.is_open()) {
+        std::cerr << "Error writing file " << m_answers_path << std::endl;
+        return 0;
+    }
+
+    if (workers_count == 0) {
+        workers_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    struct PendingRequest {
+        size_t number;
+        std::string query;
+    };
+    struct ReadyAnswer {
+        size_t number;
+        std::vector<RelativeIndex> results;
+    };
+
+    BoundedQueue<PendingRequest> requests_queue(queue_capacity);
+    BoundedQueue<ReadyAnswer> answers_queue(queue_capacity);
+    const int max_responses = GetResponsesLimit();
+
+    // 1. Поисковые потоки: забирают запрос, ищут, отдают ответ писателю
+    std::vector<std::thread> workers;
+    workers.reserve(workers_count);
+    for (size_t i = 0; i < workers_count; ++i) {
+        workers.emplace_back([&server, &requests_queue, &answers_queue] {
+            while (auto request = requests_queue.pop()) {
+                answers_queue.push({request->number, server.search_one(request->query)});
+            }
+        });
+    }
+
+    // 2. Писатель: каждая строка ответа сбрасывается на диск сразу, как только готова
+    size_t written = 0;
+    std::thread writer([&] {
+        while (auto answer = answers_queue.pop()) {
+            json line;
+            line[_make_request_id(answer->number)] = _make_answer_entry(answer->results, max_responses);
+            answers_file << line.dump() << std::endl;
+            ++written;
+        }
+    });
+
+    // 3. Чтение запросов в текущем потоке. Строка - это JSON-строка или объект {"request": "..."}
+    std::string line;
+    size_t line_number = 0;
+    size_t request_number = 0;
+    while (std::getline(requests_file, line)) {
+        ++line_number;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::string query;
+        try {
+            json request = json::parse(line);
+            if (request.is_string()) {
+                query = request.get<std::string>();
+            } else if (request.is_object() && request.contains("request") && request["request"].is_string()) {
+                query = request["request"].get<std::string>();
+            } else {
+                std::cerr << "Warning: " << m_requests_path << ":" << line_number
+                          << " is not a request string. Skipping." << std::endl;
+                continue;
+            }
+        } catch (json::parse_error& e) {
+            std::cerr << "Error decoding JSON from " << m_requests_path << ":" << line_number
+                      << ": " << e.what() << std::endl;
+            continue;
+        }
+
+        requests_queue.push({++request_number, std::move(query)});
+    }
+
+    requests_queue.close();
+    for (auto& t : workers) {
+        t.join();
+    }
+    answers_queue.close();
+    writer.join();
+
+    std::cout << "Streamed " << written << " answer(s) to " << m_answers_path << std::endl;
+    return written;
+}
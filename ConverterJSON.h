@@ -13,8 +13,10 @@
 #include <filesystem>
 #include <fstream>
 #include "nlohmann_json\include\nlohmann\json.hpp"
+#include "DocumentLoader.h"
 
 class RelativeIndex; //предварительная декларация
+class SearchServer;
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
@@ -24,6 +26,14 @@ struct DocumentRank {
     double rank;    //ранг
 };
 
+// Результат разбора requests.json
+enum class RequestsParseStatus {
+    Ok,
+    SyntaxError,        // некорректный JSON
+    MissingRequests,    // нет массива "requests"
+    NonStringRequest    // в массиве есть не строки
+};
+
 struct RequestAnswer {
     std::string request_id;              // "request001", "request002" и т.п.
     bool result = false;                 // если найден файл
@@ -40,21 +50,83 @@ class ConverterJSON {
 
     std::vector<std::string> GetTextDocuments();
 
+    /* Параллельная загрузка документов через mmap/pread. Буферы передаются в индекс без копирования.
+    * При "io_backend": "uring" в секции config файлы читаются пакетно через io_uring.
+    */
+    std::vector<DocumentBuffer> LoadTextDocuments(size_t threads_count = 0);
+
     int GetResponsesLimit();
 
+    // Бюджет памяти индексации в байтах из "index_memory_budget_mb" (0 - строить индекс целиком в памяти)
+    size_t GetIndexMemoryBudget() const;
+
+    // Предел раскрытия шаблона запроса (capit*) из "max_term_expansions", по умолчанию 128
+    size_t GetMaxTermExpansions() const;
+
+    // "fuzzy_search": true - слова, которых нет в индексе, ищутся с учётом опечаток
+    bool GetFuzzySearch() const;
+
+    // "stemming": true - индексировать и искать по основам слов (русский и английский)
+    bool GetStemming() const;
+
+    // "ranking": формула релевантности - "count" (по умолчанию), "tfidf", "bm25" или "impact"
+    std::string GetRanking() const;
+
+    // "index_shards": на сколько независимых шардов делить индекс (0 - по числу ядер), по умолчанию 1.
+    // Ограничения те же, что у "query_threads": шарды строятся и опрашиваются параллельно
+    size_t GetIndexShards() const;
+
+    // "query_threads": потоков на один запрос (0 - по числу ядер), по умолчанию 1.
+    // Отрицательное значение - по умолчанию, больше 4 потоков на ядро не берётся
+    size_t GetQueryThreads() const;
+
+    // "indexing_threads": потоков индексации (0 - по числу ядер, по умолчанию); у шардов - на все шарды.
+    // Ограничения те же, что у "query_threads"
+    size_t GetIndexingThreads() const;
+
+    // "impact_bits": 8 или 16 - квантовать вклады BM25 при индексации (для "ranking": "impact"), 0 - нет
+    size_t GetImpactBits() const;
+
     std::vector<std::string> GetRequests();
 
+    /* Событийный (SAX) разбор {"requests": [...]}: DOM не строится,
+    * строки запросов перемещаются из парсера прямо в requests.
+    */
+    static RequestsParseStatus ParseRequestsSax(std::istream& input, std::vector<std::string>& requests,
+                                                std::string& error_message);
+
+    // Прежний разбор через DOM nlohmann::json, оставлен для сравнения в бенчмарке
+    static RequestsParseStatus ParseRequestsDom(std::istream& input, std::vector<std::string>& requests,
+                                                std::string& error_message);
+
     void putAnswers(const std::vector<std::vector<RelativeIndex>>& search_results);
+
+    // true, если запросы заданы построчно в формате JSONL (*.jsonl)
+    bool IsRequestStream() const;
+
+    /* Потоковая обработка JSONL: чтение по строке -> поиск в workers_count потоках -> запись ответа.
+    * Стадии связаны очередями ёмкостью queue_capacity, поэтому память не зависит от длины потока.
+    * Ответы пишутся в m_answers_path по одному JSON-объекту на строку в порядке готовности.
+    * Возвращает количество записанных ответов.
+    */
+    size_t StreamAnswers(SearchServer& server, size_t workers_count = 0, size_t queue_capacity = 64);
 private:
     void system_load_config();
 
+    static std::string _make_request_id(size_t request_number);
+
+    static json _make_answer_entry(const std::vector<RelativeIndex>& query_results, int max_responses);
+
+    // rank с тремя знаками после запятой (отбрасыванием, как у std::to_string с обрезкой строки), без строк
+    static double _truncate_rank(float rank);
+
     static const std::string APP_VERSION;
 
     const std::string APPLICATION_VERSION = "1.0";
     const std::string CONFIG_PATH = "config.json";
     const std::string REQUESTS_PATH = "requests.json";
 
-    nlohmann::json m_config_data;
+    nlohmann::json m_config_data; // Скалярные поля секции "config"
     // Пути к файлам
     std::string m_config_path;
     std::string m_requests_path;
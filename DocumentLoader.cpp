@@ -0,0 +1,144 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "DocumentLoader.h"
+#include "ParallelFor.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SEARCH_ENGINE_POSIX_IO 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+DocumentBuffer::~DocumentBuffer() {
+    _release();
+}
+
+DocumentBuffer::DocumentBuffer(DocumentBuffer&& other) noexcept {
+    *this = std::move(other);
+}
+
+DocumentBuffer& DocumentBuffer::operator=(DocumentBuffer&& other) noexcept {
+    if (this != &other) {
+        _release();
+        _mapped = other._mapped;
+        _loaded = other._loaded;
+        _size = other._size;
+        if (_mapped) {
+            _data = other._data;
+        } else {
+            // При перемещении std::string короткая строка копируется, поэтому указатель берём заново
+            _owned = std::move(other._owned);
+            _data = _owned.data();
+        }
+        other._data = nullptr;
+        other._size = 0;
+        other._mapped = false;
+        other._loaded = false;
+    }
+    return *this;
+}
+
+void DocumentBuffer::_release() {
+#ifdef SEARCH_ENGINE_POSIX_IO
+    if (_mapped && _data != nullptr) {
+        munmap(const_cast<char*>(_data), _size);
+    }
+#endif
+    _owned.clear();
+    _data = nullptr;
+    _size = 0;
+    _mapped = false;
+}
+
+DocumentBuffer DocumentBuffer::FromString(std::string text) {
+    DocumentBuffer buffer;
+    buffer._owned = std::move(text);
+    buffer._data = buffer._owned.data();
+    buffer._size = buffer._owned.size();
+    buffer._loaded = true;
+    return buffer;
+}
+
+DocumentBuffer DocumentBuffer::FromFile(const std::string& path) {
+#ifdef SEARCH_ENGINE_POSIX_IO
+    DocumentBuffer buffer;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return buffer;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return buffer;
+    }
+    const size_t file_size = (size_t)st.st_size;
+
+    if (file_size >= DocumentLoader::MMAP_THRESHOLD) {
+        void* region = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (region != MAP_FAILED) {
+            madvise(region, file_size, MADV_SEQUENTIAL);
+            close(fd);
+            buffer._data = static_cast<const char*>(region);
+            buffer._size = file_size;
+            buffer._mapped = true;
+            buffer._loaded = true;
+            return buffer;
+        }
+    }
+
+    // Мелкий файл (или mmap не удался) - читаем целиком крупными pread
+    std::string text(file_size, '\0');
+    size_t done = 0;
+    while (done < file_size) {
+        ssize_t n = pread(fd, text.data() + done, file_size - done, (off_t)done);
+        if (n < 0) {
+            close(fd);
+            return buffer;
+        }
+        if (n == 0) {
+            break; // файл укоротился во время чтения
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    text.resize(done);
+    return FromString(std::move(text));
+#else
+    std::ifstream document_file(path, std::ios::binary);
+    if (!document_file.is_open()) {
+        return {};
+    }
+    std::stringstream ss;
+    ss << document_file.rdbuf();
+    return FromString(ss.str());
+#endif
+}
+
+std::vector<DocumentBuffer> DocumentLoader::LoadDocuments(const std::vector<std::string>& paths,
+                                                          size_t threads_count) {
+    std::vector<DocumentBuffer> loaded(paths.size());
+
+    ParallelFor(paths.size(), threads_count, [&](size_t i) {
+        loaded[i] = DocumentBuffer::FromFile(paths[i]);
+    });
+
+    std::vector<DocumentBuffer> documents;
+    documents.reserve(loaded.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        if (!loaded[i].is_loaded()) {
+            std::cerr << "Warning: File not found at path: " << paths[i]
+                      << ". Skipping this document." << std::endl;
+            continue;
+        }
+        documents.push_back(std::move(loaded[i]));
+    }
+    return documents;
+}
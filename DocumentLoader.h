@@ -0,0 +1,62 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_DOCUMENTLOADER_H
+#define SEARCH_ENGINE_DOCUMENTLOADER_H
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Текст документа без лишних копий: либо отображённый в память файл (mmap),
+ * либо собственный буфер в куче. Только перемещение - владелец один.
+ */
+class DocumentBuffer {
+public:
+    DocumentBuffer() = default;
+    ~DocumentBuffer();
+
+    DocumentBuffer(DocumentBuffer&& other) noexcept;
+    DocumentBuffer& operator=(DocumentBuffer&& other) noexcept;
+    DocumentBuffer(const DocumentBuffer&) = delete;
+    DocumentBuffer& operator=(const DocumentBuffer&) = delete;
+
+    static DocumentBuffer FromString(std::string text);
+
+    // Отображает файл в память (или читает его, если mmap недоступен). is_loaded() == false при ошибке.
+    static DocumentBuffer FromFile(const std::string& path);
+
+    bool is_loaded() const { return _loaded; }
+
+    std::string_view view() const { return {_data, _size}; }
+
+    size_t size() const { return _size; }
+
+private:
+    void _release();
+
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool _mapped = false;  // _data указывает на mmap-область
+    bool _loaded = false;
+    std::string _owned;    // содержимое для прочитанных и переданных строкой документов
+};
+
+class DocumentLoader {
+public:
+    /* Параллельно загружает файлы на пуле из threads_count потоков (0 - по числу ядер).
+    * Большие файлы отображаются через mmap, мелкие читаются одним pread.
+    * Незагруженные файлы пропускаются с предупреждением, порядок остальных сохраняется.
+    */
+    static std::vector<DocumentBuffer> LoadDocuments(const std::vector<std::string>& paths,
+                                                     size_t threads_count = 0);
+
+    // Файлы меньше этого размера читаются в кучу: mmap для них дороже из-за page fault'ов
+    static constexpr size_t MMAP_THRESHOLD = 64 * 1024;
+};
+
+#endif //SEARCH_ENGINE_DOCUMENTLOADER_H
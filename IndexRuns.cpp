@@ -0,0 +1,128 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "IndexRuns.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t IO_BUFFER_SIZE = 1 << 20;
+
+} // namespace
+
+void RunWriter::Write(const std::filesystem::path& path, std::vector<RunRecord>& records) {
+    std::sort(records.begin(), records.end());
+    RunWriter writer(path);
+    for (const RunRecord& record : records) {
+        writer.Append(record);
+    }
+    writer.Close();
+}
+
+RunWriter::RunWriter(const std::filesystem::path& path) : _path(path), _buffer(IO_BUFFER_SIZE) {
+    _output.rdbuf()->pubsetbuf(_buffer.data(), (std::streamsize)_buffer.size());
+    _output.open(path, std::ios::binary | std::ios::trunc);
+    if (!_output.is_open()) {
+        throw std::runtime_error("Cannot create index run file " + path.string());
+    }
+}
+
+void RunWriter::Append(const RunRecord& record) {
+    const auto length = (uint32_t)record.word.size();
+    const auto doc_id = (uint64_t)record.doc_id;
+    const auto count = (uint64_t)record.count;
+    _output.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    _output.write(record.word.data(), length);
+    _output.write(reinterpret_cast<const char*>(&doc_id), sizeof(doc_id));
+    _output.write(reinterpret_cast<const char*>(&count), sizeof(count));
+}
+
+void RunWriter::Close() {
+    _output.close();
+    if (!_output) {
+        throw std::runtime_error("Error writing index run file " + _path.string());
+    }
+}
+
+RunReader::RunReader(const std::filesystem::path& path) : _buffer(IO_BUFFER_SIZE) {
+    _input.rdbuf()->pubsetbuf(_buffer.data(), (std::streamsize)_buffer.size());
+    _input.open(path, std::ios::binary);
+    if (!_input.is_open()) {
+        throw std::runtime_error("Cannot open index run file " + path.string());
+    }
+}
+
+bool RunReader::Next(RunRecord& record) {
+    uint32_t length = 0;
+    if (!_input.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+        return false;
+    }
+    uint64_t doc_id = 0;
+    uint64_t count = 0;
+    record.word.resize(length);
+    _input.read(record.word.data(), length);
+    _input.read(reinterpret_cast<char*>(&doc_id), sizeof(doc_id));
+    _input.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!_input) {
+        throw std::runtime_error("Index run file is truncated");
+    }
+    record.doc_id = (size_t)doc_id;
+    record.count = (size_t)count;
+    return true;
+}
+
+RunMerger::RunMerger(const std::vector<std::filesystem::path>& paths) : _heads(paths.size()) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+        _readers.push_back(std::make_unique<RunReader>(paths[i]));
+        if (_readers[i]->Next(_heads[i])) {
+            _heap.push_back(i);
+        }
+    }
+    std::make_heap(_heap.begin(), _heap.end(), [this](size_t a, size_t b) { return _heads[b] < _heads[a]; });
+}
+
+bool RunMerger::Next(RunRecord& record) {
+    if (_heap.empty()) {
+        return false;
+    }
+    auto greater = [this](size_t a, size_t b) { return _heads[b] < _heads[a]; };
+    std::pop_heap(_heap.begin(), _heap.end(), greater);
+    const size_t run = _heap.back();
+    std::swap(record, _heads[run]);
+    if (_readers[run]->Next(_heads[run])) {
+        std::push_heap(_heap.begin(), _heap.end(), greater);
+    } else {
+        _heap.pop_back();
+    }
+    return true;
+}
+
+void RunMerger::Reduce(std::vector<std::filesystem::path>& runs, size_t max_fan_in,
+                       const std::function<std::filesystem::path()>& make_path) {
+    max_fan_in = std::max<size_t>(2, max_fan_in);
+    // Сливаются самые старые прогоны, результат встаёт в конец: каждый проход уменьшает число на max_fan_in - 1
+    size_t first = 0;
+    while (runs.size() - first > max_fan_in) {
+        const std::vector<std::filesystem::path> group(runs.begin() + (std::ptrdiff_t)first,
+                                                       runs.begin() + (std::ptrdiff_t)(first + max_fan_in));
+        std::filesystem::path output = make_path();
+        {
+            RunMerger merger(group);
+            RunWriter writer(output);
+            RunRecord record;
+            while (merger.Next(record)) {
+                writer.Append(record);
+            }
+            writer.Close();
+        }
+        for (const auto& path : group) {
+            std::filesystem::remove(path);
+        }
+        first += max_fan_in;
+        runs.push_back(std::move(output));
+    }
+    runs.erase(runs.begin(), runs.begin() + (std::ptrdiff_t)first);
+}
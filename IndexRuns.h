@@ -0,0 +1,90 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_INDEXRUNS_H
+#define SEARCH_ENGINE_INDEXRUNS_H
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Одна тройка (слово, документ, частота) во временном файле внешней сортировки
+struct RunRecord {
+    std::string word;
+    size_t doc_id = 0;
+    size_t count = 0;
+
+    bool operator<(const RunRecord& other) const {
+        int cmp = word.compare(other.word);
+        return cmp < 0 || (cmp == 0 && doc_id < other.doc_id);
+    }
+
+    // Приблизительный объём в памяти - для учёта бюджета
+    size_t memory_usage() const {
+        return sizeof(RunRecord) + (word.capacity() > 15 ? word.capacity() + 1 : 0);
+    }
+};
+
+/* Отсортированный по (слово, doc_id) прогон, сброшенный на диск.
+ * Формат записи: u32 длина слова, байты слова, u64 doc_id, u64 count.
+ */
+class RunWriter {
+public:
+    // Сортирует records и пишет их в path. Бросает std::runtime_error при ошибке записи.
+    static void Write(const std::filesystem::path& path, std::vector<RunRecord>& records);
+
+    // Потоковая запись уже упорядоченных записей
+    explicit RunWriter(const std::filesystem::path& path);
+
+    void Append(const RunRecord& record);
+
+    // Бросает std::runtime_error, если что-то не записалось
+    void Close();
+
+private:
+    std::filesystem::path _path;
+    std::vector<char> _buffer; // объявлен раньше потока: поток использует его до своего разрушения
+    std::ofstream _output;
+};
+
+// Последовательное чтение прогона с буферизацией
+class RunReader {
+public:
+    explicit RunReader(const std::filesystem::path& path);
+
+    // false - прогон закончился
+    bool Next(RunRecord& record);
+
+private:
+    std::vector<char> _buffer; // объявлен раньше потока: поток использует его до своего разрушения
+    std::ifstream _input;
+};
+
+// k-путевое слияние прогонов: записи выдаются по возрастанию (слово, doc_id)
+class RunMerger {
+public:
+    explicit RunMerger(const std::vector<std::filesystem::path>& paths);
+
+    // false - все прогоны закончились
+    bool Next(RunRecord& record);
+
+    /* Сливает прогоны группами по max_fan_in в новые файлы (make_path), пока их не останется
+    * не больше max_fan_in: одновременно открыто не больше max_fan_in файлов. Слитые прогоны удаляются.
+    */
+    static void Reduce(std::vector<std::filesystem::path>& runs, size_t max_fan_in,
+                       const std::function<std::filesystem::path()>& make_path);
+
+private:
+    std::vector<std::unique_ptr<RunReader>> _readers;
+    std::vector<RunRecord> _heads;
+    std::vector<size_t> _heap; // индексы прогонов, наименьшая текущая запись наверху
+};
+
+#endif //SEARCH_ENGINE_INDEXRUNS_H
@@ -0,0 +1,357 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "IndexSegment.h"
+#include "Scoring.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+template <typename T>
+void write_value(std::ostream& output, T value) {
+    output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T read_value(std::istream& input) {
+    T value {};
+    if (!input.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+        throw std::runtime_error("Index segment is truncated");
+    }
+    return value;
+}
+
+} // namespace
+
+IndexSegment::CsrDictionary IndexSegment::_to_csr(Dictionary dictionary) {
+    // Слова и вхождения переписываются в общие массивы, каждый выделяется один раз
+    CsrDictionary csr;
+    size_t total_bytes = 0;
+    size_t total_entries = 0;
+    for (const auto& pair : dictionary) {
+        total_bytes += pair.first.size();
+        total_entries += pair.second.size();
+    }
+    if (total_bytes > UINT32_MAX) {
+        throw std::length_error("Index segment terms exceed 4 GiB");
+    }
+    csr.term_bytes.reserve(total_bytes);
+    csr.terms.reserve(dictionary.size());
+    csr.entries.reserve(total_entries);
+    while (!dictionary.empty()) {
+        auto node = dictionary.extract(dictionary.begin());
+        csr.terms.push_back({(uint32_t)csr.term_bytes.size(), (uint32_t)node.key().size(), csr.entries.size(),
+                             csr.entries.size() + node.mapped().size()});
+        csr.term_bytes += node.key();
+        csr.entries.insert(csr.entries.end(), node.mapped().begin(), node.mapped().end());
+    }
+    return csr;
+}
+
+IndexSegment::IndexSegment(size_t base_doc_id, size_t doc_count, Dictionary dictionary, bool frozen,
+                           size_t impact_bits)
+    : IndexSegment(base_doc_id, doc_count, _to_csr(std::move(dictionary)), frozen, impact_bits) {
+}
+
+IndexSegment::IndexSegment(size_t base_doc_id, size_t doc_count, CsrDictionary dictionary, bool frozen,
+                           size_t impact_bits)
+    : _base_doc_id(base_doc_id),
+      _doc_count(doc_count),
+      _term_bytes(std::move(dictionary.term_bytes)),
+      _postings(std::move(dictionary.entries)),
+      _slots(std::move(dictionary.terms))
+{
+    std::vector<std::string_view> words;
+    words.reserve(_slots.size());
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        words.push_back(term(i));
+    }
+    _terms = TermDictionary(words);
+    if (frozen) {
+        _frozen = _freeze();
+    }
+
+    // Импакты лежат параллельно общему массиву вхождений и зависят только от частоты
+    if (impact_bits != 0) {
+        if (impact_bits != 8 && impact_bits != 16) {
+            throw std::invalid_argument("impact bits must be 0, 8 or 16");
+        }
+        _impact_bits = impact_bits;
+        (impact_bits == 8 ? _impacts8.resize(_postings.size()) : _impacts16.resize(_postings.size()));
+        for (size_t i = 0; i < _postings.size(); ++i) {
+            const uint32_t impact = QuantizeImpact(_postings[i].count, impact_bits);
+            if (impact_bits == 8) {
+                _impacts8[i] = (uint8_t)impact;
+            } else {
+                _impacts16[i] = (uint16_t)impact;
+            }
+        }
+    }
+
+    // doc_id плотных терминов дополнительно кладутся в битовые карты (номера в Roaring 32-битные)
+    const size_t dense_min = std::max(DENSE_MIN_POSTINGS, _doc_count / DENSE_DIVISOR);
+    if (end_doc_id() <= UINT32_MAX) {
+        std::vector<uint32_t> ids;
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            const std::span<const Entry> entries = postings_at(i);
+            if (entries.size() < dense_min) {
+                continue;
+            }
+            ids.clear();
+            for (const Entry& entry : entries) {
+                ids.push_back((uint32_t)entry.doc_id);
+            }
+            _dense.emplace(entries.data(), RoaringBitmap::FromSorted(ids));
+        }
+    }
+}
+
+size_t IndexSegment::_postings_offset(std::span<const Entry> postings) const {
+    if (postings.empty() || postings.data() < _postings.data() || postings.data() >= _postings.data() + _postings.size()) {
+        return SIZE_MAX;
+    }
+    return (size_t)(postings.data() - _postings.data());
+}
+
+std::span<const uint8_t> IndexSegment::impacts8(std::span<const Entry> postings) const {
+    const size_t offset = _impacts8.empty() ? SIZE_MAX : _postings_offset(postings);
+    return offset == SIZE_MAX ? std::span<const uint8_t>() : std::span(_impacts8).subspan(offset, postings.size());
+}
+
+std::span<const uint16_t> IndexSegment::impacts16(std::span<const Entry> postings) const {
+    const size_t offset = _impacts16.empty() ? SIZE_MAX : _postings_offset(postings);
+    return offset == SIZE_MAX ? std::span<const uint16_t>() : std::span(_impacts16).subspan(offset, postings.size());
+}
+
+const RoaringBitmap* IndexSegment::bitmap(std::span<const Entry> postings) const {
+    if (_dense.empty() || postings.empty()) {
+        return nullptr;
+    }
+    auto it = _dense.find(postings.data());
+    return it != _dense.end() && postings.size() == it->second.Cardinality() ? &it->second : nullptr;
+}
+
+bool IndexSegment::_freeze() {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(_slots.size());
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        hashes.push_back(std::hash<std::string_view>{}(term(i)));
+    }
+    PerfectHash hash(hashes);
+
+    // Совершенный хеш взаимно однозначен только для различных хешей - проверяем
+    std::vector<size_t> order(_slots.size(), PerfectHash::NOT_FOUND);
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        const size_t index = hash.Lookup(hashes[i]);
+        if (index >= order.size() || order[index] != PerfectHash::NOT_FOUND) {
+            return false;
+        }
+        order[index] = i;
+    }
+
+    std::vector<TermSlot> slots;
+    slots.reserve(_slots.size());
+    _fingerprints.reserve(_slots.size());
+    for (size_t i : order) {
+        slots.push_back(std::move(_slots[i]));
+        _fingerprints.push_back((uint8_t)(hashes[i] >> 56));
+    }
+    _slots = std::move(slots);
+    _hash = std::move(hash);
+    return true;
+}
+
+std::span<const Entry> IndexSegment::postings(std::string_view word) const {
+    if (_frozen) {
+        const uint64_t hash = std::hash<std::string_view>{}(word);
+        const size_t i = _hash.Lookup(hash);
+        if (i >= _slots.size() || _fingerprints[i] != (uint8_t)(hash >> 56) || term(i) != word) {
+            return {};
+        }
+        return postings_at(i);
+    }
+    auto it = std::lower_bound(_slots.begin(), _slots.end(), word, [this](const TermSlot& slot, std::string_view w) {
+        return std::string_view(_term_bytes.data() + slot.offset, slot.length) < w;
+    });
+    if (it == _slots.end() || std::string_view(_term_bytes.data() + it->offset, it->length) != word) {
+        return {};
+    }
+    return postings_at((size_t)(it - _slots.begin()));
+}
+
+IndexSegment::MemoryUsage& IndexSegment::MemoryUsage::operator+=(const MemoryUsage& other) {
+    terms += other.terms;
+    term_bytes += other.term_bytes;
+    term_slots += other.term_slots;
+    postings += other.postings;
+    bitmaps += other.bitmaps;
+    pattern_dictionary += other.pattern_dictionary;
+    hash += other.hash;
+    impacts += other.impacts;
+    return *this;
+}
+
+IndexSegment::MemoryUsage IndexSegment::memory_usage() const {
+    MemoryUsage usage;
+    usage.terms = _slots.size();
+    usage.term_bytes = _term_bytes.capacity();
+    usage.term_slots = _slots.capacity() * sizeof(TermSlot);
+    usage.postings = _postings.capacity() * sizeof(Entry);
+    for (const auto& pair : _dense) {
+        usage.bitmaps += pair.second.memory_usage();
+    }
+    usage.pattern_dictionary = _terms.memory_usage();
+    usage.hash = _hash.memory_usage() + _fingerprints.capacity();
+    usage.impacts = _impacts8.capacity() + _impacts16.capacity() * sizeof(uint16_t);
+    return usage;
+}
+
+std::span<const Entry> IndexSegment::expanded_postings(std::string_view word, size_t max_expansions,
+                                                       std::vector<Entry>& storage) const {
+    std::vector<std::string> terms;
+    TermDictionary::FuzzyQuery fuzzy;
+    if (TermDictionary::ParseFuzzy(word, fuzzy)) {
+        terms = _terms.ExpandFuzzy(fuzzy.word, fuzzy.max_distance, fuzzy.prefix_length, max_expansions);
+    } else if (TermDictionary::IsPattern(word)) {
+        terms = _terms.Expand(word, max_expansions);
+    } else {
+        return postings(word);
+    }
+
+    std::vector<std::span<const Entry>> lists;
+    for (const std::string& term : terms) {
+        lists.push_back(postings(term));
+    }
+    if (lists.empty()) {
+        return {};
+    }
+    if (lists.size() == 1) {
+        return lists.front();
+    }
+    storage = UnionPostings(lists);
+    return storage;
+}
+
+std::vector<Entry> IndexSegment::UnionPostings(const std::vector<std::span<const Entry>>& lists) {
+    std::vector<Entry> result;
+    size_t total = 0;
+    for (const auto& list : lists) {
+        total += list.size();
+    }
+    result.reserve(total);
+
+    // Куча пар (номер списка, позиция в нём) с наименьшим doc_id наверху
+    std::vector<std::pair<size_t, size_t>> heap;
+    for (size_t i = 0; i < lists.size(); ++i) {
+        if (!lists[i].empty()) {
+            heap.emplace_back(i, 0);
+        }
+    }
+    auto greater = [&lists](const auto& a, const auto& b) {
+        return lists[a.first][a.second].doc_id > lists[b.first][b.second].doc_id;
+    };
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        auto& [list, pos] = heap.back();
+        const Entry& entry = lists[list][pos];
+        if (!result.empty() && result.back().doc_id == entry.doc_id) {
+            result.back().count += entry.count;
+        } else {
+            result.push_back(entry);
+        }
+
+        if (++pos < lists[list].size()) {
+            std::push_heap(heap.begin(), heap.end(), greater);
+        } else {
+            heap.pop_back();
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<const IndexSegment> IndexSegment::Merge(const std::vector<std::shared_ptr<const IndexSegment>>& segments,
+                                                        const std::unordered_set<size_t>* deleted, bool frozen) {
+    if (segments.empty()) {
+        throw std::invalid_argument("no segments to merge");
+    }
+
+    Dictionary merged;
+    size_t doc_count = 0;
+    for (const auto& segment : segments) {
+        if (segment->base_doc_id() != segments.front()->base_doc_id() + doc_count) {
+            throw std::invalid_argument("merged segments must be adjacent");
+        }
+        doc_count += segment->doc_count();
+
+        // Слова обычного сегмента идут по возрастанию, поэтому подсказка "сразу после предыдущего" почти всегда точна
+        auto hint = merged.begin();
+        for (size_t i = 0; i < segment->term_count(); ++i) {
+            const std::span<const Entry> entries = segment->postings_at(i);
+            auto it = merged.try_emplace(hint, std::string(segment->term(i)));
+            if (deleted == nullptr || deleted->empty()) {
+                it->second.insert(it->second.end(), entries.begin(), entries.end());
+            } else {
+                for (const Entry& entry : entries) {
+                    if (!deleted->count(entry.doc_id)) {
+                        it->second.push_back(entry);
+                    }
+                }
+            }
+            hint = std::next(it);
+        }
+    }
+
+    // Слова, оставшиеся только в удалённых документах, из словаря убираются
+    if (deleted != nullptr && !deleted->empty()) {
+        std::erase_if(merged, [](const auto& pair) { return pair.second.empty(); });
+    }
+    return std::make_shared<const IndexSegment>(segments.front()->base_doc_id(), doc_count, std::move(merged), frozen,
+                                                segments.front()->impact_bits());
+}
+
+void IndexSegment::Save(std::ostream& output) const {
+    write_value<uint64_t>(output, _base_doc_id);
+    write_value<uint64_t>(output, _doc_count);
+    write_value<uint64_t>(output, _slots.size());
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        const std::string_view word = term(i);
+        const std::span<const Entry> entries = postings_at(i);
+        write_value<uint32_t>(output, (uint32_t)word.size());
+        output.write(word.data(), (std::streamsize)word.size());
+        write_value<uint64_t>(output, entries.size());
+        for (const Entry& entry : entries) {
+            write_value<uint64_t>(output, entry.doc_id);
+            write_value<uint64_t>(output, entry.count);
+        }
+    }
+}
+
+std::shared_ptr<const IndexSegment> IndexSegment::Load(std::istream& input, size_t impact_bits) {
+    const auto base_doc_id = (size_t)read_value<uint64_t>(input);
+    const auto doc_count = (size_t)read_value<uint64_t>(input);
+    const auto words_count = read_value<uint64_t>(input);
+
+    Dictionary dictionary;
+    std::string word;
+    for (uint64_t i = 0; i < words_count; ++i) {
+        word.resize(read_value<uint32_t>(input));
+        if (!input.read(word.data(), (std::streamsize)word.size())) {
+            throw std::runtime_error("Index segment is truncated");
+        }
+        const auto entries_count = read_value<uint64_t>(input);
+        std::vector<Entry> entries;
+        entries.reserve(entries_count);
+        for (uint64_t j = 0; j < entries_count; ++j) {
+            const auto doc_id = (size_t)read_value<uint64_t>(input);
+            const auto count = (size_t)read_value<uint64_t>(input);
+            entries.emplace_back(doc_id, count);
+        }
+        dictionary.emplace_hint(dictionary.end(), word, std::move(entries));
+    }
+    return std::make_shared<const IndexSegment>(base_doc_id, doc_count, std::move(dictionary), false, impact_bits);
+}
@@ -0,0 +1,198 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_INDEXSEGMENT_H
+#define SEARCH_ENGINE_INDEXSEGMENT_H
+
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "PerfectHash.h"
+#include "RoaringBitmap.h"
+#include "TermDictionary.h"
+
+struct Entry {
+    size_t doc_id;
+    size_t count;
+
+    bool operator== (const Entry& other) const {
+        return (doc_id == other.doc_id) && (count == other.count);
+    }
+
+    Entry() = default;
+
+    Entry(size_t id, size_t c) : doc_id(id), count(c) {}
+};
+
+/* Неизменяемый сегмент индекса с документами [base_doc_id, base_doc_id + doc_count).
+ * doc_id во вхождениях глобальные, списки вхождений отсортированы по doc_id.
+ * Байты всех слов лежат подряд в одном массиве, вхождения всех слов - в другом (CSR):
+ * слово адресуется смещением и длиной, его вхождения - диапазоном в общем массиве.
+ * Поиск - двоичный по string_view без отдельной строки и отдельного вектора на каждое слово.
+ * Замороженный сегмент вместо двоичного поиска находит слово минимальным совершенным хешем:
+ * одна проверка 8-битного отпечатка отсекает почти все отсутствующие слова, затем слово сравнивается целиком.
+ * После создания сегмент только читается, поэтому доступ к нему не требует блокировок.
+ */
+class IndexSegment {
+public:
+    // Словарь при сборке сегмента
+    using Dictionary = std::map<std::string, std::vector<Entry>, std::less<>>;
+
+    /* Словарь двухпроходной сборки (CSR): сначала считается df каждого слова, затем вхождения
+    * раскладываются по заранее вычисленным диапазонам одного массива. Сегмент забирает массивы как есть.
+    */
+    struct CsrDictionary {
+        struct Term {
+            uint32_t offset = 0; // в term_bytes
+            uint32_t length = 0;
+            size_t begin = 0;    // вхождения слова - entries[begin, end)
+            size_t end = 0;
+        };
+
+        std::string term_bytes;     // байты слов в любом порядке
+        std::vector<Term> terms;    // по возрастанию слов
+        std::vector<Entry> entries; // вхождения каждого слова отсортированы по doc_id
+    };
+
+    // Память сегмента по частям, в байтах
+    struct MemoryUsage {
+        size_t terms = 0;
+        size_t term_bytes = 0;         // байты слов в общем массиве
+        size_t term_slots = 0;         // слоты слов: смещение, длина, диапазон вхождений
+        size_t postings = 0;           // общий массив вхождений
+        size_t bitmaps = 0;            // битовые карты плотных слов
+        size_t pattern_dictionary = 0; // сжатый словарь для шаблонов
+        size_t hash = 0;               // совершенный хеш и отпечатки замороженного сегмента
+        size_t impacts = 0;            // квантованные вклады вхождений
+
+        // Издержки словаря на одно слово (без вхождений)
+        double dictionary_bytes_per_term() const {
+            return terms == 0 ? 0 : (double)(term_bytes + term_slots + hash) / (double)terms;
+        }
+
+        MemoryUsage& operator+=(const MemoryUsage& other);
+    };
+
+    /* Плотный термин - встречается хотя бы в DENSE_MIN_POSTINGS документах и хотя бы в 1/DENSE_DIVISOR
+    * документов сегмента. Для него кроме списка вхождений строится битовая карта документов.
+    */
+    static constexpr size_t DENSE_MIN_POSTINGS = 1024;
+    static constexpr size_t DENSE_DIVISOR = 16;
+
+    /* frozen - сегмент только для чтения (индекс заморожен): слова ищутся совершенным хешем,
+    * слоты лежат в порядке хеша. Если хеши двух слов совпали, сегмент остаётся обычным.
+    * impact_bits (0, 8 или 16) - для каждого вхождения хранится квантованная частота BM25 (QuantizeImpact).
+    */
+    IndexSegment(size_t base_doc_id, size_t doc_count, Dictionary dictionary, bool frozen = false,
+                 size_t impact_bits = 0);
+
+    IndexSegment(size_t base_doc_id, size_t doc_count, CsrDictionary dictionary, bool frozen = false,
+                 size_t impact_bits = 0);
+
+    // Битовые карты ссылаются на списки вхождений этого объекта
+    IndexSegment(const IndexSegment&) = delete;
+    IndexSegment& operator=(const IndexSegment&) = delete;
+
+    size_t base_doc_id() const { return _base_doc_id; }
+
+    size_t doc_count() const { return _doc_count; }
+
+    size_t end_doc_id() const { return _base_doc_id + _doc_count; }
+
+    // Вхождения слова в сегменте; пустой span, если слова нет
+    std::span<const Entry> postings(std::string_view word) const;
+
+    bool frozen() const { return _frozen; }
+
+    size_t impact_bits() const { return _impact_bits; }
+
+    /* Импакты вхождений postings (из postings() или postings_at() этого сегмента), по одному на вхождение.
+    * Пустой span, если сегмент квантован в другую разрядность или список собран из нескольких слов.
+    */
+    std::span<const uint8_t> impacts8(std::span<const Entry> postings) const;
+
+    std::span<const uint16_t> impacts16(std::span<const Entry> postings) const;
+
+    // Слова сегмента (по возрастанию; у замороженного - в порядке хеша): term(i) и его вхождения postings_at(i)
+    size_t term_count() const { return _slots.size(); }
+
+    std::string_view term(size_t i) const { return {_term_bytes.data() + _slots[i].offset, _slots[i].length}; }
+
+    std::span<const Entry> postings_at(size_t i) const {
+        return {_postings.data() + _slots[i].begin, _slots[i].end - _slots[i].begin};
+    }
+
+    MemoryUsage memory_usage() const;
+
+    const TermDictionary& terms() const { return _terms; }
+
+    /* Битовая карта документов для списка, полученного из postings() плотного термина; иначе nullptr.
+    * Частота документа doc_id - postings[bitmap->Rank(doc_id)].count.
+    */
+    const RoaringBitmap* bitmap(std::span<const Entry> postings) const;
+
+    /* Вхождения слова, шаблона (capit*, ?ome) или нечёткого слова (capitol~, capitol~1).
+    * Шаблон раскрывается не более чем в max_expansions слов сегмента, их вхождения объединяются в storage.
+    * Для обычного слова storage не используется.
+    */
+    std::span<const Entry> expanded_postings(std::string_view word, size_t max_expansions,
+                                             std::vector<Entry>& storage) const;
+
+    // Объединение отсортированных по doc_id списков через кучу; частоты одного документа складываются
+    static std::vector<Entry> UnionPostings(const std::vector<std::span<const Entry>>& lists);
+
+    /* Сливает соседние сегменты (по возрастанию base_doc_id, без разрывов) в один.
+    * Списки вхождений просто склеиваются - диапазоны doc_id сегментов не пересекаются.
+    * Вхождения удалённых документов (deleted) при этом выбрасываются.
+    */
+    // Разрядность импактов берётся у первого сегмента
+    static std::shared_ptr<const IndexSegment> Merge(const std::vector<std::shared_ptr<const IndexSegment>>& segments,
+                                                     const std::unordered_set<size_t>* deleted = nullptr,
+                                                     bool frozen = false);
+
+    /* Двоичная запись сегмента (порядок байт платформы). Load бросает std::runtime_error при повреждении.
+    * Заморозка и импакты не сохраняются: импакты пересчитываются при загрузке с разрядностью impact_bits.
+    */
+    void Save(std::ostream& output) const;
+
+    static std::shared_ptr<const IndexSegment> Load(std::istream& input, size_t impact_bits = 0);
+
+private:
+    size_t _base_doc_id;
+    size_t _doc_count;
+    using TermSlot = CsrDictionary::Term;
+
+    // Раскладывает словарь сборки в общие массивы
+    static CsrDictionary _to_csr(Dictionary dictionary);
+
+    // Раскладывает слоты по номерам совершенного хеша; false - хеши слов совпали
+    bool _freeze();
+
+    // Позиция списка в общем массиве вхождений или SIZE_MAX, если список не из него
+    size_t _postings_offset(std::span<const Entry> postings) const;
+
+    std::string _term_bytes;      // байты всех слов подряд
+    std::vector<Entry> _postings; // вхождения всех слов подряд
+    std::vector<TermSlot> _slots; // по возрастанию слов, у замороженного сегмента - по номеру хеша
+    bool _frozen = false;
+    PerfectHash _hash;
+    std::vector<uint8_t> _fingerprints; // старший байт хеша слова в слоте i
+    size_t _impact_bits = 0;
+    std::vector<uint8_t> _impacts8;   // параллельно _postings при 8-битных импактах
+    std::vector<uint16_t> _impacts16; // при 16-битных
+    TermDictionary _terms; // те же слова в сжатом виде - для раскрытия шаблонов
+    std::unordered_map<const Entry*, RoaringBitmap> _dense; // по началу списка вхождений плотного термина
+};
+
+#endif //SEARCH_ENGINE_INDEXSEGMENT_H
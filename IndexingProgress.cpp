@@ -0,0 +1,73 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "IndexingProgress.h"
+
+double IndexingProgress::eta_seconds() const {
+    if (finished) {
+        return 0;
+    }
+    if (bytes_done == 0 || elapsed_seconds <= 0) {
+        return -1;
+    }
+    return elapsed_seconds * (double)(bytes_total - bytes_done) / (double)bytes_done;
+}
+
+ProgressTracker::ProgressTracker(size_t docs_total, size_t bytes_total, ProgressCallback callback,
+                                 std::chrono::milliseconds interval, std::stop_token stop)
+    : _docs_total(docs_total),
+      _bytes_total(bytes_total),
+      _callback(std::move(callback)),
+      _interval(interval),
+      _stop(std::move(stop)),
+      _next_report((_start + _interval).time_since_epoch().count())
+{
+}
+
+IndexingProgress ProgressTracker::_snapshot() const {
+    IndexingProgress progress;
+    progress.docs_total = _docs_total;
+    progress.bytes_total = _bytes_total;
+    progress.docs_done = _docs_done.load(std::memory_order_relaxed);
+    progress.bytes_done = _bytes_done.load(std::memory_order_relaxed);
+    progress.elapsed_seconds = std::chrono::duration<double>(Clock::now() - _start).count();
+    return progress;
+}
+
+void ProgressTracker::_report(const IndexingProgress& progress) {
+    std::lock_guard<std::mutex> lock(_callback_mutex);
+    _callback(progress);
+}
+
+void ProgressTracker::Add(size_t docs, size_t bytes) {
+    _docs_done.fetch_add(docs, std::memory_order_relaxed);
+    _bytes_done.fetch_add(bytes, std::memory_order_relaxed);
+    if (!_callback) {
+        return;
+    }
+
+    // Отчитывается только поток, которому удалось сдвинуть время следующего отчёта
+    const Clock::rep now = Clock::now().time_since_epoch().count();
+    Clock::rep next = _next_report.load(std::memory_order_relaxed);
+    if (now < next || !_next_report.compare_exchange_strong(next, now + _interval.count())) {
+        return;
+    }
+    _report(_snapshot());
+}
+
+void ProgressTracker::ThrowIfCancelled() const {
+    if (cancelled()) {
+        throw IndexingCancelled();
+    }
+}
+
+void ProgressTracker::Finish(size_t terms) {
+    if (!_callback) {
+        return;
+    }
+    IndexingProgress progress = _snapshot();
+    progress.terms = terms;
+    progress.finished = true;
+    _report(progress);
+}
@@ -0,0 +1,83 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_INDEXINGPROGRESS_H
+#define SEARCH_ENGINE_INDEXINGPROGRESS_H
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+
+// Ход построения индекса
+struct IndexingProgress {
+    size_t docs_done = 0;
+    size_t docs_total = 0;
+    size_t bytes_done = 0;
+    size_t bytes_total = 0;
+    size_t terms = 0;           // слов в словаре; известно только по окончании сборки
+    double elapsed_seconds = 0;
+    bool finished = false;
+
+    double bytes_per_second() const { return elapsed_seconds > 0 ? (double)bytes_done / elapsed_seconds : 0; }
+
+    double docs_per_second() const { return elapsed_seconds > 0 ? (double)docs_done / elapsed_seconds : 0; }
+
+    // Оценка оставшегося времени по средней скорости; отрицательна, пока скорость неизвестна
+    double eta_seconds() const;
+};
+
+using ProgressCallback = std::function<void(const IndexingProgress&)>;
+
+// Построение индекса остановлено через std::stop_token; прежний индекс не изменился
+class IndexingCancelled : public std::runtime_error {
+public:
+    IndexingCancelled() : std::runtime_error("Indexing cancelled") {}
+};
+
+/* Счётчики одной сборки. Потоки индексации добавляют обработанные документы и байты,
+ * наблюдатель вызывается из того потока, который заметил, что прошёл interval, - не чаще раза в interval
+ * и не из двух потоков сразу. Отмена кооперативная: потоки проверяют cancelled() между задачами.
+ */
+class ProgressTracker {
+public:
+    ProgressTracker(size_t docs_total, size_t bytes_total, ProgressCallback callback,
+                    std::chrono::milliseconds interval, std::stop_token stop);
+
+    void Add(size_t docs, size_t bytes);
+
+    bool cancelled() const { return _stop.stop_requested(); }
+
+    // Бросает IndexingCancelled после отмены; вызывается вне рабочих потоков
+    void ThrowIfCancelled() const;
+
+    // Последний вызов наблюдателя: всё обработано, terms слов в словаре
+    void Finish(size_t terms);
+
+private:
+    IndexingProgress _snapshot() const;
+
+    void _report(const IndexingProgress& progress);
+
+    using Clock = std::chrono::steady_clock;
+
+    const size_t _docs_total;
+    const size_t _bytes_total;
+    const ProgressCallback _callback;
+    const Clock::duration _interval;
+    const std::stop_token _stop;
+    const Clock::time_point _start = Clock::now();
+
+    std::atomic<size_t> _docs_done{0};
+    std::atomic<size_t> _bytes_done{0};
+    std::atomic<Clock::rep> _next_report;
+    std::mutex _callback_mutex;
+};
+
+#endif //SEARCH_ENGINE_INDEXINGPROGRESS_H
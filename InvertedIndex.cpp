@@ -3,82 +3,872 @@
 //
 
 #include "InvertedIndex.h"
-#include <sstream>
+#include "IndexRuns.h"
+#include "ParallelFor.h"
+#include "ScratchArena.h"
+#include "Stemmer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <thread>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <memory>
 #include <vector>
 
-void InvertedIndex::UpdateDocumentBase(const std::vector<std::string>& input_docs) {
-    // 1. Очищаем старые данные
-    {
-        std::unique_lock<std::shared_mutex> lock(rw_mutex);
-        docs.clear();
-        freq_dictionary.clear();
+namespace fs = std::filesystem;
 
-        // 2. Копируем новые документы в docs
-        docs = input_docs;
+namespace {
+
+std::vector<DocumentBuffer> copy_to_buffers(const std::vector<std::string>& input_docs) {
+    std::vector<DocumentBuffer> buffers;
+    buffers.reserve(input_docs.size());
+    for (const std::string& text : input_docs) {
+        buffers.push_back(DocumentBuffer::FromString(text));
     }
-    // 3. Запускаем процесс индексации
-    std::cout << "Updating document base... " << docs.size() << " documents loaded." << std::endl;
+    return buffers;
+}
 
-    // 4. Создаём потоки на документы
-    std::vector<std::thread> threads;
-    threads.reserve(docs.size()); // Резервируем место
+// Те же разделители, что и у operator>> в классической локали
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'E', 'I', 'D', 'X', '0', '0', '1'};
+
+template <typename T>
+void write_value(std::ostream& output, T value) {
+    output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
 
-    // 5. Запускаем по одному потоку на каждый документ
-    // (Требование 1: В отдельных потоках... индексацию каждого из файлов)
-    for (size_t doc_id = 0; doc_id < docs.size(); ++doc_id) {
-        // emplace_back создает поток "на месте"
-        threads.emplace_back(
-            &InvertedIndex::_index_one_document, // Функция-член класса
-            this,                                // Указатель на 'this'
-            doc_id                               // Аргумент для функции
-        );
+template <typename T>
+T read_value(std::istream& input) {
+    T value {};
+    if (!input.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+        throw std::runtime_error("Index snapshot is truncated");
     }
+    return value;
+}
 
-    // 6. Ожидаем завершения всех потоков
-    for (auto& t : threads) {
-        if (t.joinable()) {
-            t.join();
+/* Слоты csr.terms лежат блоками [terms_base[p], terms_base[p + 1]), каждый отсортирован по словам;
+* блоки сливаются попарно в один упорядоченный массив
+*/
+void merge_term_blocks(IndexSegment::CsrDictionary& csr, const std::vector<size_t>& terms_base) {
+    const size_t blocks_count = terms_base.size() - 1;
+    auto less = [&csr](const IndexSegment::CsrDictionary::Term& a, const IndexSegment::CsrDictionary::Term& b) {
+        return std::string_view(csr.term_bytes.data() + a.offset, a.length)
+               < std::string_view(csr.term_bytes.data() + b.offset, b.length);
+    };
+    const auto block = [&](size_t index) {
+        return csr.terms.begin() + (std::ptrdiff_t)terms_base[std::min(index, blocks_count)];
+    };
+    for (size_t width = 1; width < blocks_count; width *= 2) {
+        for (size_t index = 0; index + width < blocks_count; index += 2 * width) {
+            std::inplace_merge(block(index), block(index + width), block(index + 2 * width), less);
         }
     }
+}
 
-    std::cout << "Indexing complete. " << freq_dictionary.size()
+} // namespace
+
+InvertedIndex::~InvertedIndex() {
+    {
+        std::lock_guard<std::mutex> lock(background_mutex);
+        stop_background = true;
+    }
+    background_cv.notify_all();
+    if (background_thread.joinable()) {
+        background_thread.join();
+    }
+}
+
+void InvertedIndex::UpdateDocumentBase(const std::vector<std::string>& input_docs, std::stop_token stop) {
+    // Копируем новые документы в собственные буферы
+    UpdateDocumentBase(copy_to_buffers(input_docs), std::move(stop));
+}
+
+void InvertedIndex::UpdateDocumentBase(std::vector<DocumentBuffer> input_docs, std::stop_token stop) {
+    // 1. Новые документы не принимаются, пока база перестраивается
+    std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+
+    // 2. Запускаем процесс индексации. Поиск тем временем работает по старому снимку.
+    // При отмене исключение вылетает до подмены снимка - прежний индекс и буфер не меняются
+    std::cout << "Updating document base... " << input_docs.size() << " documents loaded." << std::endl;
+    size_t bytes_total = 0;
+    for (const DocumentBuffer& doc : input_docs) {
+        bytes_total += doc.view().size();
+    }
+    ProgressTracker progress(input_docs.size(), bytes_total, progress_callback, progress_interval, std::move(stop));
+    std::shared_ptr<const IndexSegment> segment = _build_segment(input_docs, 0, &progress);
+    pending_docs.clear();
+    frozen = false;
+
+    // 3. Подменяем снимок и документы целиком
+    auto new_snapshot = std::make_shared<IndexSnapshot>();
+    new_snapshot->doc_count = input_docs.size();
+    if (segment->doc_count() > 0) {
+        new_snapshot->segments.push_back(segment);
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        docs = std::move(input_docs);
+        snapshot = std::move(new_snapshot);
+        next_doc_id = docs.size();
+    }
+
+    std::cout << "Indexing complete. " << segment->term_count()
               << " unique words found." << std::endl;
+    progress.Finish(segment->term_count());
+
+    // Старый журнал относится к прежней базе - сразу сохраняем новую
+    if (wal) {
+        _checkpoint();
+    }
 
     //system_index_documents();
 }
 
-void InvertedIndex::_index_one_document(size_t doc_id) {
-    // 1. Получаем текст
-    // Чтение из 'docs' относительно безопасно, т.к. 'docs' не меняется после UpdateDocumentBase (в теории)
-    const std::string& text = docs[doc_id];
+void InvertedIndex::SetProgressCallback(ProgressCallback callback, std::chrono::milliseconds interval) {
+    progress_callback = std::move(callback);
+    progress_interval = interval;
+}
+
+size_t InvertedIndex::AddDocuments(const std::vector<std::string>& input_docs) {
+    return AddDocuments(copy_to_buffers(input_docs));
+}
 
-    // 2. Разбиваем на слова (Требование 2)
-    std::vector<std::string> words = _split_text(text);
+size_t InvertedIndex::AddDocuments(std::vector<DocumentBuffer> input_docs) {
+    _ensure_background_thread();
 
-    // 3. Считаем локальную частоту слов (Требование 3, 4)
-    std::map<std::string, size_t> local_word_counts;
-    for (const std::string& word : words) {
-        if (!word.empty()) {
-            local_word_counts[word]++;
+    size_t first_doc_id = 0;
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+        if (frozen) {
+            throw std::logic_error("Index is frozen");
+        }
+        first_doc_id = next_doc_id;
+        for (DocumentBuffer& doc : input_docs) {
+            if (wal) {
+                lsn = wal->Append(WriteAheadLog::Operation::AddDocument, next_doc_id, doc.view());
+            }
+            ++next_doc_id;
+            pending_docs.push_back(std::move(doc));
+        }
+        if (pending_docs.size() >= flush_threshold) {
+            _flush_pending();
+        }
+    }
+
+    // Ждём записи на диск вне блокировки: записи нескольких потоков уходят одним fsync
+    if (lsn != 0) {
+        wal->WaitDurable(lsn);
+    }
+    return first_doc_id;
+}
+
+bool InvertedIndex::RemoveDocument(size_t doc_id) {
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+        if (frozen) {
+            throw std::logic_error("Index is frozen");
         }
+        if (doc_id >= next_doc_id || GetSnapshot()->is_deleted(doc_id)) {
+            return false;
+        }
+        if (wal) {
+            lsn = wal->Append(WriteAheadLog::Operation::RemoveDocument, doc_id);
+        }
+
+        // Сегменты не меняются: удаление - это отметка в снимке до ближайшего слияния
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        auto deleted = std::make_shared<std::unordered_set<size_t>>(*snapshot->deleted);
+        deleted->insert(doc_id);
+        auto new_snapshot = std::make_shared<IndexSnapshot>(*snapshot);
+        new_snapshot->deleted = std::move(deleted);
+        snapshot = std::move(new_snapshot);
+    }
+
+    if (lsn != 0) {
+        wal->WaitDurable(lsn);
+    }
+    return true;
+}
+
+void InvertedIndex::Flush() {
+    std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+    _flush_pending();
+}
+
+size_t InvertedIndex::OpenStorage(const std::string& snapshot_path, const std::string& wal_path) {
+    std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+    if (wal) {
+        throw std::logic_error("Index storage is already open");
+    }
+
+    // 1. Последний сохранённый индекс
+    uint64_t snapshot_lsn = 0;
+    if (fs::exists(snapshot_path)) {
+        snapshot_lsn = _load_snapshot(snapshot_path);
+    }
+
+    // 2. Операции из журнала после него. Добавленные документы копятся в буфере
+    // и индексируются одним сегментом, удаления собираются в один набор
+    auto deleted = std::make_shared<std::unordered_set<size_t>>(*GetSnapshot()->deleted);
+    WriteAheadLog::ReplayResult result = WriteAheadLog::Replay(wal_path, snapshot_lsn, [&](WriteAheadLog::Record& record) {
+        if (record.operation == WriteAheadLog::Operation::AddDocument) {
+            if (record.doc_id != next_doc_id) {
+                throw std::runtime_error("Write-ahead log does not match the index snapshot");
+            }
+            pending_docs.push_back(DocumentBuffer::FromString(std::move(record.text)));
+            ++next_doc_id;
+        } else {
+            deleted->insert(record.doc_id);
+        }
+    });
+    _flush_pending();
+    {
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        auto new_snapshot = std::make_shared<IndexSnapshot>(*snapshot);
+        new_snapshot->deleted = std::move(deleted);
+        snapshot = std::move(new_snapshot);
+    }
+
+    // 3. Дальше пишем в тот же журнал, отрезав оборванный хвост
+    wal = std::make_unique<WriteAheadLog>(wal_path, result.valid_bytes, std::max(snapshot_lsn, result.last_lsn) + 1);
+    snapshot_file = snapshot_path;
+    return result.applied;
+}
+
+void InvertedIndex::Checkpoint() {
+    std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+    if (wal) {
+        _checkpoint();
+    }
+}
+
+void InvertedIndex::_checkpoint() {
+    // Под ingest_mutex новые операции в журнал не попадают, а после сброса буфера
+    // снимок содержит всё, что записано в журнал до LastLsn()
+    _flush_pending();
+    const uint64_t lsn = wal->LastLsn();
+
+    // Пишем во временный файл и подменяем: при сбое остаётся прежний целый снимок
+    const std::string temp_path = snapshot_file + ".tmp";
+    _save_snapshot(temp_path, lsn);
+
+    // Журнал можно очищать, только когда новый снимок и его имя уже на диске: иначе сбой между
+    // rename и Truncate оставит пустой журнал при старом или недописанном снимке
+    WriteAheadLog::SyncPath(temp_path);
+    fs::rename(temp_path, snapshot_file);
+    const fs::path directory = fs::absolute(snapshot_file).parent_path();
+    WriteAheadLog::SyncPath(directory.string());
+    wal->Truncate();
+}
+
+void InvertedIndex::_save_snapshot(const std::string& path, uint64_t lsn) const {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        throw std::runtime_error("Cannot write index snapshot " + path);
+    }
+
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    output.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    write_value<uint64_t>(output, lsn);
+
+    write_value<uint64_t>(output, docs.size());
+    for (const DocumentBuffer& doc : docs) {
+        write_value<uint64_t>(output, doc.size());
+        output.write(doc.view().data(), (std::streamsize)doc.size());
+    }
+
+    write_value<uint64_t>(output, snapshot->deleted->size());
+    for (size_t doc_id : *snapshot->deleted) {
+        write_value<uint64_t>(output, doc_id);
+    }
+
+    write_value<uint64_t>(output, snapshot->segments.size());
+    for (const auto& segment : snapshot->segments) {
+        segment->Save(output);
+    }
+
+    output.flush();
+    if (!output) {
+        throw std::runtime_error("Error writing index snapshot " + path);
+    }
+}
+
+uint64_t InvertedIndex::_load_snapshot(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+    if (!input.read(magic, sizeof(magic)) || std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not an index snapshot: " + path);
+    }
+    const uint64_t lsn = read_value<uint64_t>(input);
+
+    std::vector<DocumentBuffer> loaded_docs(read_value<uint64_t>(input));
+    std::string text;
+    for (DocumentBuffer& doc : loaded_docs) {
+        text.resize(read_value<uint64_t>(input));
+        if (!input.read(text.data(), (std::streamsize)text.size())) {
+            throw std::runtime_error("Index snapshot is truncated");
+        }
+        doc = DocumentBuffer::FromString(text);
+    }
+
+    auto deleted = std::make_shared<std::unordered_set<size_t>>();
+    for (uint64_t i = read_value<uint64_t>(input); i > 0; --i) {
+        deleted->insert(read_value<uint64_t>(input));
+    }
+
+    auto new_snapshot = std::make_shared<IndexSnapshot>();
+    for (uint64_t i = read_value<uint64_t>(input); i > 0; --i) {
+        new_snapshot->segments.push_back(IndexSegment::Load(input, impact_bits));
+    }
+    new_snapshot->doc_count = loaded_docs.size();
+    new_snapshot->deleted = std::move(deleted);
+
+    std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    docs = std::move(loaded_docs);
+    snapshot = std::move(new_snapshot);
+    next_doc_id = docs.size();
+    pending_docs.clear();
+    return lsn;
+}
+
+void InvertedIndex::_flush_pending() {
+    if (pending_docs.empty()) {
+        return;
+    }
+    std::vector<DocumentBuffer> batch = std::move(pending_docs);
+    pending_docs.clear();
+    const size_t base_doc_id = next_doc_id - batch.size();
+    std::shared_ptr<const IndexSegment> segment = _build_segment(batch, base_doc_id);
+    _publish_segment(std::move(segment), std::move(batch));
+}
+
+void InvertedIndex::_publish_segment(std::shared_ptr<const IndexSegment> segment, std::vector<DocumentBuffer> batch) {
+    {
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        auto new_snapshot = std::make_shared<IndexSnapshot>(*snapshot);
+        new_snapshot->doc_count = segment->end_doc_id();
+        new_snapshot->segments.push_back(std::move(segment));
+        snapshot = std::move(new_snapshot);
+        for (DocumentBuffer& doc : batch) {
+            docs.push_back(std::move(doc));
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(background_mutex);
+        merge_requested = true;
+    }
+    background_cv.notify_all();
+}
+
+void InvertedIndex::SetSegmentPolicy(size_t flush_threshold_docs, std::chrono::milliseconds interval, size_t factor) {
+    flush_threshold = std::max<size_t>(1, flush_threshold_docs);
+    flush_interval = interval;
+    merge_factor = std::max<size_t>(2, factor);
+}
+
+bool InvertedIndex::_merge_once() {
+    std::shared_ptr<const IndexSnapshot> current = GetSnapshot();
+    const size_t threshold = flush_threshold;
+    const size_t factor = merge_factor;
+
+    // Ярус сегмента: 0 - до factor * threshold документов, дальше каждый ярус в factor раз больше
+    auto tier = [&](const IndexSegment& segment) {
+        size_t level = 0;
+        for (size_t size = threshold * factor; segment.doc_count() >= size; size *= factor) {
+            ++level;
+        }
+        return level;
+    };
+
+    // Ищем самое левое окно из factor соседних сегментов одного яруса
+    const auto& segments = current->segments;
+    size_t window_start = segments.size();
+    for (size_t i = 0; i + factor <= segments.size(); ++i) {
+        const size_t level = tier(*segments[i]);
+        size_t j = i + 1;
+        while (j < i + factor && tier(*segments[j]) == level) {
+            ++j;
+        }
+        if (j == i + factor) {
+            window_start = i;
+            break;
+        }
+    }
+    if (window_start == segments.size()) {
+        return false;
     }
 
-    // 4. Обновляем глобальный freq_dictionary (Требование 5)
-    // Захватываем эксклюзивный доступ для записи в freq_dictionary
+    std::vector<std::shared_ptr<const IndexSegment>> window(segments.begin() + window_start,
+                                                            segments.begin() + window_start + factor);
+    std::shared_ptr<const IndexSegment> merged = IndexSegment::Merge(window, current->deleted.get());
+
+    // Публикуем, только если за время слияния база не была перестроена целиком
     std::unique_lock<std::shared_mutex> lock(rw_mutex);
+    const auto& live = snapshot->segments;
+    auto it = std::find(live.begin(), live.end(), window.front());
+    if (it == live.end() || (size_t)(live.end() - it) < factor || !std::equal(window.begin(), window.end(), it)) {
+        return true;
+    }
+    auto new_snapshot = std::make_shared<IndexSnapshot>();
+    new_snapshot->doc_count = snapshot->doc_count;
+    new_snapshot->deleted = snapshot->deleted;
+    new_snapshot->segments.assign(live.begin(), it);
+    new_snapshot->segments.push_back(std::move(merged));
+    new_snapshot->segments.insert(new_snapshot->segments.end(), it + factor, live.end());
+    snapshot = std::move(new_snapshot);
+    return true;
+}
+
+void InvertedIndex::_ensure_background_thread() {
+    std::lock_guard<std::mutex> lock(background_mutex);
+    if (!background_thread.joinable()) {
+        background_thread = std::thread(&InvertedIndex::_background_loop, this);
+    }
+}
+
+void InvertedIndex::_background_loop() {
+    std::unique_lock<std::mutex> lock(background_mutex);
+    while (!stop_background) {
+        background_cv.wait_for(lock, flush_interval.load(), [this] { return stop_background || merge_requested; });
+        if (stop_background) {
+            break;
+        }
+        const bool timer_flush = !merge_requested;
+        merge_requested = false;
+        merging = true;
+        lock.unlock();
+
+        // Сброс по таймеру: документы не должны висеть в буфере дольше flush_interval
+        if (timer_flush) {
+            std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+            _flush_pending();
+        }
+        while (_merge_once()) {
+        }
+
+        lock.lock();
+        merging = false;
+        merges_done_cv.notify_all();
+    }
+}
+
+void InvertedIndex::WaitForMerges() {
+    _ensure_background_thread();
+    std::unique_lock<std::mutex> lock(background_mutex);
+    merge_requested = true;
+    background_cv.notify_all();
+    merges_done_cv.wait(lock, [this] { return stop_background || (!merge_requested && !merging); });
+}
+
+void InvertedIndex::Freeze() {
+    WaitForMerges();
+    std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+    _flush_pending();
+
+    // Под ingest_mutex документы не добавляются и не удаляются; слияние, начатое фоновым потоком,
+    // не опубликуется - его окна в новом снимке уже нет
+    std::shared_ptr<const IndexSnapshot> current = GetSnapshot();
+    auto new_snapshot = std::make_shared<IndexSnapshot>(*current);
+    if (!current->segments.empty()) {
+        new_snapshot->segments = {IndexSegment::Merge(current->segments, current->deleted.get(), true)};
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(rw_mutex);
+        snapshot = std::move(new_snapshot);
+    }
+    frozen = true;
+}
+
+std::shared_ptr<const IndexSegment> InvertedIndex::_build_segment(const std::vector<DocumentBuffer>& batch,
+                                                                  size_t base_doc_id,
+                                                                  ProgressTracker* progress) const {
+    // Словарь делится на непересекающиеся части по хешу слова, по одной на поток.
+    // Каждая часть строится своим потоком, поэтому общая блокировка не нужна.
+    const size_t threads_count = ResolveThreadsCount(indexing_threads);
+
+    // Без бюджета словарь собирается в памяти, при заданном бюджете - через временные файлы;
+    // в обоих случаях сразу в общие массивы
+    IndexSegment::CsrDictionary csr = memory_budget == 0
+        ? _build_csr_in_memory(batch, base_doc_id, threads_count, progress)
+        : _build_csr_external(batch, base_doc_id, threads_count, progress);
+    return std::make_shared<const IndexSegment>(base_doc_id, batch.size(), std::move(csr), false, impact_bits);
+}
+
+IndexSegment::CsrDictionary InvertedIndex::_build_csr_in_memory(
+    const std::vector<DocumentBuffer>& batch, size_t base_doc_id, size_t threads_count, ProgressTracker* progress) const {
+    const size_t partitions_count = threads_count;
+
+    // Параллельно считаем слова в документах (Требование 1)
+    // doc_terms[i][partition] - слова i-го документа пачки из этой части словаря с частотами
+    std::vector<DocumentTerms> doc_terms = _index_documents(batch, partitions_count, threads_count, progress);
+
+    // 1. Первый проход: df каждого слова своей части словаря, число слов, байт и вхождений части.
+    // Слова ссылаются на строки doc_terms, пока они не скопированы в общий массив байт
+    struct Partition {
+        std::unordered_map<std::string_view, size_t> cursors; // df, после разметки - позиция записи вхождений
+        std::vector<std::string_view> words;
+        size_t bytes = 0;
+        size_t entries = 0;
+    };
+    std::vector<Partition> partitions(partitions_count);
+    ParallelFor(partitions_count, threads_count, [&](size_t partition) {
+        Partition& part = partitions[partition];
+        for (const DocumentTerms& terms : doc_terms) {
+            for (const auto& [word, count] : terms[partition]) {
+                ++part.cursors[word];
+            }
+            part.entries += terms[partition].size();
+        }
+        part.words.reserve(part.cursors.size());
+        for (const auto& [word, df] : part.cursors) {
+            part.words.push_back(word);
+            part.bytes += word.size();
+        }
+        std::sort(part.words.begin(), part.words.end());
+    });
+
+    // 2. Каждая часть получает свой блок в общих массивах: слова, байты и вхождения после предыдущих частей
+    std::vector<size_t> terms_base(partitions_count + 1, 0);
+    std::vector<size_t> bytes_base(partitions_count + 1, 0);
+    std::vector<size_t> entries_base(partitions_count + 1, 0);
+    for (size_t partition = 0; partition < partitions_count; ++partition) {
+        terms_base[partition + 1] = terms_base[partition] + partitions[partition].words.size();
+        bytes_base[partition + 1] = bytes_base[partition] + partitions[partition].bytes;
+        entries_base[partition + 1] = entries_base[partition] + partitions[partition].entries;
+    }
+    if (bytes_base.back() > UINT32_MAX) {
+        throw std::length_error("Index segment terms exceed 4 GiB");
+    }
+    if (progress != nullptr) {
+        progress->ThrowIfCancelled();
+    }
+    IndexSegment::CsrDictionary csr;
+    csr.term_bytes.resize(bytes_base.back());
+    csr.terms.resize(terms_base.back());
+    csr.entries.resize(entries_base.back());
+
+    // 3. Второй проход: каждая часть пишет только в свой блок, курсоры не разделяются между потоками.
+    // Документы обходятся по возрастанию doc_id, поэтому вхождения каждого слова сразу отсортированы
+    ParallelFor(partitions_count, threads_count, [&](size_t partition) {
+        Partition& part = partitions[partition];
+
+        // Курсоры переключаются на байты слов в общем массиве: строки документов больше не нужны
+        // как ключи, и каждый документ освобождается сразу после того, как записаны его вхождения
+        std::unordered_map<std::string_view, size_t> cursors;
+        cursors.reserve(part.words.size());
+        size_t offset = bytes_base[partition];
+        size_t begin = entries_base[partition];
+        for (size_t j = 0; j < part.words.size(); ++j) {
+            const std::string_view word = part.words[j];
+            const size_t df = part.cursors.find(word)->second;
+            std::memcpy(csr.term_bytes.data() + offset, word.data(), word.size());
+            csr.terms[terms_base[partition] + j] = {(uint32_t)offset, (uint32_t)word.size(), begin, begin + df};
+            cursors.emplace(std::string_view(csr.term_bytes.data() + offset, word.size()), begin);
+            offset += word.size();
+            begin += df;
+        }
+        part = Partition();
+
+        for (size_t i = 0; i < doc_terms.size(); ++i) {
+            for (const auto& [word, count] : doc_terms[i][partition]) {
+                csr.entries[cursors.find(word)->second++] = Entry(base_doc_id + i, count);
+            }
+            doc_terms[i][partition].clear();
+            doc_terms[i][partition].shrink_to_fit();
+        }
+    });
+
+    // 4. Части по отдельности отсортированы по словам - сливаем их попарно
+    merge_term_blocks(csr, terms_base);
+    return csr;
+}
+
+IndexSegment::CsrDictionary InvertedIndex::_build_csr_external(
+    const std::vector<DocumentBuffer>& batch, size_t base_doc_id, size_t threads_count,
+    ProgressTracker* progress) const {
+    const size_t partitions_count = threads_count;
+    const size_t worker_budget = std::max<size_t>(1, memory_budget / threads_count);
 
-    for (const auto& pair : local_word_counts) {
-        const std::string& word = pair.first;
-        const size_t count = pair.second;
+    static std::atomic<size_t> build_counter{0};
+    const fs::path runs_dir = (temp_directory.empty() ? fs::temp_directory_path() : fs::path(temp_directory))
+        / ("search_engine_runs_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())
+           + "_" + std::to_string(build_counter++));
+    fs::create_directories(runs_dir);
 
-        Entry new_entry(doc_id, count);
+    // runs[partition] - файлы прогонов этой части словаря, entries_count[partition] - записей в них
+    std::vector<std::vector<fs::path>> runs(partitions_count);
+    std::vector<size_t> entries_count(partitions_count, 0);
+    std::mutex runs_mutex;
+    std::atomic<size_t> next_doc{0};
 
-        freq_dictionary[word].push_back(new_entry);
+    try {
+        // 1. Каждый поток копит тройки (слово, документ, частота) и при исчерпании своей доли бюджета
+        // сбрасывает их на диск отсортированными прогонами, по одному на часть словаря
+        ParallelFor(threads_count, threads_count, [&](size_t worker) {
+            std::vector<std::vector<RunRecord>> buffers(partitions_count);
+            size_t buffered_bytes = 0;
+            size_t flushes = 0;
+
+            auto flush = [&] {
+                for (size_t partition = 0; partition < partitions_count; ++partition) {
+                    if (buffers[partition].empty()) {
+                        continue;
+                    }
+                    fs::path path = runs_dir / ("run_w" + std::to_string(worker) + "_" + std::to_string(flushes)
+                                                + "_p" + std::to_string(partition) + ".bin");
+                    RunWriter::Write(path, buffers[partition]);
+                    const size_t written = buffers[partition].size();
+                    buffers[partition].clear();
+                    buffers[partition].shrink_to_fit();
+                    std::lock_guard<std::mutex> lock(runs_mutex);
+                    runs[partition].push_back(std::move(path));
+                    entries_count[partition] += written;
+                }
+                ++flushes;
+                buffered_bytes = 0;
+            };
+
+            for (size_t i = next_doc++; i < batch.size(); i = next_doc++) {
+                if (progress != nullptr && progress->cancelled()) {
+                    break;
+                }
+                DocumentTerms terms = _index_one_document(batch[i].view(), partitions_count);
+                for (size_t partition = 0; partition < partitions_count; ++partition) {
+                    for (auto& [word, count] : terms[partition]) {
+                        RunRecord record{std::move(word), base_doc_id + i, count};
+                        buffered_bytes += record.memory_usage();
+                        buffers[partition].push_back(std::move(record));
+                    }
+                }
+                if (buffered_bytes >= worker_budget) {
+                    flush();
+                }
+                if (progress != nullptr) {
+                    progress->Add(1, batch[i].view().size());
+                }
+            }
+            flush();
+        });
+
+        // Исключение бросается здесь, а не в рабочих потоках; прогоны удаляются ниже
+        if (progress != nullptr) {
+            progress->ThrowIfCancelled();
+        }
+
+        // 2. Число вхождений каждой части известно по записанным прогонам - общий массив вхождений
+        // выделяется один раз, и каждая часть пишет в свой блок
+        std::vector<size_t> entries_base(partitions_count + 1, 0);
+        for (size_t partition = 0; partition < partitions_count; ++partition) {
+            entries_base[partition + 1] = entries_base[partition] + entries_count[partition];
+        }
+        IndexSegment::CsrDictionary csr;
+        csr.entries.resize(entries_base.back());
+
+        // 3. Параллельное k-путевое слияние: каждая часть словаря сливается из своих прогонов независимо.
+        // Прогоны упорядочены по (слово, doc_id), поэтому слова и их вхождения приходят уже отсортированными
+        // и сразу дописываются в массивы части. Части сливаются одновременно, поэтому каждой достаётся доля
+        // MAX_OPEN_RUNS открытых файлов; если прогонов больше, они сначала сливаются промежуточными проходами
+        const size_t max_fan_in = std::max<size_t>(2, MAX_OPEN_RUNS / std::min(threads_count, partitions_count));
+        std::vector<std::string> part_bytes(partitions_count);
+        std::vector<std::vector<IndexSegment::CsrDictionary::Term>> part_terms(partitions_count);
+        ParallelFor(partitions_count, threads_count, [&](size_t partition) {
+            size_t passes = 0;
+            RunMerger::Reduce(runs[partition], max_fan_in, [&] {
+                return runs_dir / ("merge_p" + std::to_string(partition) + "_" + std::to_string(passes++) + ".bin");
+            });
+
+            RunMerger merger(runs[partition]);
+            std::string& bytes = part_bytes[partition];
+            std::vector<IndexSegment::CsrDictionary::Term>& terms = part_terms[partition];
+            size_t cursor = entries_base[partition];
+            RunRecord record;
+            while (merger.Next(record)) {
+                if (terms.empty() || std::string_view(bytes.data() + terms.back().offset, terms.back().length) != record.word) {
+                    if (bytes.size() + record.word.size() > UINT32_MAX) {
+                        throw std::length_error("Index segment terms exceed 4 GiB");
+                    }
+                    // Смещение пока внутри части - сдвигается при переносе в общий массив
+                    terms.push_back({(uint32_t)bytes.size(), (uint32_t)record.word.size(), cursor, cursor});
+                    bytes += record.word;
+                }
+                csr.entries[cursor++] = Entry(record.doc_id, record.count);
+                terms.back().end = cursor;
+            }
+        });
+        fs::remove_all(runs_dir);
+
+        // 4. Байты и слоты частей переносятся в общие массивы; они малы по сравнению с вхождениями
+        std::vector<size_t> terms_base(partitions_count + 1, 0);
+        size_t bytes_total = 0;
+        for (size_t partition = 0; partition < partitions_count; ++partition) {
+            terms_base[partition + 1] = terms_base[partition] + part_terms[partition].size();
+            bytes_total += part_bytes[partition].size();
+        }
+        if (bytes_total > UINT32_MAX) {
+            throw std::length_error("Index segment terms exceed 4 GiB");
+        }
+        csr.term_bytes.reserve(bytes_total);
+        csr.terms.reserve(terms_base.back());
+        for (size_t partition = 0; partition < partitions_count; ++partition) {
+            const auto offset = (uint32_t)csr.term_bytes.size();
+            csr.term_bytes += part_bytes[partition];
+            for (IndexSegment::CsrDictionary::Term term : part_terms[partition]) {
+                term.offset += offset;
+                csr.terms.push_back(term);
+            }
+            part_bytes[partition] = std::string();
+            part_terms[partition] = {};
+        }
+        merge_term_blocks(csr, terms_base);
+        return csr;
+    } catch (...) {
+        std::error_code ec;
+        fs::remove_all(runs_dir, ec);
+        throw;
     }
 }
 
+InvertedIndex::DocumentTerms InvertedIndex::_index_one_document(std::string_view text, size_t partitions_count) const {
+    // 1. Текст документа принадлежит пачке, которая не меняется во время индексации.
+    // Временные структуры документа живут в арене потока и освобождаются разом
+    ScratchArena arena;
+
+    // 2. Разбиваем на слова (Требование 2) - слова ссылаются на буфер документа
+    std::pmr::vector<std::string_view> words = _split_text(text, arena.resource());
+
+    // 3. Считаем локальную частоту слов (Требование 3, 4)
+    // Основы слов берутся из кэша потока: частые слова разбираются один раз
+    const bool stem = stemming;
+    std::pmr::map<std::pmr::string, size_t, std::less<>> local_word_counts(arena.resource());
+    for (std::string_view word : words) {
+        const std::string_view key = stem ? std::string_view(Stemmer::StemCached(word)) : word;
+        auto it = local_word_counts.find(key);
+        if (it == local_word_counts.end()) {
+            it = local_word_counts.emplace(key, 0).first;
+        }
+        ++it->second;
+    }
+
+    // 4. Раскладываем слова по частям словаря (Требование 5 выполняется при сборке частей).
+    // Из арены копируются только слова, которые попадут в словарь
+    DocumentTerms terms(partitions_count);
+    std::hash<std::string_view> hasher;
+    for (const auto& [word, count] : local_word_counts) {
+        const size_t partition = hasher(word) % partitions_count;
+        terms[partition].emplace_back(std::string(word), count);
+    }
+    return terms;
+}
+
+std::vector<InvertedIndex::DocumentTerms> InvertedIndex::_index_documents(const std::vector<DocumentBuffer>& batch,
+                                                                          size_t partitions_count,
+                                                                          size_t threads_count,
+                                                                          ProgressTracker* progress) const {
+    // Задача - несколько мелких документов подряд [first_doc, last_doc) или кусок chunk большого документа
+    struct Task {
+        size_t first_doc = 0;
+        size_t last_doc = 0;
+        std::string_view chunk;
+        size_t chunk_index = 0;
+        size_t bytes = 0;
+    };
+    std::vector<Task> tasks;
+    std::vector<std::vector<DocumentTerms>> chunk_terms(batch.size()); // слова кусков больших документов
+    std::vector<size_t> chunked_docs;
+
+    for (size_t i = 0; i < batch.size();) {
+        const std::string_view text = batch[i].view();
+        if (text.size() > INDEX_CHUNK_BYTES) {
+            // Кусок заканчивается на пробеле, чтобы слово не разрезалось между кусками
+            size_t begin = 0;
+            while (begin < text.size()) {
+                size_t end = std::min(text.size(), begin + INDEX_CHUNK_BYTES);
+                while (end < text.size() && !is_space(text[end])) {
+                    ++end;
+                }
+                tasks.push_back({i, i + 1, text.substr(begin, end - begin), chunk_terms[i].size(), end - begin});
+                chunk_terms[i].emplace_back();
+                begin = end;
+            }
+            chunked_docs.push_back(i);
+            ++i;
+            continue;
+        }
+
+        Task task{i, i, {}, 0, 0};
+        while (task.last_doc < batch.size() && task.bytes < INDEX_TASK_BYTES
+               && batch[task.last_doc].view().size() <= INDEX_CHUNK_BYTES) {
+            task.bytes += batch[task.last_doc].view().size();
+            ++task.last_doc;
+        }
+        tasks.push_back(task);
+        i = task.last_doc;
+    }
+
+    // Сначала самые большие задачи: поток, взявший последнюю, не задерживает остальных надолго
+    std::stable_sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) { return a.bytes > b.bytes; });
+
+    std::vector<DocumentTerms> doc_terms(batch.size());
+    // После отмены оставшиеся задачи пропускаются, исключение бросается уже вне рабочих потоков
+    ParallelFor(tasks.size(), threads_count, [&](size_t t) {
+        const Task& task = tasks[t];
+        if (progress != nullptr && progress->cancelled()) {
+            return;
+        }
+        if (!task.chunk.empty()) {
+            chunk_terms[task.first_doc][task.chunk_index] = _index_one_document(task.chunk, partitions_count);
+        } else {
+            for (size_t i = task.first_doc; i < task.last_doc; ++i) {
+                doc_terms[i] = _index_one_document(batch[i].view(), partitions_count);
+            }
+        }
+        if (progress != nullptr) {
+            // Большой документ считается сделанным после слияния его кусков
+            progress->Add(task.last_doc - task.first_doc - (task.chunk.empty() ? 0 : 1), task.bytes);
+        }
+    });
+    if (progress != nullptr) {
+        progress->ThrowIfCancelled();
+    }
+
+    // Слова кусков одного документа сливаются, частоты одинаковых слов складываются.
+    // Каждая часть словаря каждого документа сливается отдельной задачей
+    for (size_t doc : chunked_docs) {
+        doc_terms[doc].resize(partitions_count);
+    }
+    ParallelFor(chunked_docs.size() * partitions_count, threads_count, [&](size_t job) {
+        const size_t doc = chunked_docs[job / partitions_count];
+        const size_t partition = job % partitions_count;
+        std::vector<std::pair<std::string, size_t>> words;
+        for (DocumentTerms& chunk : chunk_terms[doc]) {
+            std::move(chunk[partition].begin(), chunk[partition].end(), std::back_inserter(words));
+        }
+        std::sort(words.begin(), words.end());
+        auto& merged = doc_terms[doc][partition];
+        for (auto& [word, count] : words) {
+            if (!merged.empty() && merged.back().first == word) {
+                merged.back().second += count;
+            } else {
+                merged.emplace_back(std::move(word), count);
+            }
+        }
+    });
+    if (progress != nullptr) {
+        progress->Add(chunked_docs.size(), 0);
+    }
+    return doc_terms;
+}
+
 /*
 void InvertedIndex::system_index_documents() {
     for (size_t d = 0; d < docs.size(); ++d) {
@@ -109,38 +899,124 @@ void InvertedIndex::system_index_documents() {
 }
 */
 
-std::vector<std::string> InvertedIndex::_split_text(const std::string& text) const {
-    std::vector<std::string> words;
-    std::stringstream ss(text);
-    std::string word;
+std::pmr::vector<std::string_view> InvertedIndex::_split_text(std::string_view text,
+                                                              std::pmr::memory_resource* arena) const {
+    std::pmr::vector<std::string_view> words(arena);
 
-    //выдёргиваем слова из строчного потока
-    while (ss >> word) {
-        words.push_back(word);
+    //выдёргиваем слова прямо из буфера документа
+    size_t pos = 0;
+    while (pos < text.size()) {
+        while (pos < text.size() && is_space(text[pos])) {
+            ++pos;
+        }
+        size_t start = pos;
+        while (pos < text.size() && !is_space(text[pos])) {
+            ++pos;
+        }
+        if (pos > start) {
+            words.push_back(text.substr(start, pos - start));
+        }
     }
     return words;
 }
 
 std::vector<Entry> InvertedIndex::GetWordCount(const std::string& word) {
-    // Захватываем общий (shared) доступ для чтения
+    // Снимок не меняется, поэтому после его получения блокировки не нужны.
     // Несколько потоков могут выполнять этот метод одновременно
+    std::shared_ptr<const IndexSnapshot> current = GetSnapshot();
+    const std::string term = NormalizeTerm(word);
+
+    // Сегменты идут по возрастанию doc_id - склеиваем их вхождения.
+    // Если слова нет нигде, возвращаем пустой вектор
+    std::vector<Entry> entries;
+    std::vector<Entry> expanded;
+    for (const auto& segment : current->segments) {
+        std::span<const Entry> postings = segment->expanded_postings(term, max_expansions, expanded);
+        entries.insert(entries.end(), postings.begin(), postings.end());
+    }
+    std::erase_if(entries, [&](const Entry& entry) { return current->is_deleted(entry.doc_id); });
+    return entries;
+}
+
+std::shared_ptr<const IndexSnapshot> InvertedIndex::GetSnapshot() const {
     std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    return snapshot;
+}
 
-    auto it = freq_dictionary.find(word);
+void InvertedIndex::SetIndexingThreads(size_t threads_count) {
+    indexing_threads = threads_count;
+}
+
+void InvertedIndex::SetMaxExpansions(size_t expansions) {
+    max_expansions = expansions;
+}
 
-    if (it == freq_dictionary.end()) {
-        // Если слова нет, возвращаем пустой вектор
-        return {};
-    } else {
-        // Возвращаем копию вектора вхождений
-        return it->second;
+void InvertedIndex::SetImpactQuantization(size_t bits) {
+    if (bits != 0 && bits != 8 && bits != 16) {
+        throw std::invalid_argument("impact bits must be 0, 8 or 16");
+    }
+    // Импакты считаются при построении сегмента: у готовых сегментов они остались бы прежними
+    std::lock_guard<std::mutex> ingest_lock(ingest_mutex);
+    if (bits != impact_bits && (!GetSnapshot()->segments.empty() || !pending_docs.empty())) {
+        throw std::logic_error("Impact quantization cannot change after documents are indexed");
     }
+    impact_bits = bits;
 }
 
-const std::map<std::string, std::vector<Entry>>& InvertedIndex::GetFrequencyDictionary() const {
+void InvertedIndex::SetStemming(bool enabled) {
+    stemming = enabled;
+}
+
+std::string InvertedIndex::NormalizeTerm(std::string_view word) const {
+    if (!stemming || TermDictionary::IsPattern(word)) {
+        return std::string(word);
+    }
+    TermDictionary::FuzzyQuery fuzzy;
+    if (TermDictionary::ParseFuzzy(word, fuzzy)) {
+        return Stemmer::StemCached(fuzzy.word) + std::string(word.substr(fuzzy.word.size()));
+    }
+    return Stemmer::StemCached(word);
+}
+
+void InvertedIndex::SetMemoryBudget(size_t bytes, const std::string& temp_dir) {
+    memory_budget = bytes;
+    temp_directory = temp_dir;
+}
+
+std::map<std::string, std::vector<Entry>> InvertedIndex::GetFrequencyDictionary() const {
+    std::shared_ptr<const IndexSnapshot> current = GetSnapshot();
+    std::map<std::string, std::vector<Entry>> freq_dictionary;
+    for (const auto& segment : current->segments) {
+        for (size_t i = 0; i < segment->term_count(); ++i) {
+            const std::string word(segment->term(i));
+            auto& merged = freq_dictionary[word];
+            for (const Entry& entry : segment->postings_at(i)) {
+                if (!current->is_deleted(entry.doc_id)) {
+                    merged.push_back(entry);
+                }
+            }
+            if (merged.empty()) {
+                freq_dictionary.erase(word);
+            }
+        }
+    }
     return freq_dictionary;
 }
 
+IndexSegment::MemoryUsage InvertedIndex::GetMemoryUsage() const {
+    IndexSegment::MemoryUsage usage;
+    for (const auto& segment : GetSnapshot()->segments) {
+        usage += segment->memory_usage();
+    }
+    return usage;
+}
+
 std::vector<std::string> InvertedIndex::GetDocuments() const {
-    return docs;
+    std::shared_lock<std::shared_mutex> lock(rw_mutex);
+    std::vector<std::string> texts;
+    texts.reserve(docs.size());
+    for (const DocumentBuffer& doc : docs) {
+        texts.emplace_back(doc.view());
+    }
+    return texts;
 }
\ No newline at end of file
@@ -11,54 +11,265 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <memory_resource>
 #include <cstddef>
 #include <mutex>         // Для std::mutex и std::lock_guard (или shared_mutex)
 #include <shared_mutex>
+#include <string_view>
+#include <atomic>
+#include <condition_variable>
+#include <stop_token>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include "DocumentLoader.h"
+#include "IndexingProgress.h"
+#include "IndexSegment.h"
+#include "WriteAheadLog.h"
 
-struct Entry {
-    size_t doc_id;
-    size_t count;
+// Согласованный набор сегментов на момент запроса. Живёт, пока его держит хотя бы один поиск.
+struct IndexSnapshot {
+    std::vector<std::shared_ptr<const IndexSegment>> segments; // по возрастанию base_doc_id
+    size_t doc_count = 0;
 
-    bool operator== (const Entry& other) const {
-        return (doc_id == other.doc_id) && (count == other.count);
-    }
+    // Удалённые документы; их вхождения выбрасываются при слиянии сегментов
+    std::shared_ptr<const std::unordered_set<size_t>> deleted = std::make_shared<const std::unordered_set<size_t>>();
 
-    Entry(size_t id, size_t c) : doc_id(id), count(c) {}
+    bool is_deleted(size_t doc_id) const { return !deleted->empty() && deleted->count(doc_id) > 0; }
 };
 
+/* Индекс из неизменяемых сегментов (LSM).
+* UpdateDocumentBase строит один сегмент по всей базе. AddDocuments копит новые документы в буфере,
+* который сбрасывается в маленький сегмент по порогу, по таймеру или через Flush() - только после этого
+* документы видны поиску. Фоновый поток сливает соседние сегменты одного яруса, ограничивая их количество.
+* Поиск работает со снимком и не ждёт ни индексации, ни слияний.
+*/
 class InvertedIndex {
 public:
     InvertedIndex() = default;
 
-    //добавил указатель
-    void UpdateDocumentBase(const std::vector<std::string>& input_docs);
+    ~InvertedIndex();
 
-    //словарь частоты слов
-    const std::map<std::string, std::vector<Entry>>& GetFrequencyDictionary() const;
+    InvertedIndex(const InvertedIndex&) = delete;
+    InvertedIndex& operator=(const InvertedIndex&) = delete;
+
+    /* Перестраивает индекс по input_docs. Через stop сборку можно остановить: потоки индексации проверяют его
+    * между задачами, UpdateDocumentBase бросает IndexingCancelled, а прежний индекс остаётся нетронутым.
+    */
+    void UpdateDocumentBase(const std::vector<std::string>& input_docs, std::stop_token stop = {});
+
+    // Индексация загруженных DocumentLoader буферов без копирования текста. Индекс становится их владельцем.
+    void UpdateDocumentBase(std::vector<DocumentBuffer> input_docs, std::stop_token stop = {});
+
+    /* Наблюдатель за UpdateDocumentBase: вызывается из потоков индексации не чаще раза в interval
+    * и один раз по окончании сборки. Задаётся до построения индекса.
+    * Вызов идёт под ingest_mutex, поэтому AddDocuments, UpdateDocumentBase и другие методы, берущие
+    * эту блокировку, из наблюдателя вызывать нельзя - будет взаимная блокировка. Отмена - через stop_token.
+    */
+    void SetProgressCallback(ProgressCallback callback,
+                             std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
+    // Добавляет документы без перестроения индекса. Возвращает doc_id первого из них.
+    size_t AddDocuments(const std::vector<std::string>& input_docs);
+
+    size_t AddDocuments(std::vector<DocumentBuffer> input_docs);
+
+    // Удаляет документ из результатов поиска; doc_id остальных документов не меняются. false - нет такого документа.
+    bool RemoveDocument(size_t doc_id);
+
+    // Сбрасывает буфер новых документов в сегмент, после чего они видны поиску
+    void Flush();
+
+    /* Включает долговременное хранение: загружает сохранённый индекс из snapshot_path (если он есть),
+    * применяет поверх него журнал wal_path и дальше пишет в журнал каждое добавление и удаление.
+    * Возвращает число применённых из журнала операций.
+    */
+    size_t OpenStorage(const std::string& snapshot_path, const std::string& wal_path);
+
+    // Сохраняет индекс в snapshot_path и очищает журнал. Без OpenStorage ничего не делает.
+    void Checkpoint();
+
+    // Ждёт, пока фоновый поток не закончит все положенные слияния
+    void WaitForMerges();
+
+    /* Замораживает индекс: сбрасывает буфер и сливает все сегменты в один замороженный сегмент,
+    * слова которого ищутся минимальным совершенным хешем. После этого AddDocuments и RemoveDocument
+    * бросают std::logic_error; UpdateDocumentBase строит обычный изменяемый индекс.
+    */
+    void Freeze();
+
+    bool IsFrozen() const { return frozen; }
+
+    //словарь частоты слов (собирается по всем сегментам)
+    std::map<std::string, std::vector<Entry>> GetFrequencyDictionary() const;
+
+    // Память индекса по частям (сумма по сегментам); слова одного сегмента считаются отдельно от другого
+    IndexSegment::MemoryUsage GetMemoryUsage() const;
 
     std::vector<std::string> GetDocuments() const;
 
+    // Слово может быть шаблоном (capit*, ?ome): вхождения подходящих слов объединяются
     std::vector<Entry> GetWordCount(const std::string& word);
 
+    std::shared_ptr<const IndexSnapshot> GetSnapshot() const;
+
+    // Число потоков индексации (0 - по числу ядер)
+    void SetIndexingThreads(size_t threads_count);
+
+    // Сколько слов сегмента самое большее подставляется вместо одного шаблона
+    void SetMaxExpansions(size_t expansions);
+
+    /* Квантование частот BM25 при индексации в 8 или 16 бит (0 - выключено), см. QuantizeImpact.
+    * Задаётся до построения индекса: если документы уже проиндексированы, другое значение
+    * отвергается std::logic_error. Нужно для Ranking::Impact - подсчёт релевантности в целых числах,
+    * idf при этом берётся по всему индексу, как у Ranking::Bm25.
+    */
+    void SetImpactQuantization(size_t bits);
+
+    size_t GetImpactBits() const { return impact_bits; }
+
+    /* Выделение основ слов (Stemmer) при индексации. Меняется только до построения индекса:
+    * документы, проиндексированные с другим значением, по основам не найдутся.
+    */
+    void SetStemming(bool enabled);
+
+    bool IsStemming() const { return stemming; }
+
+    /* Слово запроса в том виде, в котором оно хранится в индексе: при включённом выделении основ
+    * обычные и нечёткие (слово~) слова заменяются основой, шаблоны не меняются.
+    */
+    std::string NormalizeTerm(std::string_view word) const;
+
+    size_t GetMaxExpansions() const { return max_expansions; }
+
+    /* Бюджет памяти на промежуточные данные индексации в байтах (0 - без ограничения).
+    * При ненулевом бюджете слова сбрасываются отсортированными прогонами во временные файлы
+    * в temp_dir (по умолчанию системный каталог) и затем сливаются в итоговый словарь.
+    */
+    void SetMemoryBudget(size_t bytes, const std::string& temp_dir = "");
+
+    // Размер задачи индексации из мелких документов и куска большого документа, в байтах
+    static constexpr size_t INDEX_TASK_BYTES = 64 * 1024;
+    static constexpr size_t INDEX_CHUNK_BYTES = 4 * 1024 * 1024;
+
+    // Сколько файлов прогонов самое большее открыто при слиянии (на все части словаря вместе)
+    static constexpr size_t MAX_OPEN_RUNS = 256;
+
+    /* Параметры сегментов: буфер сбрасывается при flush_threshold документах или раз в flush_interval;
+    * merge_factor соседних сегментов одного яруса сливаются в один.
+    */
+    void SetSegmentPolicy(size_t flush_threshold, std::chrono::milliseconds flush_interval, size_t merge_factor);
+
 private:
 
+    // Слова одного документа с частотами, разложенные по частям словаря
+    using DocumentTerms = std::vector<std::vector<std::pair<std::string, size_t>>>;
+
     //void system_index_documents();
 
-    void _index_one_document(size_t doc_id);
+    DocumentTerms _index_one_document(std::string_view text, size_t partitions_count) const;
+
+    /* Слова всех документов пачки; progress (может быть nullptr) получает обработанные документы. Работа делится по байтам: мелкие документы идут задачами
+    * по INDEX_TASK_BYTES, документы больше INDEX_CHUNK_BYTES режутся по пробелам на куски, которые
+    * разбираются параллельно и затем сливаются в один документ. Задачи выполняются от больших к малым.
+    */
+    std::vector<DocumentTerms> _index_documents(const std::vector<DocumentBuffer>& batch, size_t partitions_count,
+                                                size_t threads_count, ProgressTracker* progress) const;
+
+    /* Строит сегмент по документам batch, которым присваиваются doc_id начиная с base_doc_id.
+    * С progress сборка отчитывается о ходе и бросает IndexingCancelled после отмены.
+    */
+    std::shared_ptr<const IndexSegment> _build_segment(const std::vector<DocumentBuffer>& batch, size_t base_doc_id,
+                                                       ProgressTracker* progress = nullptr) const;
+
+    /* Двухпроходная сборка в памяти: первый проход считает df слов каждой части словаря,
+    * второй раскладывает вхождения по заранее вычисленным диапазонам одного общего массива
+    */
+    IndexSegment::CsrDictionary _build_csr_in_memory(const std::vector<DocumentBuffer>& batch, size_t base_doc_id,
+                                                     size_t threads_count, ProgressTracker* progress) const;
+
+    /* Внешняя сортировка: прогоны на диске + параллельное k-путевое слияние. Слияние пишет слова
+    * и вхождения сразу в общие массивы: массив вхождений выделяется один раз по числу записей в прогонах
+    */
+    IndexSegment::CsrDictionary _build_csr_external(const std::vector<DocumentBuffer>& batch, size_t base_doc_id,
+                                                    size_t threads_count, ProgressTracker* progress) const;
+
+    // Сброс буфера; вызывается под ingest_mutex
+    void _flush_pending();
+
+    // Публикует снимок с добавленным сегментом и будит фоновый поток
+    void _publish_segment(std::shared_ptr<const IndexSegment> segment, std::vector<DocumentBuffer> batch);
+
+    // Одно слияние по ярусной политике. false - сливать нечего.
+    bool _merge_once();
+
+    void _background_loop();
+
+    void _ensure_background_thread();
 
-    //разбиение на слова
-    std::vector<std::string> _split_text(const std::string& text) const;
+    // Запись и чтение файла сохранённого индекса. _load_snapshot возвращает lsn, на котором он сделан.
+    void _save_snapshot(const std::string& path, uint64_t lsn) const;
 
-    std::vector<std::string> docs;
+    uint64_t _load_snapshot(const std::string& path);
 
-    std::map<std::string, std::vector<Entry>> freq_dictionary;
+    // Checkpoint; вызывается под ingest_mutex
+    void _checkpoint();
 
-    /*Мьютекс для безопасного доступа к freq_dictionary.
+    //разбиение на слова; слова ссылаются на text, вектор размещается в arena
+    std::pmr::vector<std::string_view> _split_text(std::string_view text, std::pmr::memory_resource* arena) const;
+
+    std::vector<DocumentBuffer> docs;
+
+    // Текущий набор сегментов; списки вхождений в сегментах отсортированы по doc_id
+    std::shared_ptr<const IndexSnapshot> snapshot = std::make_shared<const IndexSnapshot>();
+
+    size_t indexing_threads = 0;
+
+    std::atomic<size_t> max_expansions{128};
+
+    std::atomic<bool> stemming{false};
+
+    std::atomic<size_t> impact_bits{0};
+
+    // Меняется под ingest_mutex
+    std::atomic<bool> frozen{false};
+
+    size_t memory_budget = 0;
+
+    std::string temp_directory;
+
+    ProgressCallback progress_callback;
+    std::chrono::milliseconds progress_interval{1000};
+
+    /*Мьютекс для безопасного доступа к snapshot и docs.
     * Использую shared_mutex, чтобы разрешить одновременное чтение (GetWordCount)
-    * и эксклюзивную запись (во время индексации).
+    * и эксклюзивную запись (при публикации сегмента).
     */
     mutable std::shared_mutex rw_mutex;
-};
 
+    // Буфер новых документов, ещё не сброшенных в сегмент
+    std::mutex ingest_mutex;
+    std::vector<DocumentBuffer> pending_docs;
+    size_t next_doc_id = 0;
+
+    // Журнал изменений; nullptr, пока не вызван OpenStorage. Пишется под ingest_mutex.
+    std::unique_ptr<WriteAheadLog> wal;
+    std::string snapshot_file;
+
+    // Параметры читаются фоновым потоком без захвата ingest_mutex
+    std::atomic<size_t> flush_threshold{1000};
+    std::atomic<std::chrono::milliseconds> flush_interval{std::chrono::milliseconds(1000)};
+    std::atomic<size_t> merge_factor{4};
+
+    // Фоновый поток сброса и слияния
+    std::mutex background_mutex;
+    std::condition_variable background_cv;
+    std::condition_variable merges_done_cv;
+    std::thread background_thread;
+    bool stop_background = false;
+    bool merge_requested = false;
+    bool merging = false;
+};
 
 #endif //SEARCH_ENGINE_INVERTEDINDEX_H
\ No newline at end of file
@@ -0,0 +1,57 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_PARALLELFOR_H
+#define SEARCH_ENGINE_PARALLELFOR_H
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Количество рабочих потоков по умолчанию (0 - по числу ядер)
+inline size_t ResolveThreadsCount(size_t threads_count) {
+    if (threads_count == 0) {
+        threads_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return threads_count;
+}
+
+/* Выполняет func(i) для i из [0, count) на пуле из threads_count потоков.
+ * Потоки разбирают индексы по одному через атомарный счётчик, поэтому
+ * неравные по стоимости задачи распределяются сами собой.
+ */
+template <typename Func>
+void ParallelFor(size_t count, size_t threads_count, Func&& func) {
+    threads_count = std::min(ResolveThreadsCount(threads_count), count);
+    if (threads_count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed)) {
+            func(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threads_count - 1);
+    for (size_t t = 1; t < threads_count; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker(); // текущий поток тоже работает
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+#endif //SEARCH_ENGINE_PARALLELFOR_H
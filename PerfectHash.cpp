@@ -0,0 +1,100 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "PerfectHash.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+
+constexpr size_t BLOCK_WORDS = 8;
+
+} // namespace
+
+uint64_t PerfectHash::_position_hash(uint64_t hash, size_t level) {
+    // splitmix64 от хеша ключа и номера уровня: на каждом уровне позиции независимы
+    uint64_t x = hash + 0x9E3779B97F4A7C15ull * (level + 1);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+PerfectHash::PerfectHash(std::span<const uint64_t> hashes, double gamma) : _size(hashes.size()) {
+    std::vector<uint64_t> keys(hashes.begin(), hashes.end());
+    std::vector<uint64_t> collisions;
+    std::vector<uint64_t> next;
+
+    for (size_t level = 0; level < MAX_LEVELS && !keys.empty(); ++level) {
+        const size_t bits = std::max<size_t>(64, ((size_t)std::ceil(gamma * (double)keys.size()) + 63) / 64 * 64);
+        const size_t offset = _bits.size() * 64;
+        _levels.push_back({offset, bits});
+        _bits.resize(_bits.size() + bits / 64, 0);
+        collisions.assign(bits / 64, 0);
+
+        // 1. Отмечаем занятые позиции; повторное попадание - коллизия
+        uint64_t* level_bits = _bits.data() + offset / 64;
+        for (uint64_t key : keys) {
+            const size_t pos = _position_hash(key, level) % bits;
+            const uint64_t mask = uint64_t(1) << (pos % 64);
+            if (level_bits[pos / 64] & mask) {
+                collisions[pos / 64] |= mask;
+            }
+            level_bits[pos / 64] |= mask;
+        }
+
+        // 2. На уровне остаются только ключи без коллизий, остальные - на следующий уровень
+        next.clear();
+        for (size_t word = 0; word < collisions.size(); ++word) {
+            level_bits[word] &= ~collisions[word];
+        }
+        for (uint64_t key : keys) {
+            const size_t pos = _position_hash(key, level) % bits;
+            if (collisions[pos / 64] & (uint64_t(1) << (pos % 64))) {
+                next.push_back(key);
+            }
+        }
+        keys.swap(next);
+    }
+
+    _block_rank.resize(_bits.size() / BLOCK_WORDS + 1);
+    uint32_t count = 0;
+    for (size_t word = 0; word < _bits.size(); ++word) {
+        if (word % BLOCK_WORDS == 0) {
+            _block_rank[word / BLOCK_WORDS] = count;
+        }
+        count += (uint32_t)std::popcount(_bits[word]);
+    }
+
+    // Оставшиеся ключи получают номера после всех уровней
+    std::sort(keys.begin(), keys.end());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        _fallback.emplace_back(keys[i], (size_t)count + i);
+    }
+}
+
+size_t PerfectHash::_rank(size_t position) const {
+    const size_t word = position / 64;
+    size_t rank = _block_rank[word / BLOCK_WORDS];
+    for (size_t w = word - word % BLOCK_WORDS; w < word; ++w) {
+        rank += (size_t)std::popcount(_bits[w]);
+    }
+    return rank + (size_t)std::popcount(_bits[word] & ((uint64_t(1) << (position % 64)) - 1));
+}
+
+size_t PerfectHash::Lookup(uint64_t hash) const {
+    for (size_t level = 0; level < _levels.size(); ++level) {
+        const size_t pos = _levels[level].offset + _position_hash(hash, level) % _levels[level].size;
+        if ((_bits[pos / 64] >> (pos % 64)) & 1) {
+            return _rank(pos);
+        }
+    }
+    auto it = std::lower_bound(_fallback.begin(), _fallback.end(), std::make_pair(hash, size_t(0)));
+    return it != _fallback.end() && it->first == hash ? it->second : NOT_FOUND;
+}
+
+size_t PerfectHash::memory_usage() const {
+    return _levels.capacity() * sizeof(Level) + _bits.capacity() * sizeof(uint64_t)
+           + _block_rank.capacity() * sizeof(uint32_t) + _fallback.capacity() * sizeof(_fallback[0]);
+}
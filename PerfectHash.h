@@ -0,0 +1,57 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_PERFECTHASH_H
+#define SEARCH_ENGINE_PERFECTHASH_H
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+/* Минимальный совершенный хеш в духе BBHash: взаимно однозначно отображает заданное множество
+ * 64-битных хешей ключей в [0, size). Уровень - битовый массив в gamma раз длиннее числа оставшихся ключей;
+ * ключ без коллизий на уровне отмечается единицей, с коллизией - уходит на следующий уровень.
+ * Номер ключа - число единиц перед его битом. Около 3 бит на ключ при gamma = 2.
+ * Для хеша не из множества Lookup возвращает произвольный номер или NOT_FOUND - ключ надо проверять.
+ */
+class PerfectHash {
+public:
+    static constexpr size_t NOT_FOUND = std::numeric_limits<size_t>::max();
+    static constexpr size_t MAX_LEVELS = 32;
+
+    PerfectHash() = default;
+
+    // hashes не должны повторяться: у одинаковых хешей номера совпадут
+    explicit PerfectHash(std::span<const uint64_t> hashes, double gamma = 2.0);
+
+    size_t Lookup(uint64_t hash) const;
+
+    size_t size() const { return _size; }
+
+    size_t memory_usage() const;
+
+private:
+    struct Level {
+        size_t offset = 0; // первый бит уровня в _bits
+        size_t size = 0;   // бит в уровне, кратно 64
+    };
+
+    static uint64_t _position_hash(uint64_t hash, size_t level);
+
+    // Число единиц в _bits перед битом position
+    size_t _rank(size_t position) const;
+
+    std::vector<Level> _levels;
+    std::vector<uint64_t> _bits;
+    std::vector<uint32_t> _block_rank; // единиц перед каждым блоком из 8 слов
+    std::vector<std::pair<uint64_t, size_t>> _fallback; // ключи, не разместившиеся за MAX_LEVELS уровней
+    size_t _size = 0;
+};
+
+#endif //SEARCH_ENGINE_PERFECTHASH_H
@@ -0,0 +1,275 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "PostingIterator.h"
+#include <algorithm>
+
+namespace {
+
+class EmptyIterator : public PostingIterator {
+public:
+    size_t next() override { return END; }
+    size_t advance(size_t) override { return END; }
+    size_t score() const override { return 0; }
+    size_t cost() const override { return 0; }
+};
+
+// Все документы [first, end) - положительная часть для NOT без слов рядом
+class RangeIterator : public PostingIterator {
+public:
+    RangeIterator(size_t first, size_t end) : _end(end) {
+        _doc = first < end ? first : END;
+    }
+
+    size_t next() override { return _doc = _doc != END && _doc + 1 < _end ? _doc + 1 : END; }
+
+    size_t advance(size_t target) override {
+        if (_doc >= target) {
+            return _doc;
+        }
+        return _doc = target < _end ? target : END;
+    }
+
+    size_t score() const override { return 0; }
+    size_t cost() const override { return _doc == END ? 0 : _end - _doc; }
+
+private:
+    size_t _end;
+};
+
+// Список вхождений одного слова; advance - экспоненциальный шаг и двоичный поиск
+class TermIterator : public PostingIterator {
+public:
+    explicit TermIterator(std::span<const Entry> entries) : _entries(entries) {
+        _doc = entries.empty() ? END : entries.front().doc_id;
+    }
+
+    size_t next() override {
+        return _doc = ++_pos < _entries.size() ? _entries[_pos].doc_id : END;
+    }
+
+    size_t advance(size_t target) override {
+        if (_doc >= target) {
+            return _doc;
+        }
+        size_t bound = 1;
+        while (_pos + bound < _entries.size() && _entries[_pos + bound].doc_id < target) {
+            bound *= 2;
+        }
+        const auto first = _entries.begin() + (ptrdiff_t)(_pos + bound / 2);
+        const auto last = _entries.begin() + (ptrdiff_t)std::min(_pos + bound + 1, _entries.size());
+        _pos = (size_t)(std::lower_bound(first, last, target,
+            [](const Entry& entry, size_t id) { return entry.doc_id < id; }) - _entries.begin());
+        return _doc = _pos < _entries.size() ? _entries[_pos].doc_id : END;
+    }
+
+    size_t score() const override { return _entries[_pos].count; }
+    size_t cost() const override { return _entries.size(); }
+
+private:
+    std::span<const Entry> _entries;
+    size_t _pos = 0;
+};
+
+/* Пересечение: самый редкий операнд предлагает документ, остальные подтягиваются к нему advance;
+ * кто ушёл дальше - тот предлагает следующего кандидата. Исключённые (NOT) проверяются последними.
+ */
+class AndIterator : public PostingIterator {
+public:
+    AndIterator(std::vector<std::unique_ptr<PostingIterator>> children,
+                std::vector<std::unique_ptr<PostingIterator>> excluded)
+        : _children(std::move(children)), _excluded(std::move(excluded)) {
+        std::stable_sort(_children.begin(), _children.end(),
+                         [](const auto& a, const auto& b) { return a->cost() < b->cost(); });
+        _doc = _align(_children.front()->doc());
+    }
+
+    size_t next() override {
+        return _doc = _doc == END ? END : _align(_doc + 1);
+    }
+
+    size_t advance(size_t target) override {
+        return _doc >= target ? _doc : _doc = _align(target);
+    }
+
+    size_t score() const override {
+        size_t total = 0;
+        for (const auto& child : _children) {
+            total += child->score();
+        }
+        return total;
+    }
+
+    size_t cost() const override { return _children.front()->cost(); }
+
+private:
+    // Первый документ >= target, который есть у всех операндов и нет ни у одного исключённого
+    size_t _align(size_t target) {
+        while (target != END) {
+            target = _children.front()->advance(target);
+            bool matched = target != END;
+            for (size_t i = 1; i < _children.size() && matched; ++i) {
+                const size_t doc = _children[i]->advance(target);
+                if (doc != target) {
+                    target = doc;
+                    matched = false;
+                }
+            }
+            if (!matched) {
+                continue;
+            }
+            const bool excluded = std::any_of(_excluded.begin(), _excluded.end(),
+                [&](const auto& child) { return child->advance(target) == target; });
+            if (!excluded) {
+                return target;
+            }
+            ++target;
+        }
+        return END;
+    }
+
+    std::vector<std::unique_ptr<PostingIterator>> _children;
+    std::vector<std::unique_ptr<PostingIterator>> _excluded;
+};
+
+// Объединение: текущий документ - наименьший среди операндов
+class OrIterator : public PostingIterator {
+public:
+    explicit OrIterator(std::vector<std::unique_ptr<PostingIterator>> children) : _children(std::move(children)) {
+        _doc = _min_doc();
+    }
+
+    size_t next() override {
+        if (_doc == END) {
+            return END;
+        }
+        for (const auto& child : _children) {
+            if (child->doc() == _doc) {
+                child->next();
+            }
+        }
+        return _doc = _min_doc();
+    }
+
+    size_t advance(size_t target) override {
+        if (_doc >= target) {
+            return _doc;
+        }
+        for (const auto& child : _children) {
+            child->advance(target);
+        }
+        return _doc = _min_doc();
+    }
+
+    size_t score() const override {
+        size_t total = 0;
+        for (const auto& child : _children) {
+            if (child->doc() == _doc) {
+                total += child->score();
+            }
+        }
+        return total;
+    }
+
+    size_t cost() const override {
+        size_t total = 0;
+        for (const auto& child : _children) {
+            total += child->cost();
+        }
+        return total;
+    }
+
+private:
+    size_t _min_doc() const {
+        size_t doc = END;
+        for (const auto& child : _children) {
+            doc = std::min(doc, child->doc());
+        }
+        return doc;
+    }
+
+    std::vector<std::unique_ptr<PostingIterator>> _children;
+};
+
+} // namespace
+
+std::unique_ptr<PostingIterator> PostingIterator::Build(const QueryNode& node, const Lookup& lookup,
+                                                       size_t first_doc, size_t end_doc) {
+    // NOT x без положительной части: все документы сегмента, кроме документов x
+    auto complement = [&](std::vector<std::unique_ptr<PostingIterator>> excluded) -> std::unique_ptr<PostingIterator> {
+        std::vector<std::unique_ptr<PostingIterator>> all;
+        all.push_back(std::make_unique<RangeIterator>(first_doc, end_doc));
+        if (excluded.empty() || all.front()->doc() == END) {
+            return std::move(all.front());
+        }
+        return std::make_unique<AndIterator>(std::move(all), std::move(excluded));
+    };
+
+    switch (node.kind) {
+        case QueryNode::Kind::Term: {
+            std::span<const Entry> entries = lookup(node.term);
+            if (entries.empty()) {
+                return std::make_unique<EmptyIterator>();
+            }
+            return std::make_unique<TermIterator>(entries);
+        }
+        case QueryNode::Kind::Not: {
+            std::vector<std::unique_ptr<PostingIterator>> excluded;
+            auto iterator = Build(node.children.front(), lookup, first_doc, end_doc);
+            if (iterator->doc() != END) {
+                excluded.push_back(std::move(iterator));
+            }
+            return complement(std::move(excluded));
+        }
+        case QueryNode::Kind::And: {
+            if (node.children.empty()) {
+                return std::make_unique<EmptyIterator>(); // пустой запрос
+            }
+            std::vector<std::unique_ptr<PostingIterator>> children;
+            std::vector<std::unique_ptr<PostingIterator>> excluded;
+            for (const QueryNode& child : node.children) {
+                if (child.kind == QueryNode::Kind::Not) {
+                    continue;
+                }
+                children.push_back(Build(child, lookup, first_doc, end_doc));
+                if (children.back()->doc() == END) {
+                    return std::make_unique<EmptyIterator>();
+                }
+            }
+            // Исключения раскрываются только когда положительная часть не пуста
+            for (const QueryNode& child : node.children) {
+                if (child.kind == QueryNode::Kind::Not) {
+                    auto iterator = Build(child.children.front(), lookup, first_doc, end_doc);
+                    if (iterator->doc() != END) {
+                        excluded.push_back(std::move(iterator));
+                    }
+                }
+            }
+            if (children.empty()) {
+                return complement(std::move(excluded)); // AND из одних NOT
+            }
+            if (children.size() == 1 && excluded.empty()) {
+                return std::move(children.front());
+            }
+            return std::make_unique<AndIterator>(std::move(children), std::move(excluded));
+        }
+        case QueryNode::Kind::Or: {
+            std::vector<std::unique_ptr<PostingIterator>> children;
+            for (const QueryNode& child : node.children) {
+                auto iterator = Build(child, lookup, first_doc, end_doc);
+                if (iterator->doc() != END) {
+                    children.push_back(std::move(iterator));
+                }
+            }
+            if (children.empty()) {
+                return std::make_unique<EmptyIterator>();
+            }
+            if (children.size() == 1) {
+                return std::move(children.front());
+            }
+            return std::make_unique<OrIterator>(std::move(children));
+        }
+    }
+    return std::make_unique<EmptyIterator>();
+}
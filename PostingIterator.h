@@ -0,0 +1,60 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_POSTINGITERATOR_H
+#define SEARCH_ENGINE_POSTINGITERATOR_H
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "IndexSegment.h"
+#include "QueryParser.h"
+
+/* Итератор по возрастающим doc_id документов, подходящих под (под)запрос.
+ * Сразу после создания стоит на первом документе; END - документы кончились.
+ * advance(target) перескакивает к первому документу >= target, не читая промежуточные вхождения,
+ * поэтому AND и NOT проходят длинные списки скачками, а не сливают их целиком.
+ */
+class PostingIterator {
+public:
+    static constexpr size_t END = std::numeric_limits<size_t>::max();
+
+    virtual ~PostingIterator() = default;
+
+    size_t doc() const { return _doc; }
+
+    virtual size_t next() = 0;
+
+    // Ничего не делает, если текущий документ уже >= target
+    virtual size_t advance(size_t target) = 0;
+
+    // Сумма частот слов запроса в текущем документе
+    virtual size_t score() const = 0;
+
+    // Оценка числа документов - по ней упорядочиваются операнды AND
+    virtual size_t cost() const = 0;
+
+    // Вхождения слова в сегменте (пустые, если слова нет)
+    using Lookup = std::function<std::span<const Entry>(const std::string& term)>;
+
+    /* Дерево итераторов по дереву запроса для документов сегмента [first_doc, end_doc).
+    * Операнды AND читаются по одному: если слова нет, остальные (в том числе шаблоны) не раскрываются.
+    * NOT внутри AND исключает документы; отдельно стоящее NOT (и AND из одних NOT) - дополнение
+    * до всех документов сегмента. Удалённые документы отсеивает вызывающий. Релевантность считается
+    * по найденным словам: у документов, подходящих только через NOT, она нулевая.
+    */
+    static std::unique_ptr<PostingIterator> Build(const QueryNode& node, const Lookup& lookup,
+                                                  size_t first_doc, size_t end_doc);
+
+protected:
+    size_t _doc = END;
+};
+
+#endif //SEARCH_ENGINE_POSTINGITERATOR_H
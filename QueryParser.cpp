@@ -0,0 +1,182 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "QueryParser.h"
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+bool is_operator(const std::string& token) {
+    return token == "AND" || token == "OR" || token == "NOT";
+}
+
+// Добавляет операнд, раскрывая вложенный узел того же вида: (a AND b) AND c - это AND(a, b, c)
+void add_child(QueryNode& parent, QueryNode child) {
+    if (child.kind == parent.kind && child.kind != QueryNode::Kind::Term && child.kind != QueryNode::Kind::Not) {
+        for (QueryNode& grandchild : child.children) {
+            parent.children.push_back(std::move(grandchild));
+        }
+    } else {
+        parent.children.push_back(std::move(child));
+    }
+}
+
+// Узел из одного операнда заменяется самим операндом
+QueryNode collapse(QueryNode node) {
+    if (node.children.size() == 1) {
+        return std::move(node.children.front());
+    }
+    return node;
+}
+
+} // namespace
+
+std::vector<std::string> QueryParser::_tokenize(std::string_view query) {
+    // Скобки отделяются от слов: "(cat" - это "(" и "cat"
+    std::vector<std::string> tokens;
+    std::stringstream ss{std::string(query)};
+    std::string word;
+    while (ss >> word) {
+        size_t begin = 0;
+        size_t end = word.size();
+        for (; begin < end && word[begin] == '('; ++begin) {
+            tokens.emplace_back("(");
+        }
+        size_t closing = 0;
+        for (; end > begin && word[end - 1] == ')'; --end) {
+            ++closing;
+        }
+        if (begin < end) {
+            tokens.push_back(word.substr(begin, end - begin));
+        }
+        tokens.insert(tokens.end(), closing, ")");
+    }
+    return tokens;
+}
+
+bool QueryParser::IsBoolean(std::string_view query) {
+    for (const std::string& token : _tokenize(query)) {
+        if (is_operator(token) || token == "(" || token == ")") {
+            return true;
+        }
+    }
+    return false;
+}
+
+QueryNode QueryParser::Parse(std::string_view query) {
+    QueryParser parser;
+    parser._tokens = _tokenize(query);
+
+    QueryNode root{QueryNode::Kind::And, {}, {}};
+    while (parser._pos < parser._tokens.size()) {
+        QueryNode node;
+        if (parser._parse_or(node)) {
+            add_child(root, std::move(node));
+        } else {
+            ++parser._pos; // лишняя закрывающая скобка
+        }
+    }
+    return collapse(std::move(root));
+}
+
+bool QueryParser::_parse_or(QueryNode& node) {
+    QueryNode result{QueryNode::Kind::Or, {}, {}};
+    QueryNode operand;
+    if (_parse_and(operand)) {
+        add_child(result, std::move(operand));
+    }
+    while (_pos < _tokens.size() && _tokens[_pos] == "OR") {
+        ++_pos;
+        if (_parse_and(operand)) {
+            add_child(result, std::move(operand));
+        }
+    }
+    if (result.children.empty()) {
+        return false;
+    }
+    node = collapse(std::move(result));
+    return true;
+}
+
+bool QueryParser::_parse_and(QueryNode& node) {
+    QueryNode result{QueryNode::Kind::And, {}, {}};
+    while (_pos < _tokens.size() && _tokens[_pos] != "OR" && _tokens[_pos] != ")") {
+        if (_tokens[_pos] == "AND") {
+            ++_pos;
+            continue;
+        }
+        QueryNode operand;
+        if (_parse_unary(operand)) {
+            add_child(result, std::move(operand));
+        }
+    }
+    if (result.children.empty()) {
+        return false;
+    }
+    node = collapse(std::move(result));
+    return true;
+}
+
+bool QueryParser::_parse_unary(QueryNode& node) {
+    if (_pos >= _tokens.size() || _tokens[_pos] == ")" || _tokens[_pos] == "OR" || _tokens[_pos] == "AND") {
+        return false;
+    }
+
+    // Каждая скобка и NOT - уровень рекурсии разбора (и потом обхода дерева): глубина ограничена
+    if (++_depth > MAX_DEPTH) {
+        throw std::invalid_argument("Query is nested deeper than " + std::to_string(MAX_DEPTH) + " levels");
+    }
+    struct DepthGuard {
+        size_t& depth;
+        ~DepthGuard() { --depth; }
+    } guard{_depth};
+
+    const std::string& token = _tokens[_pos++];
+    if (token == "NOT") {
+        QueryNode operand;
+        if (!_parse_unary(operand)) {
+            return false;
+        }
+        // NOT NOT x - это x
+        if (operand.kind == QueryNode::Kind::Not) {
+            node = std::move(operand.children.front());
+        } else {
+            node = QueryNode{QueryNode::Kind::Not, {}, {}};
+            node.children.push_back(std::move(operand));
+        }
+        return true;
+    }
+    if (token == "(") {
+        const bool found = _parse_or(node);
+        if (_pos < _tokens.size() && _tokens[_pos] == ")") {
+            ++_pos;
+        }
+        return found;
+    }
+    node = QueryNode{QueryNode::Kind::Term, token, {}};
+    return true;
+}
+
+std::string QueryParser::ToString(const QueryNode& node) {
+    switch (node.kind) {
+        case QueryNode::Kind::Term:
+            return node.term;
+        case QueryNode::Kind::Not: {
+            const QueryNode& child = node.children.front();
+            return child.kind == QueryNode::Kind::Term ? "NOT " + child.term : "NOT (" + ToString(child) + ")";
+        }
+        case QueryNode::Kind::And:
+        case QueryNode::Kind::Or: {
+            const char* separator = node.kind == QueryNode::Kind::And ? " AND " : " OR ";
+            std::string text;
+            for (const QueryNode& child : node.children) {
+                const bool group = child.kind == QueryNode::Kind::And || child.kind == QueryNode::Kind::Or;
+                text += (text.empty() ? "" : separator) + (group ? "(" + ToString(child) + ")" : ToString(child));
+            }
+            return text;
+        }
+    }
+    return {};
+}
@@ -0,0 +1,55 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_QUERYPARSER_H
+#define SEARCH_ENGINE_QUERYPARSER_H
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Узел дерева булева запроса
+struct QueryNode {
+    enum class Kind { Term, And, Or, Not };
+
+    Kind kind = Kind::Term;
+    std::string term;               // для Term
+    std::vector<QueryNode> children; // для And/Or; у Not - ровно один
+};
+
+/* Разбор запроса с операторами AND, OR, NOT и скобками.
+ * Приоритет: NOT, затем AND, затем OR; слова подряд без оператора соединяются через AND.
+ * Операторы пишутся заглавными буквами - слова индекса в нижнем регистре, так что путаницы нет.
+ * Лишние скобки и операторы без операнда пропускаются. Исключение (std::invalid_argument) - только
+ * при вложенности скобок и NOT глубже MAX_DEPTH.
+ */
+class QueryParser {
+public:
+    // Есть ли в запросе операторы или скобки; иначе это обычный список слов через AND
+    static bool IsBoolean(std::string_view query);
+
+    // Пустой запрос - And без детей
+    static QueryNode Parse(std::string_view query);
+
+    // Запись дерева с явными операторами и скобками - для explain
+    static std::string ToString(const QueryNode& node);
+
+    static constexpr size_t MAX_DEPTH = 256;
+
+private:
+    static std::vector<std::string> _tokenize(std::string_view query);
+
+    std::vector<std::string> _tokens;
+    size_t _pos = 0;
+    size_t _depth = 0;
+
+    // Каждая функция возвращает false, если операнда нет (конец запроса или закрывающая скобка)
+    bool _parse_or(QueryNode& node);
+    bool _parse_and(QueryNode& node);
+    bool _parse_unary(QueryNode& node);
+};
+
+#endif //SEARCH_ENGINE_QUERYPARSER_H
@@ -0,0 +1,137 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "QueryPlanner.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+const char* IntersectMethodName(IntersectMethod method) {
+    switch (method) {
+        case IntersectMethod::Scan: return "scan";
+        case IntersectMethod::LinearMerge: return "merge";
+        case IntersectMethod::Galloping: return "gallop";
+        case IntersectMethod::BitmapProbe: return "bitmap probe";
+        case IntersectMethod::BitmapAnd: return "bitmap AND";
+    }
+    return "?";
+}
+
+QueryPlan QueryPlanner::Plan(const std::vector<TermStats>& terms, size_t segment_docs) {
+    QueryPlan plan;
+    Plan(terms, segment_docs, plan);
+    return plan;
+}
+
+void QueryPlanner::Plan(const std::vector<TermStats>& terms, size_t segment_docs, QueryPlan& plan) {
+    plan.steps.clear();
+    plan.short_circuit = false;
+    plan.empty_term = 0;
+    plan.ranges = 1;
+
+    // Слова без вхождений проверяются раньше всего: пересечение с пустым списком пусто
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (terms[i].df == 0) {
+            plan.short_circuit = true;
+            plan.empty_term = i;
+            return;
+        }
+    }
+    if (terms.empty()) {
+        return;
+    }
+
+    // Самые редкие - первыми: кандидатов меньше с первого шага.
+    // Слов в запросе немного - сортировка вставками, устойчивая и без временного буфера
+    std::vector<PlanStep>& steps = plan.steps;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        PlanStep step{i, terms[i].df};
+        size_t k = steps.size();
+        steps.push_back(step);
+        for (; k > 0 && steps[k - 1].df > step.df; --k) {
+            steps[k] = steps[k - 1];
+        }
+        steps[k] = step;
+    }
+
+    const auto docs = (double)std::max<size_t>(segment_docs, 1);
+    const double and_cost = docs * BITMAP_WORD_COST;
+
+    // Лучший способ пересечь c кандидатов (вектором) со списком из n документов
+    auto vector_step = [](double c, const TermStats& term, IntersectMethod& method) {
+        const auto n = (double)term.df;
+        double best = c + n;
+        method = IntersectMethod::LinearMerge;
+        const double gallop = c * (1 + std::log2(1 + n / std::max(c, 1.0)));
+        if (gallop < best) {
+            best = gallop;
+            method = IntersectMethod::Galloping;
+        }
+        if (term.has_bitmap && c * PROBE_COST < best) {
+            best = c * PROBE_COST;
+            method = IntersectMethod::BitmapProbe;
+        }
+        return best;
+    };
+
+    const TermStats& first = terms[steps[0].term];
+    double candidates = (double)first.df;
+
+    // Начинать ли с битовой карты: выгодно, если следующее слово тоже плотное и AND дешевле обхода
+    bool bitmap_form = false;
+    if (steps.size() > 1 && first.has_bitmap && terms[steps[1].term].has_bitmap) {
+        IntersectMethod unused;
+        bitmap_form = and_cost < candidates + vector_step(candidates, terms[steps[1].term], unused);
+    }
+    steps[0].method = bitmap_form ? IntersectMethod::BitmapAnd : IntersectMethod::Scan;
+    steps[0].estimated_cost = bitmap_form ? 0 : candidates;
+    steps[0].estimated_output = candidates;
+
+    for (size_t k = 1; k < steps.size(); ++k) {
+        PlanStep& step = steps[k];
+        const TermStats& term = terms[step.term];
+
+        // Переход от битовой карты к вектору стоит одного Rank на каждое уже пройденное слово
+        const double materialize = candidates * (double)k;
+        IntersectMethod method;
+        const double vector_cost = vector_step(candidates, term, method);
+        if (bitmap_form && term.has_bitmap && and_cost < materialize + vector_cost) {
+            step.method = IntersectMethod::BitmapAnd;
+            step.estimated_cost = and_cost;
+        } else {
+            step.method = method;
+            step.estimated_cost = vector_cost + (bitmap_form ? materialize : 0);
+            bitmap_form = false;
+        }
+
+        // Оценка при независимости слов
+        candidates = candidates * (double)term.df / docs;
+        step.estimated_output = candidates;
+    }
+}
+
+std::string QueryPlan::Explain(const std::vector<std::string>& terms) const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(0);
+    if (short_circuit) {
+        out << "  short-circuit: \"" << terms[empty_term] << "\" has no postings, nothing read\n";
+        return out.str();
+    }
+    for (size_t k = 0; k < steps.size(); ++k) {
+        const PlanStep& step = steps[k];
+        if (k == 0 && ranges > 1) {
+            out << "  parallel: " << ranges << " doc ranges\n";
+        }
+        out << "  " << k + 1 << ". " << std::left << std::setw(16) << terms[step.term]
+            << " df=" << std::setw(9) << step.df
+            << std::setw(13) << IntersectMethodName(step.method)
+            << " cost est " << std::setw(9) << step.estimated_cost
+            << " actual " << std::setw(9) << step.actual_cost
+            << " | docs est " << std::setw(9) << step.estimated_output
+            << " actual " << std::setw(9) << step.actual_output
+            << std::setprecision(1) << " | " << step.elapsed_us << " us" << std::setprecision(0) << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,70 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_QUERYPLANNER_H
+#define SEARCH_ENGINE_QUERYPLANNER_H
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Способ пересечения текущих кандидатов со списком вхождений следующего слова
+enum class IntersectMethod {
+    Scan,        // первое слово: кандидаты - все его документы
+    LinearMerge, // одновременный проход по обоим отсортированным спискам
+    Galloping,   // экспоненциальный поиск каждого кандидата в длинном списке
+    BitmapProbe, // проверка каждого кандидата по битовой карте плотного слова
+    BitmapAnd    // AND битовых карт, пока все слова плотные
+};
+
+const char* IntersectMethodName(IntersectMethod method);
+
+// Что планировщик знает о слове до чтения его вхождений
+struct TermStats {
+    size_t df = 0;           // число документов со словом
+    bool has_bitmap = false; // плотное слово с битовой картой
+};
+
+struct PlanStep {
+    size_t term = 0; // номер слова в запросе
+    size_t df = 0;
+    IntersectMethod method = IntersectMethod::Scan;
+    double estimated_cost = 0;
+    double estimated_output = 0;
+    // Заполняются при выполнении
+    double actual_cost = 0;
+    size_t actual_output = 0;
+    double elapsed_us = 0;
+};
+
+/* План конъюнктивного запроса по одному сегменту: слова по возрастанию df, способ пересечения для каждого.
+ * Стоимость - число элементарных операций (шагов по спискам, сравнений, проверок битовой карты).
+ */
+struct QueryPlan {
+    std::vector<PlanStep> steps;
+    bool short_circuit = false; // какого-то слова нет - вхождения не читаются вовсе
+    size_t empty_term = 0;      // это слово при short_circuit
+    size_t ranges = 1;          // диапазонов doc_id, выполненных параллельно; фактические значения - их суммы
+
+    // Текст плана с оценкой и фактической стоимостью каждого шага; terms - слова запроса
+    std::string Explain(const std::vector<std::string>& terms) const;
+};
+
+class QueryPlanner {
+public:
+    // Стоимость проверки одного кандидата по битовой карте (Contains + Rank)
+    static constexpr double PROBE_COST = 3;
+
+    // Стоимость AND битовых карт - по одной операции на 64-битное слово
+    static constexpr double BITMAP_WORD_COST = 1.0 / 64;
+
+    static QueryPlan Plan(const std::vector<TermStats>& terms, size_t segment_docs);
+
+    // То же в существующий план: память шагов используется повторно
+    static void Plan(const std::vector<TermStats>& terms, size_t segment_docs, QueryPlan& plan);
+};
+
+#endif //SEARCH_ENGINE_QUERYPLANNER_H
@@ -0,0 +1,197 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "RoaringBitmap.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr size_t BITMAP_WORDS = 65536 / 64;
+
+} // namespace
+
+RoaringBitmap RoaringBitmap::FromSorted(std::span<const uint32_t> values) {
+    RoaringBitmap bitmap;
+    size_t begin = 0;
+    while (begin < values.size()) {
+        const auto key = (uint16_t)(values[begin] >> 16);
+        size_t end = begin;
+        while (end < values.size() && (uint16_t)(values[end] >> 16) == key) {
+            ++end;
+        }
+
+        Container container;
+        container.key = key;
+        container.array.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            container.array.push_back((uint16_t)values[i]);
+        }
+        bitmap._push(std::move(container));
+        begin = end;
+    }
+    return bitmap;
+}
+
+bool RoaringBitmap::_finish(Container& container) {
+    container.cardinality = container.array.size();
+    for (uint64_t word : container.bits) {
+        container.cardinality += (size_t)std::popcount(word);
+    }
+    if (container.cardinality == 0) {
+        return false;
+    }
+
+    // Представление по числу элементов: массив до ARRAY_LIMIT, дальше битовая карта.
+    // Буферы очищаются без освобождения - повторно используемый результат And не выделяет память
+    if (container.bits.empty() && container.cardinality > ARRAY_LIMIT) {
+        container.bits.assign(BITMAP_WORDS, 0);
+        for (uint16_t low : container.array) {
+            container.bits[low / 64] |= uint64_t(1) << (low % 64);
+        }
+        container.array.clear();
+    } else if (!container.bits.empty() && container.cardinality <= ARRAY_LIMIT) {
+        container.array.clear();
+        container.array.reserve(container.cardinality);
+        for (size_t word = 0; word < container.bits.size(); ++word) {
+            for (uint64_t bits = container.bits[word]; bits != 0; bits &= bits - 1) {
+                container.array.push_back((uint16_t)(word * 64 + (size_t)std::countr_zero(bits)));
+            }
+        }
+        container.bits.clear();
+    }
+
+    if (container.bits.empty()) {
+        container.word_rank.clear();
+    } else {
+        container.word_rank.resize(BITMAP_WORDS);
+        uint16_t count = 0;
+        for (size_t word = 0; word < BITMAP_WORDS; ++word) {
+            container.word_rank[word] = count;
+            count = (uint16_t)(count + std::popcount(container.bits[word]));
+        }
+    }
+
+    container.rank_base = _cardinality;
+    _cardinality += container.cardinality;
+    return true;
+}
+
+void RoaringBitmap::_push(Container container) {
+    if (!_finish(container)) {
+        return;
+    }
+    // Постоянные карты индекса не держат пустых буферов другого представления
+    if (container.bits.empty()) {
+        container.bits.shrink_to_fit();
+        container.word_rank.shrink_to_fit();
+    } else {
+        container.array.shrink_to_fit();
+    }
+    _containers.push_back(std::move(container));
+}
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (!bits.empty()) {
+        return (bits[low / 64] >> (low % 64)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+size_t RoaringBitmap::Container::rank(uint16_t low) const {
+    if (!bits.empty()) {
+        const uint64_t below = bits[low / 64] & ((uint64_t(1) << (low % 64)) - 1);
+        return word_rank[low / 64] + (size_t)std::popcount(below);
+    }
+    return (size_t)(std::lower_bound(array.begin(), array.end(), low) - array.begin());
+}
+
+std::vector<RoaringBitmap::Container>::const_iterator RoaringBitmap::_lower_bound(uint16_t key) const {
+    return std::lower_bound(_containers.begin(), _containers.end(), key,
+                            [](const Container& container, uint16_t k) { return container.key < k; });
+}
+
+const RoaringBitmap::Container* RoaringBitmap::_find(uint16_t key) const {
+    auto it = _lower_bound(key);
+    return it != _containers.end() && it->key == key ? &*it : nullptr;
+}
+
+bool RoaringBitmap::Contains(uint32_t value) const {
+    const Container* container = _find((uint16_t)(value >> 16));
+    return container != nullptr && container->contains((uint16_t)value);
+}
+
+size_t RoaringBitmap::Rank(uint32_t value) const {
+    const auto key = (uint16_t)(value >> 16);
+    auto it = _lower_bound(key);
+    if (it == _containers.end()) {
+        return _cardinality;
+    }
+    return it->key == key ? it->rank_base + it->rank((uint16_t)value) : it->rank_base;
+}
+
+size_t RoaringBitmap::memory_usage() const {
+    size_t bytes = _containers.capacity() * sizeof(Container);
+    for (const Container& container : _containers) {
+        bytes += container.array.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t)
+                 + container.word_rank.capacity() * sizeof(uint16_t);
+    }
+    return bytes;
+}
+
+RoaringBitmap RoaringBitmap::And(const RoaringBitmap& a, const RoaringBitmap& b) {
+    RoaringBitmap result;
+    And(a, b, result);
+    return result;
+}
+
+void RoaringBitmap::And(const RoaringBitmap& a, const RoaringBitmap& b, RoaringBitmap& result,
+                        uint32_t first, uint32_t last) {
+    // Контейнеры результата используются повторно: при той же форме пересечения память не выделяется
+    size_t used = 0;
+    result._cardinality = 0;
+    const auto last_key = (uint16_t)(last >> 16);
+    auto left = a._lower_bound((uint16_t)(first >> 16));
+    auto right = b._lower_bound((uint16_t)(first >> 16));
+    while (left != a._containers.end() && right != b._containers.end() && left->key <= last_key
+           && right->key <= last_key) {
+        if (left->key != right->key) {
+            (left->key < right->key ? ++left : ++right);
+            continue;
+        }
+
+        if (used == result._containers.size()) {
+            result._containers.emplace_back();
+        }
+        Container& container = result._containers[used];
+        container.key = left->key;
+        container.array.clear();
+        container.bits.clear();
+        if (!left->bits.empty() && !right->bits.empty()) {
+            // Две битовые карты - пословное AND
+            container.bits.resize(BITMAP_WORDS);
+            for (size_t word = 0; word < BITMAP_WORDS; ++word) {
+                container.bits[word] = left->bits[word] & right->bits[word];
+            }
+        } else if (!left->bits.empty() || !right->bits.empty()) {
+            // Массив фильтруется по битовой карте
+            const Container& sparse = left->bits.empty() ? *left : *right;
+            const Container& dense = left->bits.empty() ? *right : *left;
+            for (uint16_t low : sparse.array) {
+                if (dense.contains(low)) {
+                    container.array.push_back(low);
+                }
+            }
+        } else {
+            std::set_intersection(left->array.begin(), left->array.end(), right->array.begin(), right->array.end(),
+                                  std::back_inserter(container.array));
+        }
+        if (result._finish(container)) {
+            ++used;
+        }
+        ++left;
+        ++right;
+    }
+    result._containers.resize(used);
+}
@@ -0,0 +1,128 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_ROARINGBITMAP_H
+#define SEARCH_ENGINE_ROARINGBITMAP_H
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/* Сжатое множество 32-битных номеров в духе Roaring.
+ * Номера делятся на контейнеры по старшим 16 битам. Разреженный контейнер (до ARRAY_LIMIT номеров) -
+ * отсортированный массив младших половин, плотный - битовая карта на 65536 бит.
+ * Rank(x) - число элементов меньше x - позволяет хранить частоты рядом, в порядке возрастания номеров.
+ */
+class RoaringBitmap {
+public:
+    static constexpr size_t ARRAY_LIMIT = 4096;
+
+    // values должны идти строго по возрастанию
+    static RoaringBitmap FromSorted(std::span<const uint32_t> values);
+
+    bool Contains(uint32_t value) const;
+
+    // Число элементов меньше value; для элемента множества - его позиция
+    size_t Rank(uint32_t value) const;
+
+    size_t Cardinality() const { return _cardinality; }
+
+    // Число непустых контейнеров (по 65536 возможных номеров в каждом)
+    size_t ContainerCount() const { return _containers.size(); }
+
+    size_t memory_usage() const;
+
+    static RoaringBitmap And(const RoaringBitmap& a, const RoaringBitmap& b);
+
+    /* То же в существующую карту с переиспользованием её памяти; result не должен совпадать с a или b.
+    * Пересекаются только контейнеры, задевающие [first, last]: в крайних могут остаться элементы вне диапазона.
+    */
+    static void And(const RoaringBitmap& a, const RoaringBitmap& b, RoaringBitmap& result,
+                    uint32_t first = 0, uint32_t last = UINT32_MAX);
+
+    // Вызывает func(value) для всех элементов по возрастанию
+    template <typename Func>
+    void ForEach(Func func) const {
+        for (const Container& container : _containers) {
+            const uint32_t high = (uint32_t)container.key << 16;
+            if (container.bits.empty()) {
+                for (uint16_t low : container.array) {
+                    func(high | low);
+                }
+                continue;
+            }
+            for (size_t word = 0; word < container.bits.size(); ++word) {
+                for (uint64_t bits = container.bits[word]; bits != 0; bits &= bits - 1) {
+                    func(high | (uint32_t)(word * 64 + (size_t)std::countr_zero(bits)));
+                }
+            }
+        }
+    }
+
+    // То же для элементов из [first, last]; контейнеры до first пропускаются двоичным поиском
+    template <typename Func>
+    void ForEach(uint32_t first, uint32_t last, Func func) const {
+        for (auto it = _lower_bound((uint16_t)(first >> 16)); it != _containers.end() && it->key <= (last >> 16); ++it) {
+            const uint32_t high = (uint32_t)it->key << 16;
+            const uint32_t low_first = it->key == (first >> 16) ? first & 0xFFFF : 0;
+            const uint32_t low_last = it->key == (last >> 16) ? last & 0xFFFF : 0xFFFF;
+            if (it->bits.empty()) {
+                for (auto low = std::lower_bound(it->array.begin(), it->array.end(), (uint16_t)low_first);
+                     low != it->array.end() && *low <= low_last; ++low) {
+                    func(high | *low);
+                }
+                continue;
+            }
+            for (size_t word = low_first / 64; word <= low_last / 64; ++word) {
+                uint64_t bits = it->bits[word];
+                if (word == low_first / 64) {
+                    bits &= ~uint64_t(0) << (low_first % 64);
+                }
+                if (word == low_last / 64) {
+                    bits &= ~uint64_t(0) >> (63 - low_last % 64);
+                }
+                for (; bits != 0; bits &= bits - 1) {
+                    func(high | (uint32_t)(word * 64 + (size_t)std::countr_zero(bits)));
+                }
+            }
+        }
+    }
+
+private:
+    struct Container {
+        uint16_t key = 0;
+        size_t rank_base = 0;         // элементов в предыдущих контейнерах
+        size_t cardinality = 0;
+        std::vector<uint16_t> array;  // разреженный контейнер
+        std::vector<uint64_t> bits;   // плотный контейнер (1024 слова)
+        std::vector<uint16_t> word_rank; // элементов в словах до данного - для Rank плотного контейнера
+
+        bool contains(uint16_t low) const;
+        size_t rank(uint16_t low) const;
+    };
+
+    // Первый контейнер с ключом не меньше key
+    std::vector<Container>::const_iterator _lower_bound(uint16_t key) const;
+
+    // Контейнер с ключом key или nullptr
+    const Container* _find(uint16_t key) const;
+
+    /* Доводит заполненный контейнер (array или bits): выбирает представление по числу элементов,
+    * считает вспомогательные ранги и rank_base. false - контейнер пуст.
+    */
+    bool _finish(Container& container);
+
+    // Добавляет заполненный контейнер в конец; пустые контейнеры отбрасываются
+    void _push(Container container);
+
+    std::vector<Container> _containers;
+    size_t _cardinality = 0;
+};
+
+#endif //SEARCH_ENGINE_ROARINGBITMAP_H
@@ -0,0 +1,314 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_SCORING_H
+#define SEARCH_ENGINE_SCORING_H
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "IndexSegment.h"
+
+/* Составные части подсчёта релевантности - параметры шаблонов SearchServer, а не виртуальные вызовы:
+ * для каждой конфигурации (формула, тип суммы, формат вхождений) внутренний цикл собирается отдельно
+ * и встраивается целиком. Конфигурация выбирается один раз - SearchServer::SetRanking.
+ */
+
+// Статистика слова запроса по всему снимку индекса
+struct TermStatistics {
+    size_t df = 0;        // документов со словом
+    size_t doc_count = 0; // документов в индексе
+};
+
+/* Формула релевантности: вклад вхождения слова с частотой frequency в документе.
+ * weight(stats) считается один раз на слово запроса, score - на каждое вхождение.
+ * uses_document_frequency = false - статистика не нужна и не собирается.
+ */
+template <typename S>
+concept Scorer = requires(size_t frequency, const TermStatistics& stats) {
+    { S::uses_document_frequency } -> std::convertible_to<bool>;
+    { S::weight(stats) } -> std::convertible_to<double>;
+    { S::template score<double>(frequency, 1.0) } -> std::convertible_to<double>;
+};
+
+// Сумма частот слов запроса в документе - исходная релевантность
+struct CountScorer {
+    static constexpr bool uses_document_frequency = false;
+
+    static double weight(const TermStatistics&) { return 1; }
+
+    template <typename Accumulator>
+    static Accumulator score(size_t frequency, double) { return (Accumulator)frequency; }
+};
+
+// TF-IDF: частота, умноженная на сглаженную обратную документную частоту
+struct TfIdfScorer {
+    static constexpr bool uses_document_frequency = true;
+
+    static double weight(const TermStatistics& stats) {
+        return std::log((double)(stats.doc_count + 1) / (double)(stats.df + 1)) + 1;
+    }
+
+    template <typename Accumulator>
+    static Accumulator score(size_t frequency, double weight) { return (Accumulator)((double)frequency * weight); }
+};
+
+/* BM25 с насыщением частоты (k1). Длины документов в сегментах не хранятся, поэтому нормировка
+ * по длине отключена (b = 0).
+ */
+struct Bm25Scorer {
+    static constexpr bool uses_document_frequency = true;
+    static constexpr double K1 = 1.2;
+
+    static double weight(const TermStatistics& stats) {
+        const double df = (double)stats.df;
+        return std::log(1 + ((double)stats.doc_count - df + 0.5) / (df + 0.5));
+    }
+
+    template <typename Accumulator>
+    static Accumulator score(size_t frequency, double weight) {
+        const double tf = (double)frequency;
+        return (Accumulator)(weight * tf * (K1 + 1) / (tf + K1));
+    }
+};
+
+/* Квантованный при индексации вклад вхождения (impact): насыщение частоты BM25 tf * (k1 + 1) / (tf + k1),
+ * отображённое в [1, 2^bits - 1]. От статистики слова импакт не зависит, поэтому он одинаков в любом
+ * сегменте и шарде и не меняется при добавлении документов и слиянии сегментов.
+ */
+inline uint32_t QuantizeImpact(size_t frequency, size_t bits) {
+    const double max_level = (double)((uint32_t(1) << bits) - 1);
+    const double saturation = Bm25Scorer::score<double>(frequency, 1.0) / (Bm25Scorer::K1 + 1);
+    return (uint32_t)std::clamp(std::round(saturation * max_level), 1.0, max_level);
+}
+
+/* Подсчёт импактами: idf BM25 считается при запросе по всему индексу (все сегменты и шарды) и округляется
+ * до целого с шагом 1/IDF_SCALE, вклад вхождения - импакт, умноженный на этот вес, - остаётся целым.
+ */
+struct ImpactScorer {
+    static constexpr bool uses_document_frequency = true;
+    static constexpr double IDF_SCALE = 64;
+
+    static double weight(const TermStatistics& stats) {
+        return std::max(1.0, std::round(Bm25Scorer::weight(stats) * IDF_SCALE));
+    }
+
+    template <typename Accumulator>
+    static Accumulator score(size_t impact, double weight) { return (Accumulator)impact * (Accumulator)weight; }
+};
+
+// Тип суммы вкладов: целый для частот и импактов, с плавающей точкой для весовых формул
+template <typename A>
+concept Accumulator = std::is_arithmetic_v<A>;
+
+/* Вхождения слова в сегменте. Если индекс квантован, рядом лежат импакты тех же вхождений
+ * (в 8 или 16 бит); у объединённых списков шаблонов импактов нет.
+ */
+struct PostingList {
+    std::span<const Entry> entries;
+    std::span<const uint8_t> impacts8;
+    std::span<const uint16_t> impacts16;
+};
+
+// Чтение вхождения position из списка сегмента
+template <typename C>
+concept PostingCodec = requires(const PostingList& list, size_t position) {
+    { C::doc_id(list, position) } -> std::convertible_to<size_t>;
+    { C::frequency(list, position) } -> std::convertible_to<size_t>;
+};
+
+// Вхождения сегмента как есть (Entry: doc_id и частота)
+struct EntryCodec {
+    static size_t doc_id(const PostingList& list, size_t position) { return list.entries[position].doc_id; }
+
+    static size_t frequency(const PostingList& list, size_t position) { return list.entries[position].count; }
+};
+
+/* Вместо частоты - импакт вхождения (uint8_t или uint16_t), подсчёт сводится к сложению целых.
+ * Списки без импактов (шаблоны, нечёткие слова) квантуются на лету так же, как при индексации:
+ * иначе частоты смешались бы с импактами в одной сумме.
+ */
+template <typename Impact>
+struct ImpactCodec {
+    static size_t doc_id(const PostingList& list, size_t position) { return list.entries[position].doc_id; }
+
+    static size_t frequency(const PostingList& list, size_t position) {
+        const std::span<const Impact> impacts = [&] {
+            if constexpr (sizeof(Impact) == 1) {
+                return list.impacts8;
+            } else {
+                return list.impacts16;
+            }
+        }();
+        if (!impacts.empty()) {
+            return impacts[position];
+        }
+        return QuantizeImpact(list.entries[position].count, sizeof(Impact) * 8);
+    }
+};
+
+/* Релевантность найденных документов: номера и суммы лежат в отдельных непрерывных массивах,
+ * поэтому поиск максимума и нормировка идут по плотному массиву сумм и векторизуются.
+ */
+template <Accumulator A>
+struct ScoreBuffer {
+    std::vector<size_t> doc_ids;
+    std::vector<A> scores;
+
+    size_t size() const { return doc_ids.size(); }
+
+    bool empty() const { return doc_ids.empty(); }
+
+    void clear() {
+        doc_ids.clear();
+        scores.clear();
+    }
+
+    void reserve(size_t count) {
+        doc_ids.reserve(count);
+        scores.reserve(count);
+    }
+
+    void resize(size_t count) {
+        doc_ids.resize(count);
+        scores.resize(count);
+    }
+
+    void push_back(size_t doc_id, A score) {
+        doc_ids.push_back(doc_id);
+        scores.push_back(score);
+    }
+
+    // Дописывает все элементы other
+    void append(const ScoreBuffer& other) {
+        doc_ids.insert(doc_ids.end(), other.doc_ids.begin(), other.doc_ids.end());
+        scores.insert(scores.end(), other.scores.begin(), other.scores.end());
+    }
+
+    // Удаляет документы, для которых remove(doc_id) истинно, сохраняя порядок остальных
+    template <typename Predicate>
+    void erase_if(Predicate remove) {
+        size_t kept = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            if (!remove(doc_ids[i])) {
+                doc_ids[kept] = doc_ids[i];
+                scores[kept] = scores[i];
+                ++kept;
+            }
+        }
+        resize(kept);
+    }
+
+    /* Оставляет limit документов с наибольшей суммой (при равных суммах - с меньшими номерами),
+    * сохраняя их порядок. Документы должны идти по возрастанию doc_id; work - рабочий буфер.
+    */
+    void keep_top(size_t limit, std::vector<A>& work) {
+        if (size() <= limit) {
+            return;
+        }
+        if (limit == 0) {
+            clear();
+            return;
+        }
+        // Порог - limit-я по величине сумма; равных порогу берём столько, сколько осталось мест
+        work.assign(scores.begin(), scores.end());
+        std::nth_element(work.begin(), work.begin() + (ptrdiff_t)(limit - 1), work.end(), std::greater<A>());
+        const A threshold = work[limit - 1];
+        size_t ties = limit - (size_t)std::count_if(work.begin(), work.begin() + (ptrdiff_t)limit,
+                                                    [&](A score) { return score > threshold; });
+        size_t kept = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            if (scores[i] > threshold || (scores[i] == threshold && ties != 0)) {
+                ties -= scores[i] == threshold ? 1 : 0;
+                doc_ids[kept] = doc_ids[i];
+                scores[kept] = scores[i];
+                ++kept;
+            }
+        }
+        resize(kept);
+    }
+};
+
+/* Наибольшая из неотрицательных сумм. Восемь независимых дорожек обновляются поэлементно -
+ * компилятор превращает их в векторные max без -ffast-math.
+ */
+template <Accumulator A>
+A MaxScore(std::span<const A> scores) {
+    constexpr size_t LANES = 8;
+    A lanes[LANES] = {};
+    size_t i = 0;
+    for (; i + LANES <= scores.size(); i += LANES) {
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            lanes[lane] = std::max(lanes[lane], scores[i + lane]);
+        }
+    }
+    A result = 0;
+    for (A lane : lanes) {
+        result = std::max(result, lane);
+    }
+    for (; i < scores.size(); ++i) {
+        result = std::max(result, scores[i]);
+    }
+    return result;
+}
+
+// ranks[i] = scores[i] / max; max > 0, ranks не короче scores
+template <Accumulator A>
+void NormalizeScores(std::span<const A> scores, A max, std::span<float> ranks) {
+    const float divisor = (float)max;
+    for (size_t i = 0; i < scores.size(); ++i) {
+        ranks[i] = (float)scores[i] / divisor;
+    }
+}
+
+template <Scorer S, Accumulator A, PostingCodec C = EntryCodec>
+struct ScoringConfig {
+    using scorer = S;
+    using accumulator = A;
+    using codec = C;
+};
+
+using CountScoring = ScoringConfig<CountScorer, size_t>;
+using TfIdfScoring = ScoringConfig<TfIdfScorer, float>;
+using Bm25Scoring = ScoringConfig<Bm25Scorer, float>;
+// Вклад 16-битного импакта с весом доходит до 2^26, поэтому их сумма - в 64 битах
+using Impact8Scoring = ScoringConfig<ImpactScorer, uint32_t, ImpactCodec<uint8_t>>;
+using Impact16Scoring = ScoringConfig<ImpactScorer, uint64_t, ImpactCodec<uint16_t>>;
+
+enum class Ranking {
+    Count,
+    TfIdf,
+    Bm25,
+    Impact // сумма квантованных при индексации частот BM25, умноженных на целый idf
+};
+
+// "count", "tfidf", "bm25" или "impact"; иначе std::invalid_argument
+inline Ranking ParseRanking(std::string_view name) {
+    if (name == "count") {
+        return Ranking::Count;
+    }
+    if (name == "tfidf") {
+        return Ranking::TfIdf;
+    }
+    if (name == "bm25") {
+        return Ranking::Bm25;
+    }
+    if (name == "impact") {
+        return Ranking::Impact;
+    }
+    throw std::invalid_argument("Unknown ranking: " + std::string(name));
+}
+
+#endif //SEARCH_ENGINE_SCORING_H
@@ -0,0 +1,38 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "ScratchArena.h"
+#include <memory>
+
+namespace {
+
+// Буфер выделяется при первой арене потока и живёт до завершения потока
+struct ThreadBuffer {
+    std::unique_ptr<std::byte[]> data;
+    bool in_use = false;
+};
+
+thread_local ThreadBuffer thread_buffer;
+
+} // namespace
+
+ScratchArena::ScratchArena() {
+    if (thread_buffer.in_use) {
+        _resource.emplace();
+        return;
+    }
+    if (!thread_buffer.data) {
+        thread_buffer.data = std::make_unique<std::byte[]>(BUFFER_BYTES);
+    }
+    thread_buffer.in_use = true;
+    _owns_buffer = true;
+    _resource.emplace(thread_buffer.data.get(), BUFFER_BYTES);
+}
+
+ScratchArena::~ScratchArena() {
+    _resource.reset();
+    if (_owns_buffer) {
+        thread_buffer.in_use = false;
+    }
+}
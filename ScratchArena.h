@@ -0,0 +1,36 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_SCRATCHARENA_H
+#define SEARCH_ENGINE_SCRATCHARENA_H
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+
+/* Монотонная арена для временных структур одной задачи (индексация документа, разбор запроса).
+ * Память берётся из буфера текущего потока без обращения к общему распределителю и освобождается
+ * разом при уничтожении арены. Когда буфер исчерпан, арена добирает блоки у распределителя по умолчанию.
+ * Вложенная арена в том же потоке буфер не получает и сразу работает через распределитель.
+ */
+class ScratchArena {
+public:
+    static constexpr size_t BUFFER_BYTES = 256 * 1024;
+
+    ScratchArena();
+    ~ScratchArena();
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &*_resource; }
+
+private:
+    bool _owns_buffer = false;
+    std::optional<std::pmr::monotonic_buffer_resource> _resource;
+};
+
+#endif //SEARCH_ENGINE_SCRATCHARENA_H
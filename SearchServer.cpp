@@ -3,170 +3,607 @@
 //
 
 #include "SearchServer.h"
-#include <sstream>
+#include <bit>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include "ParallelFor.h"
+#include "PostingIterator.h"
+#include "ScratchArena.h"
 #include <cmath>
 #include <limits>
-#include <set>
 
-std::vector<std::string> SearchServer::_split_text(const std::string& text) const {
-    std::vector<std::string> words;
-    std::stringstream ss(text);
-    std::string word;
-    while (ss >> word) {
-        words.push_back(word);
+std::pmr::vector<std::string_view> SearchServer::_split_text(std::string_view text,
+                                                             std::pmr::memory_resource* arena) const {
+    std::pmr::vector<std::string_view> words(arena);
+
+    // Те же разделители, что и у operator>> в классической локали
+    auto is_space = [](char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    };
+    size_t pos = 0;
+    while (pos < text.size()) {
+        while (pos < text.size() && is_space(text[pos])) {
+            ++pos;
+        }
+        const size_t start = pos;
+        while (pos < text.size() && !is_space(text[pos])) {
+            ++pos;
+        }
+        if (pos > start) {
+            words.push_back(text.substr(start, pos - start));
+        }
     }
     return words;
 }
 
+SearchServer::SearchServer(InvertedIndex& idx) : _index(&idx), _search_function(&SearchServer::_search_with<CountScoring>) {
+    _pool = std::make_unique<ThreadPool>(_fan_out() - 1);
+}
+
+SearchServer::SearchServer(ShardedIndex& idx)
+    : _sharded(&idx), _search_function(&SearchServer::_search_with<CountScoring>) {
+    _pool = std::make_unique<ThreadPool>(_fan_out() - 1);
+}
+
+void SearchServer::SetQueryThreads(size_t threads_count) {
+    _query_threads = threads_count;
+    if (_pool->GetWorkersCount() != _fan_out() - 1) {
+        _pool = std::make_unique<ThreadPool>(_fan_out() - 1);
+    }
+}
+
+void SearchServer::SetRanking(Ranking ranking) {
+    switch (ranking) {
+        case Ranking::Count:
+            _search_function = &SearchServer::_search_with<CountScoring>;
+            break;
+        case Ranking::TfIdf:
+            _search_function = &SearchServer::_search_with<TfIdfScoring>;
+            break;
+        case Ranking::Bm25:
+            _search_function = &SearchServer::_search_with<Bm25Scoring>;
+            break;
+        case Ranking::Impact:
+            // Разрядность импактов известна только индексу
+            if (_impact_bits() == 8) {
+                _search_function = &SearchServer::_search_with<Impact8Scoring>;
+            } else if (_impact_bits() == 16) {
+                _search_function = &SearchServer::_search_with<Impact16Scoring>;
+            } else {
+                throw std::logic_error("Impact ranking requires impact quantization of the index");
+            }
+            break;
+    }
+    _ranking = ranking;
+}
+
 std::vector<std::vector<RelativeIndex>> SearchServer::search(const std::vector<std::string>& queries_input) {
     std::vector<std::vector<RelativeIndex>> final_results;
+    final_results.reserve(queries_input.size());
 
     for (const std::string& query : queries_input) {
-        // 1 и 2. Разбиение и формирование уникального списка слов
-        std::vector<std::string> words = _split_text(query);
-        std::map<std::string, bool> unique_map;
-        for (const std::string& word : words) {
-            unique_map[word] = true;
-        }
+        final_results.push_back(search_one(query));
+    }
+    return final_results;
+}
 
-        std::vector<std::string> unique_words;
-        for (const auto& pair : unique_map) {
-            unique_words.push_back(pair.first);
-        }
+std::vector<RelativeIndex> SearchServer::search_one(const std::string& query) const {
+    return _search(query, nullptr);
+}
 
-        // 3. Сортировка по частоте (самые редкие - первые)
-        auto get_total_word_count = [this](const std::string& word) -> size_t {
-            size_t total_count = 0;
-            for (const auto& entry : this->_index.GetWordCount(word)) {
-                total_count += entry.count;
-            }
-            return total_count;
-        };
+std::string SearchServer::explain(const std::string& query) const {
+    std::string text;
+    _search(query, &text);
+    return text;
+}
+
+template <typename Config>
+std::vector<RelativeIndex> SearchServer::_search_with(const std::string& query, std::string* explain) const {
+    // Снимки фиксируют набор сегментов каждого шарда на всё время запроса
+    QueryScratch<typename Config::accumulator>& scratch = _scratch<typename Config::accumulator>();
+    _snapshots(scratch.snapshots);
+    const Snapshots& snapshots = scratch.snapshots;
 
-        std::sort(unique_words.begin(), unique_words.end(),
-            [&](const std::string& a, const std::string& b) {
-                return get_total_word_count(a) < get_total_word_count(b);
-            });
+    // Буфер потока живёт дольше запроса: снимки отпускаются на любом выходе, иначе они держали бы
+    // в памяти сегменты, уже заменённые слиянием. Ёмкость вектора остаётся для следующего запроса
+    struct ReleaseSnapshots {
+        Snapshots& snapshots;
+        ~ReleaseSnapshots() { snapshots.clear(); }
+    } release{scratch.snapshots};
+    if (scratch.shards.size() < snapshots.size()) {
+        scratch.shards.resize(snapshots.size());
+    }
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+        scratch.shards[i].relevance.clear();
+    }
 
-        // 4, 5 и 6. Расчет абсолютной релевантности и фильтрация
-        // Если по итогу не осталось ни одного документа, abs_relevance будет пустой.
-        std::map<size_t, size_t> abs_relevance = _calculate_absolute_relevance(unique_words);
+    // Запрос с операторами (AND, OR, NOT, скобки) выполняется деревом итераторов, обычный - по плану
+    if (QueryParser::IsBoolean(query)) {
+        _boolean_relevance<Config>(query, snapshots, explain, scratch);
+    } else {
+        _conjunctive_relevance<Config>(query, snapshots, explain, scratch);
+    }
 
-        if (abs_relevance.empty()) {
-            final_results.push_back({});
+    // Удалённые документы ещё могут оставаться в сегментах до их слияния.
+    // Ответы шардов сливаются под общими номерами; у одного индекса номера те же - буфер просто забирается
+    scratch.relevance.clear();
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+        ScoreBuffer<typename Config::accumulator>& found = scratch.shards[i].relevance;
+        found.erase_if([&](size_t doc_id) { return snapshots[i]->is_deleted(doc_id); });
+        if (_sharded == nullptr) {
+            std::swap(scratch.relevance, found);
+            continue;
         }
-        else {
-            // 7, 8. Расчет относительной релевантности и сортировка
-            std::vector<RelativeIndex> ranked_results = _get_ranked_results(abs_relevance);
-            final_results.push_back(std::move(ranked_results));
+        for (size_t k = 0; k < found.size(); ++k) {
+            scratch.relevance.push_back(_sharded->GlobalDocId(i, found.doc_ids[k]), found.scores[k]);
         }
     }
-    return final_results;
+
+    if (scratch.relevance.empty()) {
+        return {};
+    }
+
+    // 7, 8. Расчет относительной релевантности и сортировка
+    return _get_ranked_results(scratch.relevance, scratch.ranks);
 }
 
-std::map<size_t, size_t> SearchServer::_calculate_absolute_relevance(const std::vector<std::string>& unique_words) const {
-    std::map<size_t, size_t> final_doc_relevance;
+template <typename Accumulator>
+SearchServer::QueryScratch<Accumulator>& SearchServer::_scratch() {
+    thread_local QueryScratch<Accumulator> scratch;
+    return scratch;
+}
 
-    if (unique_words.empty()) {
-        return final_doc_relevance;
+bool SearchServer::_is_exact(std::string_view word) {
+    TermDictionary::FuzzyQuery fuzzy;
+    return !TermDictionary::IsPattern(word) && !TermDictionary::ParseFuzzy(word, fuzzy);
+}
+
+void SearchServer::_snapshots(Snapshots& snapshots) const {
+    if (_sharded != nullptr) {
+        _sharded->GetSnapshots(snapshots);
+    } else {
+        snapshots.resize(1);
+        snapshots[0] = _index->GetSnapshot();
     }
+}
 
-    // 1. Инициализация (Шаг 4): По первому, самому редкому слову находим все документы.
-    const std::string& rare_word = unique_words[0];
+bool SearchServer::_needs_fuzzy_fallback(std::string_view word, const Snapshots& snapshots) const {
+    // Опечатки: слово, которого нет ни в одном сегменте ни одного шарда, ищется нечётко
+    if (!_fuzzy_fallback || !_is_exact(word)) {
+        return false;
+    }
+    return std::none_of(snapshots.begin(), snapshots.end(), [&](const auto& snapshot) {
+        return std::any_of(snapshot->segments.begin(), snapshot->segments.end(),
+            [&](const auto& segment) { return !segment->postings(word).empty(); });
+    });
+}
 
-    std::set<size_t> common_doc_ids;
+template <typename Config>
+void SearchServer::_term_weights(const std::pmr::vector<std::pmr::string>& words, const Snapshots& snapshots,
+                                 QueryScratch<typename Config::accumulator>& scratch) const {
+    using Scorer = typename Config::scorer;
+    scratch.weights.assign(words.size(), 1);
+    if constexpr (Scorer::uses_document_frequency) {
+        // df по всем сегментам всех шардов, чтобы вес слова не зависел от того, как разложены документы
+        const size_t max_expansions = _max_expansions();
+        std::vector<Entry> storage;
+        for (size_t i = 0; i < words.size(); ++i) {
+            TermStatistics stats;
+            for (const auto& snapshot : snapshots) {
+                stats.doc_count += snapshot->doc_count;
+                for (const auto& segment : snapshot->segments) {
+                    stats.df += segment->expanded_postings(words[i], max_expansions, storage).size();
+                }
+            }
+            scratch.weights[i] = Scorer::weight(stats);
+        }
+    }
+}
+
+template <typename Func>
+void SearchServer::_for_each_shard(size_t shards_count, std::string* explain, Func shard_query) const {
+    if (explain == nullptr || shards_count == 1) {
+        _pool->ParallelFor(shards_count, explain == nullptr ? shards_count : 1, shard_query);
+        return;
+    }
+    for (size_t i = 0; i < shards_count; ++i) {
+        *explain += "shard " + std::to_string(i) + ":\n";
+        shard_query(i);
+    }
+}
 
-    std::vector<Entry> rare_word_entries = _index.GetWordCount(rare_word);
+template <typename Config>
+void SearchServer::_conjunctive_relevance(const std::string& query, const Snapshots& snapshots,
+                                          std::string* explain,
+                                          QueryScratch<typename Config::accumulator>& scratch) const {
+    // Слова и их список живут в арене потока и не обращаются к общему распределителю
+    ScratchArena arena;
 
-    // Если самое редкое слово не найдено, нет смысла продолжать (Требование 6)
-    if (rare_word_entries.empty()) {
-        return final_doc_relevance;
+    // 1 и 2. Разбиение и формирование уникального списка слов
+    // Слова приводятся к виду, в котором хранятся в индексе (основы при выделении основ)
+    std::pmr::vector<std::string_view> words = _split_text(query, arena.resource());
+    std::pmr::vector<std::pmr::string> unique_words(arena.resource());
+    unique_words.reserve(words.size());
+    for (std::string_view word : words) {
+        unique_words.emplace_back(_normalize_term(word));
     }
+    std::sort(unique_words.begin(), unique_words.end());
+    unique_words.erase(std::unique(unique_words.begin(), unique_words.end()), unique_words.end());
 
-    for (const Entry& entry : rare_word_entries) {
-        final_doc_relevance[entry.doc_id] = entry.count;
-        common_doc_ids.insert(entry.doc_id);
+    // Точные слова (не шаблоны и не нечёткие) - их вхождения читаются без раскрытия по словарю
+    std::pmr::vector<char> exact(unique_words.size(), false, arena.resource());
+    for (size_t i = 0; i < unique_words.size(); ++i) {
+        if (_needs_fuzzy_fallback(unique_words[i], snapshots)) {
+            unique_words[i] += '~';
+        }
+        exact[i] = _is_exact(unique_words[i]);
     }
+    _term_weights<Config>(unique_words, snapshots, scratch);
 
-    // 2. Итеративное сужение и расчет (Шаг 5): По каждому следующему слову.
-    for (size_t i = 1; i < unique_words.size(); ++i) {
-        const std::string& current_word = unique_words[i];
+    // Слова и веса общие, дальше каждый шард работает со своими сегментами и буферами
+    const size_t max_expansions = _max_expansions();
+    _for_each_shard(snapshots.size(), explain, [&](size_t shard_index) {
+        const IndexSnapshot& snapshot = *snapshots[shard_index];
+        ShardScratch<typename Config::accumulator>& shard = scratch.shards[shard_index];
 
-        std::set<size_t> current_word_doc_ids;
-        std::vector<Entry> current_entries = _index.GetWordCount(current_word);
+        // Диапазоны doc_id сегментов не пересекаются и идут по возрастанию,
+        // поэтому результаты сегментов просто дописываются друг за другом
+        if (shard.expanded.size() < unique_words.size()) {
+            shard.expanded.resize(unique_words.size());
+        }
+        std::vector<std::vector<Entry>>& expanded = shard.expanded;
+        std::vector<TermPostings>& terms = shard.terms;
+        std::vector<TermStats>& stats = shard.stats;
+        std::vector<char>& resolved = shard.resolved;
+        for (const auto& segment : snapshot.segments) {
+            // 3. Вхождения слов запроса; шаблоны (capit*) и нечёткие слова (capitol~) раскрываются по словарю сегмента.
+            // Сначала точные слова: если какого-то нет, раскрывать шаблоны уже незачем
+            terms.assign(unique_words.size(), {});
+            stats.assign(unique_words.size(), {});
+            resolved.assign(unique_words.size(), false);
+            bool missing = false;
+            for (int pass = 0; pass < 2 && !missing; ++pass) {
+                for (size_t i = 0; i < unique_words.size() && !missing; ++i) {
+                    if (exact[i] != (pass == 0)) {
+                        continue;
+                    }
+                    terms[i].entries = segment->expanded_postings(unique_words[i], max_expansions, expanded[i]);
+                    terms[i].impacts8 = segment->impacts8(terms[i].entries);
+                    terms[i].impacts16 = segment->impacts16(terms[i].entries);
+                    terms[i].bitmap = segment->bitmap(terms[i].entries);
+                    stats[i] = {terms[i].entries.size(), terms[i].bitmap != nullptr};
+                    resolved[i] = true;
+                    missing = terms[i].entries.empty();
+                }
+            }
+            if (missing) {
+                // Нераскрытые слова не должны выглядеть пустыми для планировщика
+                for (size_t i = 0; i < unique_words.size(); ++i) {
+                    if (!resolved[i]) {
+                        stats[i].df = segment->doc_count();
+                    }
+                }
+            }
 
-        // 2.1. Формируем doc_ids для текущего слова, а также обновляем релевантность
-        for (const Entry& entry : current_entries) {
-            current_word_doc_ids.insert(entry.doc_id);
+            // 4, 5 и 6. План (самые редкие слова - первыми), расчет абсолютной релевантности и фильтрация
+            // Если в сегменте не осталось ни одного документа, ничего не добавится.
+            QueryPlanner::Plan(stats, segment->doc_count(), shard.plan);
+            _execute_segment<Config>(*segment, snapshot, scratch.weights, shard);
 
-            if (common_doc_ids.count(entry.doc_id)) {
-                final_doc_relevance[entry.doc_id] += entry.count;
+            if (explain != nullptr) {
+                *explain += "segment [" + std::to_string(segment->base_doc_id()) + ", "
+                            + std::to_string(segment->end_doc_id()) + "):\n"
+                            + shard.plan.Explain(std::vector<std::string>(unique_words.begin(), unique_words.end()));
             }
         }
+    });
+}
 
-        // 2.2. Фильтрация: Находим пересечение (новые общие документы)
-        std::set<size_t> intersection_doc_ids;
-        for (size_t doc_id : common_doc_ids) {
-            if (current_word_doc_ids.count(doc_id)) {
-                intersection_doc_ids.insert(doc_id);
+template <typename Config>
+void SearchServer::_boolean_relevance(const std::string& query, const Snapshots& snapshots,
+                                      std::string* explain,
+                                      QueryScratch<typename Config::accumulator>& scratch) const {
+    QueryNode root = QueryParser::Parse(query);
+
+    // Слова приводятся к виду, в котором хранятся в индексе
+    std::function<void(QueryNode&)> prepare = [&](QueryNode& node) {
+        if (node.kind == QueryNode::Kind::Term) {
+            node.term = _normalize_term(node.term);
+            if (_needs_fuzzy_fallback(node.term, snapshots)) {
+                node.term += '~';
             }
         }
-        common_doc_ids = std::move(intersection_doc_ids);
+        for (QueryNode& child : node.children) {
+            prepare(child);
+        }
+    };
+    prepare(root);
 
-        // 2.3. Удаляем из final_doc_relevance те, которые больше не соответствуют (не содержат текущее слово)
-        // Итерируемся по копии keys, чтобы безопасно удалить из map
-        std::vector<size_t> docs_to_remove;
-        for (const auto& pair : final_doc_relevance) {
-            if (common_doc_ids.find(pair.first) == common_doc_ids.end()) {
-                docs_to_remove.push_back(pair.first);
+    const size_t max_expansions = _max_expansions();
+    _for_each_shard(snapshots.size(), explain, [&](size_t shard_index) {
+        ScoreBuffer<typename Config::accumulator>& relevance = scratch.shards[shard_index].relevance;
+        for (const auto& segment : snapshots[shard_index]->segments) {
+            // Вхождения слов читаются по мере построения дерева; раскрытые шаблоны живут до конца обхода сегмента
+            std::deque<std::vector<Entry>> expanded;
+            auto lookup = [&](const std::string& term) {
+                return segment->expanded_postings(term, max_expansions, expanded.emplace_back());
+            };
+            std::unique_ptr<PostingIterator> matches = PostingIterator::Build(root, lookup, segment->base_doc_id(),
+                                                                              segment->end_doc_id());
+
+            size_t found = 0;
+            for (size_t doc_id = matches->doc(); doc_id != PostingIterator::END; doc_id = matches->next()) {
+                relevance.push_back(doc_id, (typename Config::accumulator)matches->score());
+                ++found;
+            }
+
+            if (explain != nullptr) {
+                *explain += "segment [" + std::to_string(segment->base_doc_id()) + ", "
+                            + std::to_string(segment->end_doc_id()) + "):\n  boolean " + QueryParser::ToString(root)
+                            + ": " + std::to_string(found) + " documents\n";
             }
         }
-        for (size_t doc_id : docs_to_remove) {
-            final_doc_relevance.erase(doc_id);
+    });
+}
+
+template <typename Config>
+void SearchServer::_execute_segment(const IndexSegment& segment, const IndexSnapshot& snapshot,
+                                    const std::vector<double>& weights,
+                                    ShardScratch<typename Config::accumulator>& shard) const {
+    // Документ должен содержать все слова: если хоть одно не найдено, нет смысла продолжать (Требование 6)
+    QueryPlan& plan = shard.plan;
+    if (plan.short_circuit || plan.steps.empty() || segment.doc_count() == 0) {
+        return;
+    }
+
+    // Диапазонов не больше потоков, доставшихся шарду, и столько, чтобы на каждый пришлось не меньше
+    // RANGE_MIN_COST операций. План из одних AND битовых карт дешёв в оценке, но в конце переводит в вектор
+    // весь результат
+    double cost = 0;
+    for (const PlanStep& step : plan.steps) {
+        cost += step.estimated_cost;
+    }
+    if (plan.steps.back().method == IntersectMethod::BitmapAnd) {
+        cost += plan.steps.back().estimated_output * (double)plan.steps.size();
+    }
+    const size_t range_count = std::clamp<size_t>((size_t)(cost / RANGE_MIN_COST), 1,
+                                                  std::min(_fan_out() / _shards_count(), segment.doc_count()));
+    if (shard.ranges.size() < range_count) {
+        shard.ranges.resize(range_count);
+    }
+    plan.ranges = range_count;
+
+    _pool->ParallelFor(range_count, range_count, [&](size_t r) {
+        RangeScratch<typename Config::accumulator>& range = shard.ranges[r];
+        const size_t begin = segment.base_doc_id() + segment.doc_count() * r / range_count;
+        const size_t end = segment.base_doc_id() + segment.doc_count() * (r + 1) / range_count;
+        // У каждого диапазона своя копия плана; единственный диапазон пишет прямо в план сегмента
+        QueryPlan& range_plan = range_count == 1 ? plan : (range.plan = plan);
+        _execute_plan<Config>(range_plan, shard.terms, weights, begin, end - 1, range);
+
+        // Лучшие документы диапазона: максимум суммы среди них, поэтому относительная релевантность не меняется
+        if (_results_limit != 0) {
+            range.found.erase_if([&](size_t doc_id) { return snapshot.is_deleted(doc_id); });
+            range.found.keep_top(_results_limit, range.work);
         }
+    });
 
-        if (common_doc_ids.empty()) {
-            return {};
+    // Диапазоны идут по возрастанию doc_id
+    for (size_t r = 0; r < range_count; ++r) {
+        shard.relevance.append(shard.ranges[r].found);
+    }
+    if (range_count > 1) {
+        for (size_t k = 0; k < plan.steps.size(); ++k) {
+            PlanStep& step = plan.steps[k];
+            for (size_t r = 0; r < range_count; ++r) {
+                const PlanStep& range_step = shard.ranges[r].plan.steps[k];
+                step.actual_cost += range_step.actual_cost;
+                step.actual_output += range_step.actual_output;
+                step.elapsed_us = std::max(step.elapsed_us, range_step.elapsed_us);
+            }
         }
     }
+}
+
+template <typename Config>
+void SearchServer::_execute_plan(QueryPlan& plan, const std::vector<TermPostings>& terms,
+                                 const std::vector<double>& weights, size_t first, size_t last,
+                                 RangeScratch<typename Config::accumulator>& range) const {
+    using Accumulator = typename Config::accumulator;
+    using Scorer = typename Config::scorer;
+    using Codec = typename Config::codec;
+
+    ScoreBuffer<Accumulator>& candidates = range.candidates;
+    candidates.clear();
+    range.found.clear();
 
-    // 3. Возвращаем абсолютную релевантность только для тех документов,
-    return final_doc_relevance;
+    // Вклад вхождения position слова term в релевантность - встраивается для каждой конфигурации
+    auto contribution = [&](size_t term, size_t position) {
+        return Scorer::template score<Accumulator>(Codec::frequency(terms[term], position), weights[term]);
+    };
+
+    // Позиция первого вхождения диапазона - двоичный поиск по отсортированному списку
+    auto seek = [&](const TermPostings& term) {
+        size_t low = 0;
+        size_t high = term.entries.size();
+        while (low < high) {
+            const size_t middle = low + (high - low) / 2;
+            (Codec::doc_id(term, middle) < first ? low = middle + 1 : high = middle);
+        }
+        return low;
+    };
+
+    // Пока шаги - AND битовых карт, кандидаты хранятся картой, а релевантность не считается.
+    // Результат AND пишется попеременно в одну из двух карт scratch, чтобы не совпадать с аргументом
+    const RoaringBitmap* bitmap = nullptr;
+    size_t bitmap_steps = 0;
+
+    // Карты строятся только у сегментов с end_doc_id() <= UINT32_MAX - для них границы умещаются в 32 бита
+    const auto bitmap_first = (uint32_t)std::min<size_t>(first, UINT32_MAX);
+    const auto bitmap_last = (uint32_t)std::min<size_t>(last, UINT32_MAX);
+
+    // Переход к вектору: частоты - по позиции документа в карте каждого пройденного слова
+    auto materialize = [&]() {
+        candidates.clear();
+        bitmap->ForEach(bitmap_first, bitmap_last, [&](uint32_t doc_id) {
+            Accumulator relevance = 0;
+            for (size_t k = 0; k < bitmap_steps; ++k) {
+                const size_t term = plan.steps[k].term;
+                relevance += contribution(term, terms[term].bitmap->Rank(doc_id));
+            }
+            candidates.push_back(doc_id, relevance);
+        });
+        bitmap = nullptr;
+        return (double)(candidates.size() * bitmap_steps);
+    };
+
+    // Оставляет кандидатов, для которых match(doc_id) нашёл позицию вхождения (не NOT_FOUND), и добавляет его вклад
+    constexpr size_t NOT_FOUND = SIZE_MAX;
+    auto filter = [&](size_t term, auto match) {
+        size_t kept = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            const size_t doc_id = candidates.doc_ids[i];
+            const size_t position = match(doc_id);
+            if (position != NOT_FOUND) {
+                candidates.doc_ids[kept] = doc_id;
+                candidates.scores[kept] = candidates.scores[i] + contribution(term, position);
+                ++kept;
+            }
+        }
+        candidates.resize(kept);
+    };
+
+    for (size_t k = 0; k < plan.steps.size(); ++k) {
+        PlanStep& step = plan.steps[k];
+        const TermPostings& term = terms[step.term];
+        const std::span<const Entry> entries = term.entries;
+        const auto start = std::chrono::steady_clock::now();
+        double cost = 0;
+
+        if (step.method == IntersectMethod::BitmapAnd) {
+            if (bitmap == nullptr) {
+                bitmap = term.bitmap;
+            } else {
+                // Пересекаются только контейнеры, задевающие диапазон
+                const size_t range_containers = (bitmap_last >> 16) - (bitmap_first >> 16) + 1;
+                cost = (double)std::min({bitmap->ContainerCount(), term.bitmap->ContainerCount(), range_containers})
+                       * 65536 * QueryPlanner::BITMAP_WORD_COST;
+                RoaringBitmap& common = range.common[bitmap == &range.common[0] ? 1 : 0];
+                RoaringBitmap::And(*bitmap, *term.bitmap, common, bitmap_first, bitmap_last);
+                bitmap = &common;
+            }
+            ++bitmap_steps;
+            step.actual_output = bitmap->Rank(bitmap_last) + (bitmap->Contains(bitmap_last) ? 1 : 0)
+                                 - bitmap->Rank(bitmap_first);
+        } else {
+            if (bitmap != nullptr) {
+                cost += materialize();
+            }
+            switch (step.method) {
+                case IntersectMethod::Scan:
+                    // Инициализация (Шаг 4): по первому, самому редкому слову находим все документы
+                    for (size_t i = seek(term); i < entries.size() && Codec::doc_id(term, i) <= last; ++i) {
+                        candidates.push_back(Codec::doc_id(term, i), contribution(step.term, i));
+                    }
+                    cost += (double)candidates.size();
+                    break;
+                case IntersectMethod::LinearMerge: {
+                    const size_t start_pos = seek(term);
+                    size_t pos = start_pos;
+                    filter(step.term, [&](size_t doc_id) {
+                        while (pos < entries.size() && Codec::doc_id(term, pos) < doc_id) {
+                            ++pos;
+                        }
+                        ++cost;
+                        return pos < entries.size() && Codec::doc_id(term, pos) == doc_id ? pos : NOT_FOUND;
+                    });
+                    cost += (double)(pos - start_pos);
+                    break;
+                }
+                case IntersectMethod::Galloping: {
+                    // Экспоненциальный шаг от последней позиции, затем двоичный поиск в найденном окне
+                    size_t pos = seek(term);
+                    filter(step.term, [&](size_t doc_id) {
+                        size_t bound = 1;
+                        while (pos + bound < entries.size() && Codec::doc_id(term, pos + bound) < doc_id) {
+                            bound *= 2;
+                            ++cost;
+                        }
+                        // Двоичный поиск по позициям [pos + bound / 2, pos + bound] - через кодек, как и шаг
+                        size_t low = pos + bound / 2;
+                        size_t high = std::min(pos + bound + 1, entries.size());
+                        while (low < high) {
+                            const size_t middle = low + (high - low) / 2;
+                            (Codec::doc_id(term, middle) < doc_id ? low = middle + 1 : high = middle);
+                        }
+                        pos = low;
+                        cost += (double)std::bit_width(bound);
+                        return pos < entries.size() && Codec::doc_id(term, pos) == doc_id ? pos : NOT_FOUND;
+                    });
+                    break;
+                }
+                case IntersectMethod::BitmapProbe:
+                    cost += (double)candidates.size() * QueryPlanner::PROBE_COST;
+                    filter(step.term, [&](size_t doc_id) {
+                        return term.bitmap->Contains((uint32_t)doc_id) ? term.bitmap->Rank((uint32_t)doc_id) : NOT_FOUND;
+                    });
+                    break;
+                case IntersectMethod::BitmapAnd:
+                    break;
+            }
+            step.actual_output = candidates.size();
+        }
+
+        step.actual_cost = cost;
+        step.elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (step.actual_output == 0) {
+            break;
+        }
+    }
+    if (bitmap != nullptr) {
+        materialize();
+    }
+
+    // Возвращаем абсолютную релевантность только для тех документов, где есть все слова
+    std::swap(range.found, candidates);
 }
 
-std::vector<RelativeIndex> SearchServer::_get_ranked_results(const std::map<size_t, size_t>& absolute_relevance) const {
+template <typename Accumulator>
+std::vector<RelativeIndex> SearchServer::_get_ranked_results(const ScoreBuffer<Accumulator>& absolute_relevance,
+                                                             std::vector<float>& ranks) const {
     std::vector<RelativeIndex> ranked_results;
 
     // 1. Находим максимальную абсолютную релевантность
-    size_t max_abs_relevance = 0;
-    for (const auto& pair : absolute_relevance) {
-        if (pair.second > max_abs_relevance) {
-            max_abs_relevance = pair.second;
-        }
-    }
+    const Accumulator max_abs_relevance = MaxScore<Accumulator>(absolute_relevance.scores);
 
+    // 2. Расчет относительной релевантности - по плотному массиву сумм.
+    // Нулевой максимум - запрос из одних NOT: все найденные документы одинаково релевантны
+    ranks.resize(absolute_relevance.size());
     if (max_abs_relevance == 0) {
-        return ranked_results;
+        std::fill(ranks.begin(), ranks.end(), 1.0f);
+    } else {
+        NormalizeScores<Accumulator>(absolute_relevance.scores, max_abs_relevance, ranks);
     }
-
-    // 2. Расчет относительной релевантности
-    for (const auto& pair : absolute_relevance) {
-        float rank = (float)pair.second / max_abs_relevance;
-        ranked_results.push_back({
-            pair.first, // doc_id
-            rank
-        });
+    ranked_results.reserve(absolute_relevance.size());
+    for (size_t i = 0; i < absolute_relevance.size(); ++i) {
+        ranked_results.push_back({absolute_relevance.doc_ids[i], ranks[i]});
     }
 
-    // 3. Сортировка
-    std::sort(ranked_results.begin(), ranked_results.end(),
-        [](const RelativeIndex& a, const RelativeIndex& b) {
-
-            if (fabs(a.rank - b.rank) > float_eps) {
-                return a.rank > b.rank;
-            }
-            return a.doc_id < b.doc_id;
-        });
+    // 3. Сортировка; при ограничении числа ответов упорядочиваются только лучшие
+    auto by_rank = [](const RelativeIndex& a, const RelativeIndex& b) {
+        if (fabs(a.rank - b.rank) > float_eps) {
+            return a.rank > b.rank;
+        }
+        return a.doc_id < b.doc_id;
+    };
+    if (_results_limit != 0 && _results_limit < ranked_results.size()) {
+        std::partial_sort(ranked_results.begin(), ranked_results.begin() + (ptrdiff_t)_results_limit,
+                          ranked_results.end(), by_rank);
+        ranked_results.resize(_results_limit);
+    } else {
+        std::sort(ranked_results.begin(), ranked_results.end(), by_rank);
+    }
 
     return ranked_results;
 }
\ No newline at end of file
@@ -11,10 +11,16 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <memory_resource>
 #include <algorithm>
 #include <cmath>
 #include "InvertedIndex.h"
 #include "ConverterJSON.h"
+#include "ParallelFor.h"
+#include "QueryPlanner.h"
+#include "Scoring.h"
+#include "ShardedIndex.h"
+#include "ThreadPool.h"
 
 struct RelativeIndex {
     size_t doc_id;
@@ -26,20 +32,193 @@ struct RelativeIndex {
 
 class SearchServer {
 public:
-    SearchServer(InvertedIndex& idx) : _index(idx) {};
+    SearchServer(InvertedIndex& idx);
+
+    /* Поиск по шардам: запрос выполняется всеми шардами параллельно, их лучшие документы сливаются.
+    * Веса слов считаются по всем шардам сразу - ответ тот же, что у одного общего индекса.
+    */
+    SearchServer(ShardedIndex& idx);
 
     std::vector<std::vector<RelativeIndex>> search(const std::vector<std::string>& queries_input);
 
+    // Поиск по одному запросу. Можно вызывать из нескольких потоков одновременно.
+    std::vector<RelativeIndex> search_one(const std::string& query) const;
+
+    /* План выполнения запроса по каждому сегменту: порядок слов, способ пересечения,
+    * оценка и фактическая стоимость шагов, число кандидатов и время.
+    */
+    std::string explain(const std::string& query) const;
+
+    // Слова, которых нет в индексе, ищутся нечётко (как "слово~") - опечатки не обнуляют ответ
+    void SetFuzzyFallback(bool enabled) { _fuzzy_fallback = enabled; }
+
+    /* Формула релевантности (по умолчанию сумма частот). Выбирает заранее собранный вариант поиска,
+    * поэтому внутренний цикл не ветвится по формуле. Задаётся до начала поиска.
+    */
+    void SetRanking(Ranking ranking);
+
+    Ranking GetRanking() const { return _ranking; }
+
+    /* Число потоков на один обычный запрос (0 - по числу ядер, по умолчанию 1). Тяжёлый запрос делится
+    * по диапазонам doc_id сегмента: каждый поток переходит к началу своего диапазона двоичным поиском
+    * по вхождениям и выполняет тот же план. Булевы запросы выполняются одним потоком.
+    * Потоки берутся из постоянного пула сервера. У шардированного индекса это общее число потоков запроса
+    * на все шарды (но не меньше числа шардов): каждый шард делит свои сегменты на threads / shards диапазонов.
+    * Задаётся до начала поиска.
+    */
+    void SetQueryThreads(size_t threads_count);
+
+    /* Сколько лучших документов возвращать (0 - все, по умолчанию). Каждый диапазон оставляет
+    * только свои limit лучших, поэтому полная сортировка всех найденных документов не нужна.
+    */
+    void SetResultsLimit(size_t limit) { _results_limit = limit; }
+
+    // Наименьшая оценочная стоимость плана (QueryPlan) на один диапазон: лёгкие запросы не делятся
+    static constexpr double RANGE_MIN_COST = 1 << 15;
+
 private:
 
-    std::map<size_t, size_t> _calculate_absolute_relevance(const std::vector<std::string>& unique_words) const;
+    // Вхождения слова запроса в сегменте (с импактами, если индекс квантован); bitmap - только у плотных слов
+    struct TermPostings : PostingList {
+        const RoaringBitmap* bitmap = nullptr;
+    };
+
+    // Буферы выполнения плана по одному диапазону doc_id сегмента
+    template <typename Accumulator>
+    struct RangeScratch {
+        QueryPlan plan;                      // копия плана сегмента с фактическими значениями диапазона
+        ScoreBuffer<Accumulator> candidates; // кандидаты диапазона
+        ScoreBuffer<Accumulator> found;      // документы диапазона со всеми словами
+        std::vector<Accumulator> work;       // для отбора лучших (ScoreBuffer::keep_top)
+        RoaringBitmap common[2];             // промежуточные AND битовых карт
+    };
+
+    // Буферы выполнения запроса по одному шарду (у нешардированного индекса он один)
+    template <typename Accumulator>
+    struct ShardScratch {
+        ScoreBuffer<Accumulator> relevance;  // абсолютная релевантность по возрастанию doc_id шарда
+        std::vector<std::vector<Entry>> expanded;               // вхождения раскрытых шаблонов
+        std::vector<TermPostings> terms;
+        std::vector<TermStats> stats;
+        std::vector<char> resolved;
+        QueryPlan plan;
+        std::vector<RangeScratch<Accumulator>> ranges; // по одному на диапазон текущего сегмента
+    };
+
+    using Snapshots = std::vector<std::shared_ptr<const IndexSnapshot>>;
+
+    /* Рабочие буферы запроса. У каждого потока свои (на каждый тип суммы) и переиспользуются между запросами,
+    * поэтому в установившемся режиме подсчёт релевантности не выделяет память.
+    */
+    template <typename Accumulator>
+    struct QueryScratch {
+        ScoreBuffer<Accumulator> relevance;  // абсолютная релевантность, общие номера документов
+        std::vector<float> ranks;            // относительная релевантность
+        std::vector<double> weights;         // Scorer::weight слов запроса
+        Snapshots snapshots;                 // снимок каждого шарда; только на время запроса
+        std::vector<ShardScratch<Accumulator>> shards;
+    };
+
+    template <typename Accumulator>
+    static QueryScratch<Accumulator>& _scratch();
+
+    // Поиск по всем сегментам; если explain не nullptr, туда дописывается текст планов
+    std::vector<RelativeIndex> _search(const std::string& query, std::string* explain) const {
+        return (this->*_search_function)(query, explain);
+    }
+
+    // Поиск, собранный под конфигурацию Config (ScoringConfig)
+    template <typename Config>
+    std::vector<RelativeIndex> _search_with(const std::string& query, std::string* explain) const;
+
+    // Вес каждого слова запроса; статистика по снимкам всех шардов собирается, только если она нужна формуле
+    template <typename Config>
+    void _term_weights(const std::pmr::vector<std::pmr::string>& words, const Snapshots& snapshots,
+                       QueryScratch<typename Config::accumulator>& scratch) const;
+
+    // Слово без шаблона и без нечёткости
+    static bool _is_exact(std::string_view word);
+
+    // При включённом нечётком поиске: точного слова нет ни в одном сегменте, искать его как "слово~"
+    bool _needs_fuzzy_fallback(std::string_view word, const Snapshots& snapshots) const;
 
-    std::vector<std::string> _split_text(const std::string& text) const;
+    /* Выполняет shard_query(i) для каждого шарда i - параллельно, если шардов несколько.
+    * С explain шарды идут по очереди, и текст каждого предваряется его номером.
+    */
+    template <typename Func>
+    void _for_each_shard(size_t shards_count, std::string* explain, Func shard_query) const;
+
+    // Обычный запрос: все слова через AND, выполнение по плану (QueryPlanner); результат - в relevance шардов
+    template <typename Config>
+    void _conjunctive_relevance(const std::string& query, const Snapshots& snapshots, std::string* explain,
+                                QueryScratch<typename Config::accumulator>& scratch) const;
+
+    // Запрос с AND, OR, NOT и скобками: обход дерева итераторов по вхождениям (PostingIterator)
+    // Булев запрос ранжируется суммой частот (PostingIterator::score) при любой формуле
+    template <typename Config>
+    void _boolean_relevance(const std::string& query, const Snapshots& snapshots, std::string* explain,
+                            QueryScratch<typename Config::accumulator>& scratch) const;
+
+    /* Абсолютная релевантность документов сегмента из [first, last]: выполняет шаги plan над вхождениями terms
+    * (в порядке слов запроса, веса weights), записывает найденные документы в range.found
+    * и записывает в шаги фактическую стоимость, число кандидатов и время.
+    */
+    template <typename Config>
+    void _execute_plan(QueryPlan& plan, const std::vector<TermPostings>& terms, const std::vector<double>& weights,
+                       size_t first, size_t last, RangeScratch<typename Config::accumulator>& range) const;
+
+    /* План сегмента (shard.plan) по диапазонам doc_id - несколькими потоками, если запрос достаточно тяжёлый.
+    * Найденные документы дописываются в shard.relevance (при SetResultsLimit - только лучшие каждого диапазона),
+    * фактические значения шагов суммируются в shard.plan.
+    */
+    template <typename Config>
+    void _execute_segment(const IndexSegment& segment, const IndexSnapshot& snapshot,
+                          const std::vector<double>& weights,
+                          ShardScratch<typename Config::accumulator>& shard) const;
+
+    // Снимки индекса: по одному на шард
+    void _snapshots(Snapshots& snapshots) const;
+
+    // Настройки индекса, общие для всех шардов
+    std::string _normalize_term(std::string_view word) const {
+        return _sharded != nullptr ? _sharded->NormalizeTerm(word) : _index->NormalizeTerm(word);
+    }
+
+    size_t _max_expansions() const {
+        return _sharded != nullptr ? _sharded->GetMaxExpansions() : _index->GetMaxExpansions();
+    }
+
+    size_t _impact_bits() const { return _sharded != nullptr ? _sharded->GetImpactBits() : _index->GetImpactBits(); }
+
+    // Слова запроса ссылаются на text, вектор размещается в arena
+    std::pmr::vector<std::string_view> _split_text(std::string_view text, std::pmr::memory_resource* arena) const;
 
     // Преобразует абсолютную релевантность в относительную (rank).
-    std::vector<RelativeIndex> _get_ranked_results(const std::map<size_t, size_t>& absolute_relevance) const;
+    template <typename Accumulator>
+    std::vector<RelativeIndex> _get_ranked_results(const ScoreBuffer<Accumulator>& absolute_relevance,
+                                                   std::vector<float>& ranks) const;
+
+    using SearchFunction = std::vector<RelativeIndex> (SearchServer::*)(const std::string&, std::string*) const;
+
+    // Ровно один из двух
+    InvertedIndex* _index = nullptr;
+    ShardedIndex* _sharded = nullptr;
+
+    bool _fuzzy_fallback = false;
+
+    size_t _query_threads = 1;
+
+    // Потоки запроса: шарды и диапазоны сегментов, вместе не больше _fan_out() потоков на запрос
+    std::unique_ptr<ThreadPool> _pool;
+
+    size_t _shards_count() const { return _sharded != nullptr ? _sharded->GetShardCount() : 1; }
+
+    size_t _fan_out() const { return std::max(_shards_count(), ResolveThreadsCount(_query_threads)); }
+
+    size_t _results_limit = 0;
 
-    InvertedIndex& _index;
+    Ranking _ranking = Ranking::Count;
+    SearchFunction _search_function;
 };
 
 #endif //SEARCH_ENGINE_SEARCHSERVER_H
\ No newline at end of file
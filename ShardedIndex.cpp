@@ -0,0 +1,262 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "ShardedIndex.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include "ParallelFor.h"
+
+ShardedIndex::ShardedIndex(size_t shards_count) : _shards_count(ResolveThreadsCount(shards_count)) {
+    for (size_t i = 0; i < _shards_count; ++i) {
+        _shards.push_back(_make_shard());
+    }
+}
+
+std::unique_ptr<InvertedIndex> ShardedIndex::_make_shard() const {
+    auto shard = std::make_unique<InvertedIndex>();
+    _configure(*shard);
+    return shard;
+}
+
+void ShardedIndex::_configure(InvertedIndex& shard) const {
+    // Шарды строятся одновременно - потоки и бюджет памяти делятся между ними
+    shard.SetIndexingThreads(std::max<size_t>(1, ResolveThreadsCount(_indexing_threads) / _shards_count));
+    shard.SetMemoryBudget(_memory_budget == 0 ? 0 : std::max<size_t>(1, _memory_budget / _shards_count),
+                          _temp_directory);
+    shard.SetMaxExpansions(_max_expansions);
+    shard.SetStemming(_stemming);
+    shard.SetImpactQuantization(_impact_bits);
+}
+
+std::vector<std::vector<DocumentBuffer>> ShardedIndex::_distribute(std::vector<DocumentBuffer> docs,
+                                                                   size_t first_doc_id) const {
+    std::vector<std::vector<DocumentBuffer>> parts(_shards_count);
+    for (auto& part : parts) {
+        part.reserve(docs.size() / _shards_count + 1);
+    }
+    for (size_t i = 0; i < docs.size(); ++i) {
+        parts[(first_doc_id + i) % _shards_count].push_back(std::move(docs[i]));
+    }
+    return parts;
+}
+
+void ShardedIndex::UpdateDocumentBase(const std::vector<std::string>& input_docs, std::stop_token stop) {
+    std::vector<DocumentBuffer> buffers;
+    buffers.reserve(input_docs.size());
+    for (const std::string& text : input_docs) {
+        buffers.push_back(DocumentBuffer::FromString(text));
+    }
+    UpdateDocumentBase(std::move(buffers), std::move(stop));
+}
+
+void ShardedIndex::UpdateDocumentBase(std::vector<DocumentBuffer> input_docs, std::stop_token stop) {
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    const size_t doc_count = input_docs.size();
+    size_t bytes_total = 0;
+    for (const DocumentBuffer& doc : input_docs) {
+        bytes_total += doc.view().size();
+    }
+    std::vector<std::vector<DocumentBuffer>> parts = _distribute(std::move(input_docs), 0);
+
+    // Общий ход сборки: каждый шард передаёт в него прирост со своего прошлого отчёта.
+    // Отчёты одного шарда не идут одновременно, поэтому его прошлые значения не разделяются между потоками
+    ProgressTracker progress(doc_count, bytes_total, _progress_callback, _progress_interval, stop);
+    std::vector<IndexingProgress> reported(_shards_count);
+    std::vector<size_t> terms(_shards_count, 0);
+
+    // Новые шарды строятся рядом со старыми; исключение из потока шарда переносится в вызывающий поток
+    std::vector<std::unique_ptr<InvertedIndex>> built(_shards_count);
+    std::vector<std::exception_ptr> errors(_shards_count);
+    ParallelFor(_shards_count, _shards_count, [&](size_t i) {
+        try {
+            built[i] = _make_shard();
+            if (_progress_callback) {
+                built[i]->SetProgressCallback([&, i](const IndexingProgress& shard_progress) {
+                    progress.Add(shard_progress.docs_done - reported[i].docs_done,
+                                 shard_progress.bytes_done - reported[i].bytes_done);
+                    reported[i] = shard_progress;
+                    terms[i] = shard_progress.terms;
+                }, _progress_interval);
+            }
+            built[i]->UpdateDocumentBase(std::move(parts[i]), stop);
+            // Наблюдатель ссылается на локальные счётчики - шарду после сборки он не нужен
+            built[i]->SetProgressCallback(nullptr);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _shards.swap(built);
+    }
+    _doc_count = doc_count;
+    _broken = false;
+
+    size_t terms_total = 0;
+    for (size_t count : terms) {
+        terms_total += count;
+    }
+    progress.Finish(terms_total);
+    // Прежние шарды разрушаются здесь, вне блокировки; начатые по ним запросы держат свои снимки
+}
+
+size_t ShardedIndex::AddDocuments(const std::vector<std::string>& input_docs) {
+    std::vector<DocumentBuffer> buffers;
+    buffers.reserve(input_docs.size());
+    for (const std::string& text : input_docs) {
+        buffers.push_back(DocumentBuffer::FromString(text));
+    }
+    return AddDocuments(std::move(buffers));
+}
+
+size_t ShardedIndex::AddDocuments(std::vector<DocumentBuffer> input_docs) {
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    if (_broken) {
+        throw std::logic_error("Sharded index is inconsistent after a failed AddDocuments; rebuild it");
+    }
+    const size_t first_doc_id = _doc_count;
+    const size_t count = input_docs.size();
+    std::vector<std::vector<DocumentBuffer>> parts = _distribute(std::move(input_docs), first_doc_id);
+
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    size_t shard = 0;
+    try {
+        for (; shard < _shards_count; ++shard) {
+            if (!parts[shard].empty()) {
+                _shards[shard]->AddDocuments(std::move(parts[shard]));
+            }
+        }
+    } catch (...) {
+        /* Шарды до shard (и, возможно, сам shard) уже выдали местные номера, остальные - нет: местные номера
+        * шардов разошлись, и у следующих документов общий номер не совпал бы с шардом и местным номером.
+        * Принятые документы скрываются, а добавление запрещается до полной перестройки
+        */
+        _broken = true;
+        for (size_t doc_id = first_doc_id; doc_id < first_doc_id + count; ++doc_id) {
+            if (doc_id % _shards_count <= shard) {
+                try {
+                    _shards[doc_id % _shards_count]->RemoveDocument(doc_id / _shards_count);
+                } catch (...) {
+                    // Сбой, из-за которого не прошло добавление, может помешать и удалению
+                }
+            }
+        }
+        throw;
+    }
+    // Номера считаются выданными, только когда документы приняли все шарды: при исключении
+    // RemoveDocument не примет номера, которых нет в шардах
+    _doc_count = first_doc_id + count;
+    return first_doc_id;
+}
+
+bool ShardedIndex::RemoveDocument(size_t doc_id) {
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    if (doc_id >= _doc_count) {
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _shards[doc_id % _shards_count]->RemoveDocument(doc_id / _shards_count);
+}
+
+void ShardedIndex::Flush() {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    for (const auto& shard : _shards) {
+        shard->Flush();
+    }
+}
+
+std::vector<Entry> ShardedIndex::GetWordCount(const std::string& word) {
+    std::vector<Entry> entries;
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        for (size_t i = 0; i < _shards_count; ++i) {
+            for (Entry entry : _shards[i]->GetWordCount(word)) {
+                entry.doc_id = GlobalDocId(i, entry.doc_id);
+                entries.push_back(entry);
+            }
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.doc_id < b.doc_id; });
+    return entries;
+}
+
+IndexSegment::MemoryUsage ShardedIndex::GetMemoryUsage() const {
+    IndexSegment::MemoryUsage usage;
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    for (const auto& shard : _shards) {
+        usage += shard->GetMemoryUsage();
+    }
+    return usage;
+}
+
+void ShardedIndex::GetSnapshots(std::vector<std::shared_ptr<const IndexSnapshot>>& snapshots) const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    snapshots.resize(_shards_count);
+    for (size_t i = 0; i < _shards_count; ++i) {
+        snapshots[i] = _shards[i]->GetSnapshot();
+    }
+}
+
+void ShardedIndex::_configure_shards() {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    for (const auto& shard : _shards) {
+        _configure(*shard);
+    }
+}
+
+void ShardedIndex::SetIndexingThreads(size_t threads_count) {
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    _indexing_threads = threads_count;
+    _configure_shards();
+}
+
+void ShardedIndex::SetMaxExpansions(size_t expansions) {
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    _max_expansions = expansions;
+    _configure_shards();
+}
+
+void ShardedIndex::SetStemming(bool enabled) {
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    _stemming = enabled;
+    _configure_shards();
+}
+
+void ShardedIndex::SetImpactQuantization(size_t bits) {
+    if (bits != 0 && bits != 8 && bits != 16) {
+        throw std::invalid_argument("impact bits must be 0, 8 or 16");
+    }
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    if (bits != _impact_bits && _doc_count != 0) {
+        throw std::logic_error("Impact quantization cannot change after documents are indexed");
+    }
+    _impact_bits = bits;
+    _configure_shards();
+}
+
+void ShardedIndex::SetProgressCallback(ProgressCallback callback, std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    _progress_callback = std::move(callback);
+    _progress_interval = interval;
+}
+
+void ShardedIndex::SetMemoryBudget(size_t bytes, const std::string& temp_dir) {
+    std::lock_guard<std::mutex> ingest_lock(_ingest_mutex);
+    _memory_budget = bytes;
+    _temp_directory = temp_dir;
+    _configure_shards();
+}
+
+std::string ShardedIndex::NormalizeTerm(std::string_view word) const {
+    // Выделение основ у всех шардов одно и то же
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _shards.front()->NormalizeTerm(word);
+}
@@ -0,0 +1,142 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_SHARDEDINDEX_H
+#define SEARCH_ENGINE_SHARDEDINDEX_H
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "InvertedIndex.h"
+
+/* Индекс, разделённый по документам на несколько независимых InvertedIndex (шардов).
+* Документ doc_id лежит в шарде doc_id % N под номером doc_id / N, поэтому шарды получают поровну
+* документов и при полной перестройке, и при добавлении. У каждого шарда свой словарь, свои сегменты
+* и свои блокировки; шарды строятся параллельно.
+* SearchServer опрашивает все шарды и сливает ответы. Статистика слов (df, число документов) считается
+* по всем шардам сразу, поэтому ранжирование совпадает с одним общим индексом (в том числе Ranking::Impact:
+* импакты зависят только от частоты, idf берётся по всем шардам). Исключение - шаблоны и нечёткие слова,
+* у которых подходящих слов больше SetMaxExpansions: предел действует в каждом шарде отдельно,
+* и шарды могут подставить разные слова.
+*/
+class ShardedIndex {
+public:
+    // shards_count = 0 - по числу ядер
+    explicit ShardedIndex(size_t shards_count);
+
+    ShardedIndex(const ShardedIndex&) = delete;
+    ShardedIndex& operator=(const ShardedIndex&) = delete;
+
+    /* Перестраивает все шарды параллельно. Новые шарды подменяют прежние только все вместе:
+    * при отмене через stop или ошибке в любом из них прежний индекс остаётся нетронутым.
+    * Ход сборки шардов суммируется и передаётся в наблюдатель SetProgressCallback.
+    */
+    void UpdateDocumentBase(const std::vector<std::string>& input_docs, std::stop_token stop = {});
+
+    void UpdateDocumentBase(std::vector<DocumentBuffer> input_docs, std::stop_token stop = {});
+
+    /* Добавляет документы без перестроения индекса. Возвращает doc_id первого из них.
+    * Общие номера выдаются только после того, как документы приняли все шарды. Если шард бросил исключение,
+    * уже принятые части скрываются от поиска, но местные номера шардов расходятся: дальнейшие AddDocuments
+    * бросают std::logic_error до следующего UpdateDocumentBase. Поиск и удаление прежних документов работают.
+    */
+    size_t AddDocuments(const std::vector<std::string>& input_docs);
+
+    size_t AddDocuments(std::vector<DocumentBuffer> input_docs);
+
+    // false - нет такого документа
+    bool RemoveDocument(size_t doc_id);
+
+    void Flush();
+
+    // Вхождения слова (или шаблона) по всем шардам, по возрастанию doc_id
+    std::vector<Entry> GetWordCount(const std::string& word);
+
+    // Память всех шардов
+    IndexSegment::MemoryUsage GetMemoryUsage() const;
+
+    size_t GetShardCount() const { return _shards_count; }
+
+    // Снимки всех шардов (snapshots[i] - шард i), взятые под одной блокировкой
+    void GetSnapshots(std::vector<std::shared_ptr<const IndexSnapshot>>& snapshots) const;
+
+    // Общий номер документа doc_id шарда shard
+    size_t GlobalDocId(size_t shard, size_t doc_id) const { return doc_id * _shards_count + shard; }
+
+    // Настройки применяются ко всем шардам, в том числе к построенным позже
+
+    // Общее число потоков индексации (0 - по числу ядер); делится между шардами
+    void SetIndexingThreads(size_t threads_count);
+
+    /* Предел раскрытия шаблона действует в каждом сегменте каждого шарда отдельно, как и у сегментов
+    * одного индекса: если подходящих слов больше предела, шарды могут подставить разные слова,
+    * и ответ разойдётся с одним общим индексом. Для совпадения предел должен покрывать все слова шаблона.
+    */
+    void SetMaxExpansions(size_t expansions);
+
+    void SetStemming(bool enabled);
+
+    void SetImpactQuantization(size_t bits);
+
+    void SetMemoryBudget(size_t bytes, const std::string& temp_dir = "");
+
+    /* Наблюдатель за UpdateDocumentBase: документы и байты суммируются по всем шардам, вызывается не чаще
+    * раза в interval из потоков индексации (под блокировкой индекса - AddDocuments из него не вызывать)
+    * и один раз по окончании; terms - сумма словарей шардов.
+    */
+    void SetProgressCallback(ProgressCallback callback,
+                             std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
+    size_t GetMaxExpansions() const { return _max_expansions; }
+
+    size_t GetImpactBits() const { return _impact_bits; }
+
+    bool IsStemming() const { return _stemming; }
+
+    std::string NormalizeTerm(std::string_view word) const;
+
+private:
+    // Пустой шард с текущими настройками
+    std::unique_ptr<InvertedIndex> _make_shard() const;
+
+    // Переносит текущие настройки в шард
+    void _configure(InvertedIndex& shard) const;
+
+    // Переносит настройки во все шарды; вызывается под _ingest_mutex
+    void _configure_shards();
+
+    // Раскладывает документы по шардам начиная с общего номера first_doc_id
+    std::vector<std::vector<DocumentBuffer>> _distribute(std::vector<DocumentBuffer> docs, size_t first_doc_id) const;
+
+    const size_t _shards_count;
+
+    // Перестройка, добавление и удаление идут по одному: общие номера выдаются по порядку
+    std::mutex _ingest_mutex;
+    size_t _doc_count = 0; // выдано общих номеров
+    bool _broken = false;  // AddDocuments оборвался на части шардов; сбрасывается перестройкой
+
+    // Набор шардов подменяется целиком при UpdateDocumentBase
+    mutable std::shared_mutex _mutex;
+    std::vector<std::unique_ptr<InvertedIndex>> _shards;
+
+    size_t _indexing_threads = 0;
+    std::atomic<size_t> _max_expansions{128};
+    std::atomic<bool> _stemming{false};
+    std::atomic<size_t> _impact_bits{0};
+    size_t _memory_budget = 0;
+    std::string _temp_directory;
+    ProgressCallback _progress_callback;
+    std::chrono::milliseconds _progress_interval{1000};
+};
+
+#endif //SEARCH_ENGINE_SHARDEDINDEX_H
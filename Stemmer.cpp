@@ -0,0 +1,375 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "Stemmer.h"
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <unordered_map>
+
+namespace {
+
+// ---------- Английский (Porter2) ----------
+
+bool en_vowel(char c) {
+    return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u' || c == 'y';
+}
+
+bool ends_with(const std::string& w, std::string_view suffix) {
+    return w.size() >= suffix.size() && std::string_view(w).substr(w.size() - suffix.size()) == suffix;
+}
+
+// Начало области после первой пары "гласная, согласная" начиная с start
+size_t en_region_after(const std::string& w, size_t start) {
+    for (size_t i = start; i + 1 < w.size(); ++i) {
+        if (en_vowel(w[i]) && !en_vowel(w[i + 1])) {
+            return i + 2;
+        }
+    }
+    return w.size();
+}
+
+// Краткий слог в конце w[0, end)
+bool en_short_syllable(const std::string& w, size_t end) {
+    if (end == 2) {
+        return en_vowel(w[0]) && !en_vowel(w[1]);
+    }
+    if (end >= 3) {
+        const char c = w[end - 1];
+        return !en_vowel(w[end - 3]) && en_vowel(w[end - 2]) && !en_vowel(c) && c != 'w' && c != 'x' && c != 'Y';
+    }
+    return false;
+}
+
+// Самое длинное подходящее окончание из списка пар (окончание, замена); nullptr - ни одно не подошло
+const std::pair<std::string_view, std::string_view>* en_longest(
+    const std::string& w, std::initializer_list<std::pair<std::string_view, std::string_view>> rules) {
+    const std::pair<std::string_view, std::string_view>* best = nullptr;
+    for (const auto& rule : rules) {
+        if (ends_with(w, rule.first) && (best == nullptr || rule.first.size() > best->first.size())) {
+            best = &rule;
+        }
+    }
+    return best;
+}
+
+void replace_suffix(std::string& w, size_t suffix_size, std::string_view replacement) {
+    w.resize(w.size() - suffix_size);
+    w.append(replacement);
+}
+
+std::string en_stem(std::string w) {
+    static const std::unordered_map<std::string_view, std::string_view> exceptions = {
+        {"skis", "ski"}, {"skies", "sky"}, {"dying", "die"}, {"lying", "lie"}, {"tying", "tie"},
+        {"idly", "idl"}, {"gently", "gentl"}, {"ugly", "ugli"}, {"early", "earli"}, {"only", "onli"},
+        {"singly", "singl"}, {"sky", "sky"}, {"news", "news"}, {"howe", "howe"}, {"atlas", "atlas"},
+        {"cosmos", "cosmos"}, {"bias", "bias"}, {"andes", "andes"}
+    };
+    if (auto it = exceptions.find(w); it != exceptions.end()) {
+        return std::string(it->second);
+    }
+    if (w.size() < 3) {
+        return w;
+    }
+
+    // Подготовка: начальный апостроф убирается, согласная y помечается как Y
+    if (w[0] == '\'') {
+        w.erase(0, 1);
+    }
+    for (size_t i = 0; i < w.size(); ++i) {
+        if (w[i] == 'y' && (i == 0 || en_vowel(w[i - 1]))) {
+            w[i] = 'Y';
+        }
+    }
+
+    size_t r1 = en_region_after(w, 0);
+    for (std::string_view prefix : {"gener", "commun", "arsen"}) {
+        if (w.starts_with(prefix)) {
+            r1 = prefix.size();
+        }
+    }
+    const size_t r2 = en_region_after(w, r1);
+    auto in_r1 = [&](size_t suffix_size) { return w.size() - suffix_size >= r1; };
+    auto in_r2 = [&](size_t suffix_size) { return w.size() - suffix_size >= r2; };
+    auto has_vowel = [&](size_t end) { return std::any_of(w.begin(), w.begin() + (std::ptrdiff_t)end, en_vowel); };
+
+    // Шаг 0
+    if (auto rule = en_longest(w, {{"'s'", ""}, {"'s", ""}, {"'", ""}})) {
+        replace_suffix(w, rule->first.size(), rule->second);
+    }
+
+    // Шаг 1a
+    if (ends_with(w, "sses")) {
+        replace_suffix(w, 4, "ss");
+    } else if (ends_with(w, "ied") || ends_with(w, "ies")) {
+        replace_suffix(w, 3, w.size() > 4 ? "i" : "ie");
+    } else if (ends_with(w, "us") || ends_with(w, "ss")) {
+    } else if (ends_with(w, "s") && w.size() >= 3 && has_vowel(w.size() - 2)) {
+        w.pop_back();
+    }
+
+    for (std::string_view invariant : {"inning", "outing", "canning", "herring", "earring",
+                                       "proceed", "exceed", "succeed"}) {
+        if (w == invariant) {
+            return w;
+        }
+    }
+
+    // Шаг 1b
+    if (auto rule = en_longest(w, {{"eedly", ""}, {"ingly", ""}, {"edly", ""}, {"eed", ""}, {"ing", ""}, {"ed", ""}})) {
+        const size_t size = rule->first.size();
+        if (rule->first == "eed" || rule->first == "eedly") {
+            if (in_r1(size)) {
+                replace_suffix(w, size, "ee");
+            }
+        } else if (has_vowel(w.size() - size)) {
+            w.resize(w.size() - size);
+            if (ends_with(w, "at") || ends_with(w, "bl") || ends_with(w, "iz")) {
+                w.push_back('e');
+            } else if (w.size() >= 2 && w[w.size() - 1] == w[w.size() - 2]
+                       && std::string_view("bdfgmnprt").find(w.back()) != std::string_view::npos) {
+                w.pop_back();
+            } else if (r1 >= w.size() && en_short_syllable(w, w.size())) {
+                w.push_back('e');
+            }
+        }
+    }
+
+    // Шаг 1c
+    if (w.size() > 2 && (w.back() == 'y' || w.back() == 'Y') && !en_vowel(w[w.size() - 2])) {
+        w.back() = 'i';
+    }
+
+    // Шаг 2
+    if (auto rule = en_longest(w, {
+            {"ization", "ize"}, {"ational", "ate"}, {"fulness", "ful"}, {"ousness", "ous"}, {"iveness", "ive"},
+            {"tional", "tion"}, {"biliti", "ble"}, {"lessli", "less"}, {"entli", "ent"}, {"ation", "ate"},
+            {"alism", "al"}, {"aliti", "al"}, {"ousli", "ous"}, {"iviti", "ive"}, {"fulli", "ful"},
+            {"enci", "ence"}, {"anci", "ance"}, {"abli", "able"}, {"izer", "ize"}, {"ator", "ate"},
+            {"alli", "al"}, {"bli", "ble"}, {"ogi", "og"}, {"li", ""}})) {
+        const size_t size = rule->first.size();
+        if (in_r1(size)) {
+            const char before = w.size() > size ? w[w.size() - size - 1] : '\0';
+            if (rule->first == "ogi") {
+                if (before == 'l') {
+                    replace_suffix(w, size, rule->second);
+                }
+            } else if (rule->first == "li") {
+                if (before != '\0' && std::string_view("cdeghkmnrt").find(before) != std::string_view::npos) {
+                    replace_suffix(w, size, rule->second);
+                }
+            } else {
+                replace_suffix(w, size, rule->second);
+            }
+        }
+    }
+
+    // Шаг 3
+    if (auto rule = en_longest(w, {
+            {"ational", "ate"}, {"tional", "tion"}, {"alize", "al"}, {"icate", "ic"}, {"iciti", "ic"},
+            {"ative", ""}, {"ical", "ic"}, {"ness", ""}, {"ful", ""}})) {
+        const size_t size = rule->first.size();
+        if (in_r1(size) && (rule->first != "ative" || in_r2(size))) {
+            replace_suffix(w, size, rule->second);
+        }
+    }
+
+    // Шаг 4
+    if (auto rule = en_longest(w, {
+            {"ement", ""}, {"ance", ""}, {"ence", ""}, {"able", ""}, {"ible", ""}, {"ment", ""}, {"ant", ""},
+            {"ent", ""}, {"ism", ""}, {"ate", ""}, {"iti", ""}, {"ous", ""}, {"ive", ""}, {"ize", ""},
+            {"ion", ""}, {"al", ""}, {"er", ""}, {"ic", ""}})) {
+        const size_t size = rule->first.size();
+        if (in_r2(size)) {
+            if (rule->first != "ion") {
+                w.resize(w.size() - size);
+            } else if (w.size() > size && (w[w.size() - size - 1] == 's' || w[w.size() - size - 1] == 't')) {
+                w.resize(w.size() - size);
+            }
+        }
+    }
+
+    // Шаг 5
+    if (ends_with(w, "e")) {
+        if (in_r2(1) || (in_r1(1) && !en_short_syllable(w, w.size() - 1))) {
+            w.pop_back();
+        }
+    } else if (ends_with(w, "ll") && in_r2(1)) {
+        w.pop_back();
+    }
+
+    std::replace(w.begin(), w.end(), 'Y', 'y');
+    return w;
+}
+
+// ---------- Русский ----------
+
+bool ru_vowel(char32_t c) {
+    return c == U'а' || c == U'е' || c == U'и' || c == U'о' || c == U'у' || c == U'ы' || c == U'э' || c == U'ю'
+           || c == U'я';
+}
+
+size_t ru_region_after(const std::u32string& w, size_t start) {
+    for (size_t i = start; i + 1 < w.size(); ++i) {
+        if (ru_vowel(w[i]) && !ru_vowel(w[i + 1])) {
+            return i + 2;
+        }
+    }
+    return w.size();
+}
+
+bool ends_with(const std::u32string& w, std::u32string_view suffix) {
+    return w.size() >= suffix.size() && std::u32string_view(w).substr(w.size() - suffix.size()) == suffix;
+}
+
+// Длина самого длинного окончания из списка, целиком лежащего в [start, size); 0 - нет
+size_t ru_longest(const std::u32string& w, size_t start, std::initializer_list<std::u32string_view> endings) {
+    size_t best = 0;
+    for (std::u32string_view ending : endings) {
+        if (ending.size() > best && w.size() >= start + ending.size() && ends_with(w, ending)) {
+            best = ending.size();
+        }
+    }
+    return best;
+}
+
+// Окончания двух групп: первой - только после "а" или "я" (тоже в области), второй - без условий
+size_t ru_grouped(const std::u32string& w, size_t start, std::initializer_list<std::u32string_view> after_a,
+                  std::initializer_list<std::u32string_view> plain) {
+    const size_t first = ru_longest(w, start, after_a);
+    const size_t second = ru_longest(w, start, plain);
+    if (second >= first) {
+        return second;
+    }
+    const size_t pos = w.size() - first;
+    return pos > start && (w[pos - 1] == U'а' || w[pos - 1] == U'я') ? first : 0;
+}
+
+void ru_stem(std::u32string& w) {
+    std::replace(w.begin(), w.end(), U'ё', U'е');
+
+    size_t rv = w.size();
+    for (size_t i = 0; i < w.size(); ++i) {
+        if (ru_vowel(w[i])) {
+            rv = i + 1;
+            break;
+        }
+    }
+    const size_t r2 = ru_region_after(w, ru_region_after(w, 0));
+    auto cut = [&w](size_t size) { w.resize(w.size() - size); };
+
+    // Шаг 1: деепричастие, иначе возвратность + прилагательное/глагол/существительное
+    if (size_t size = ru_grouped(w, rv, {U"в", U"вши", U"вшись"},
+                                 {U"ив", U"ивши", U"ившись", U"ыв", U"ывши", U"ывшись"})) {
+        cut(size);
+    } else {
+        cut(ru_longest(w, rv, {U"ся", U"сь"}));
+
+        if (size_t adjective = ru_longest(w, rv, {
+                U"ее", U"ие", U"ые", U"ое", U"ими", U"ыми", U"ей", U"ий", U"ый", U"ой", U"ем", U"им", U"ым",
+                U"ом", U"его", U"ого", U"ему", U"ому", U"их", U"ых", U"ую", U"юю", U"ая", U"яя", U"ою", U"ею"})) {
+            cut(adjective);
+            cut(ru_grouped(w, rv, {U"ем", U"нн", U"вш", U"ющ", U"щ"}, {U"ивш", U"ывш", U"ующ"}));
+        } else if (size_t verb = ru_grouped(w, rv,
+                {U"ла", U"на", U"ете", U"йте", U"ли", U"й", U"л", U"ем", U"н", U"ло", U"но", U"ет", U"ют", U"ны",
+                 U"ть", U"ешь", U"нно"},
+                {U"ила", U"ыла", U"ена", U"ейте", U"уйте", U"ите", U"или", U"ыли", U"ей", U"уй", U"ил", U"ыл",
+                 U"им", U"ым", U"ен", U"ило", U"ыло", U"ено", U"ят", U"ует", U"уют", U"ит", U"ыт", U"ены", U"ить",
+                 U"ыть", U"ишь", U"ую", U"ю"})) {
+            cut(verb);
+        } else {
+            cut(ru_longest(w, rv, {
+                U"а", U"ев", U"ов", U"ие", U"ье", U"е", U"иями", U"ями", U"ами", U"еи", U"ии", U"и", U"ией",
+                U"ей", U"ой", U"ий", U"й", U"иям", U"ям", U"ием", U"ем", U"ам", U"ом", U"о", U"у", U"ах", U"иях",
+                U"ях", U"ы", U"ь", U"ию", U"ью", U"ю", U"ия", U"ья", U"я"}));
+        }
+    }
+
+    // Шаг 2
+    cut(ru_longest(w, rv, {U"и"}));
+
+    // Шаг 3: словообразовательные окончания в R2
+    cut(ru_longest(w, std::max(rv, r2), {U"ост", U"ость"}));
+
+    // Шаг 4
+    if (size_t superlative = ru_longest(w, rv, {U"ейш", U"ейше"})) {
+        cut(superlative);
+        cut(ru_longest(w, rv, {U"нн"}) ? 1 : 0);
+    } else if (ru_longest(w, rv, {U"нн"})) {
+        cut(1);
+    } else {
+        cut(ru_longest(w, rv, {U"ь"}));
+    }
+}
+
+// UTF-8 <-> UTF-32 только для кириллических слов; false - в слове есть другие символы
+bool decode_cyrillic(std::string_view word, std::u32string& out) {
+    out.clear();
+    for (size_t i = 0; i < word.size(); i += 2) {
+        const auto lead = (uint8_t)word[i];
+        if ((lead != 0xD0 && lead != 0xD1) || i + 1 >= word.size() || ((uint8_t)word[i + 1] & 0xC0) != 0x80) {
+            return false;
+        }
+        out.push_back((char32_t)(((lead & 0x1F) << 6) | ((uint8_t)word[i + 1] & 0x3F)));
+    }
+    return !out.empty();
+}
+
+std::string encode_utf8(const std::u32string& word) {
+    std::string out;
+    out.reserve(word.size() * 2);
+    for (char32_t c : word) {
+        out.push_back((char)(0xC0 | (c >> 6)));
+        out.push_back((char)(0x80 | (c & 0x3F)));
+    }
+    return out;
+}
+
+bool is_english(std::string_view word) {
+    return !word.empty() && std::all_of(word.begin(), word.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || c == '\'';
+    });
+}
+
+// Прозрачный хеш: поиск в кэше по string_view без создания строки
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+};
+
+} // namespace
+
+std::string Stemmer::StemEnglish(std::string_view word) {
+    return en_stem(std::string(word));
+}
+
+std::string Stemmer::StemRussian(std::string_view word) {
+    std::u32string letters;
+    if (!decode_cyrillic(word, letters)) {
+        return std::string(word);
+    }
+    ru_stem(letters);
+    return encode_utf8(letters);
+}
+
+std::string Stemmer::Stem(std::string_view word) {
+    if (is_english(word)) {
+        return StemEnglish(word);
+    }
+    return StemRussian(word);
+}
+
+const std::string& Stemmer::StemCached(std::string_view word) {
+    // Кэш ограничен, чтобы редкие слова длинного корпуса не съели память потока
+    constexpr size_t MAX_CACHED = 1 << 16;
+    thread_local std::unordered_map<std::string, std::string, StringHash, std::equal_to<>> cache;
+
+    if (auto it = cache.find(word); it != cache.end()) {
+        return it->second;
+    }
+    if (cache.size() >= MAX_CACHED) {
+        cache.clear();
+    }
+    return cache.emplace(std::string(word), Stem(word)).first->second;
+}
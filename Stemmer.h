@@ -0,0 +1,32 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_STEMMER_H
+#define SEARCH_ENGINE_STEMMER_H
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/* Выделение основы слова по алгоритмам Snowball: русскому и английскому (Porter2).
+ * Язык определяется по буквам: только кириллица - русский, только латиница в нижнем регистре - английский.
+ * Прочие слова (цифры, смешанные алфавиты, заглавные латинские буквы) возвращаются без изменений.
+ * Используется и при индексации, и при разборе запроса, чтобы основы совпадали.
+ */
+class Stemmer {
+public:
+    static std::string Stem(std::string_view word);
+
+    /* То же, но с памятью уже посчитанных основ в текущем потоке: повторяющиеся слова не разбираются заново.
+    * Ссылка действительна до следующего вызова в этом потоке.
+    */
+    static const std::string& StemCached(std::string_view word);
+
+    static std::string StemEnglish(std::string_view word);
+
+    static std::string StemRussian(std::string_view word);
+};
+
+#endif //SEARCH_ENGINE_STEMMER_H
@@ -0,0 +1,329 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "TermDictionary.h"
+#include <algorithm>
+
+namespace {
+
+void put_varint(std::vector<char>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+size_t get_varint(const char*& in) {
+    size_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const auto byte = (uint8_t)*in++;
+        value |= (size_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+
+// Длина символа UTF-8 по первому байту
+size_t utf8_length(char lead) {
+    const auto byte = (uint8_t)lead;
+    if (byte < 0x80) return 1;
+    if ((byte >> 5) == 0x6) return 2;
+    if ((byte >> 4) == 0xE) return 3;
+    if ((byte >> 3) == 0x1E) return 4;
+    return 1;
+}
+
+// Байты символа, упакованные в одно число - для быстрого сравнения символов
+uint32_t pack_symbol(std::string_view text, size_t pos, size_t length) {
+    uint32_t symbol = 0;
+    for (size_t i = 0; i < length; ++i) {
+        symbol = (symbol << 8) | (uint8_t)text[pos + i];
+    }
+    return symbol;
+}
+
+} // namespace
+
+TermDictionary::TermDictionary(const std::vector<std::string_view>& terms) : _size(terms.size()) {
+    std::string_view previous;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        const std::string_view term = terms[i];
+        if (i % BLOCK_SIZE == 0) {
+            _blocks.push_back((uint32_t)_data.size());
+            put_varint(_data, term.size());
+            _data.insert(_data.end(), term.begin(), term.end());
+        } else {
+            const size_t shared = std::mismatch(previous.begin(), previous.end(), term.begin(), term.end()).first
+                                  - previous.begin();
+            put_varint(_data, shared);
+            put_varint(_data, term.size() - shared);
+            _data.insert(_data.end(), term.begin() + (std::ptrdiff_t)shared, term.end());
+        }
+        previous = term;
+    }
+    _data.shrink_to_fit();
+    _blocks.shrink_to_fit();
+}
+
+std::string_view TermDictionary::_block_head(size_t block) const {
+    const char* in = _data.data() + _blocks[block];
+    const size_t length = get_varint(in);
+    return {in, length};
+}
+
+class TermDictionary::Cursor {
+public:
+    explicit Cursor(const TermDictionary& dictionary) : _dictionary(dictionary) {}
+
+    // Встаёт на первый термин >= target. false - таких нет.
+    // Переходы обычно идут вперёд и недалеко, поэтому блок ищется галопом от текущего.
+    bool Seek(std::string_view target) {
+        const auto& blocks = _dictionary._blocks;
+        if (blocks.empty()) {
+            return false;
+        }
+
+        // Последний блок, первый термин которого не больше target
+        size_t lo = 0, hi = blocks.size();
+        const size_t current = _index / BLOCK_SIZE;
+        if (current < blocks.size() && _dictionary._block_head(current) <= target) {
+            lo = current;
+            for (size_t step = 1; lo + step < blocks.size(); step *= 2) {
+                if (_dictionary._block_head(lo + step) > target) {
+                    hi = lo + step;
+                    break;
+                }
+                lo += step;
+            }
+        }
+        while (hi - lo > 1) {
+            const size_t mid = (lo + hi) / 2;
+            if (_dictionary._block_head(mid) <= target) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        _previous.swap(_term);
+        _index = lo * BLOCK_SIZE;
+        _in = _dictionary._data.data() + blocks[lo];
+        _decode();
+        while (std::string_view(_term) < target) {
+            if (!Next()) {
+                return false;
+            }
+        }
+        _shared = std::mismatch(_previous.begin(), _previous.end(), _term.begin(), _term.end()).first
+                  - _previous.begin();
+        return true;
+    }
+
+    bool Next() {
+        if (++_index >= _dictionary._size) {
+            return false;
+        }
+        _decode();
+        return true;
+    }
+
+    std::string_view term() const { return _term; }
+
+    // Длина общего префикса с предыдущим термином курсора
+    size_t shared() const { return _shared; }
+
+private:
+    void _decode() {
+        if (_index % BLOCK_SIZE == 0) {
+            const size_t length = get_varint(_in);
+            _shared = std::mismatch(_term.begin(), _term.end(), _in, _in + length).first - _term.begin();
+            _term.assign(_in, length);
+            _in += length;
+        } else {
+            _shared = get_varint(_in);
+            const size_t suffix = get_varint(_in);
+            _term.resize(_shared);
+            _term.append(_in, suffix);
+            _in += suffix;
+        }
+    }
+
+    const TermDictionary& _dictionary;
+    size_t _index = 0;
+    const char* _in = nullptr;
+    std::string _term;
+    std::string _previous;
+    size_t _shared = 0;
+};
+
+std::vector<std::string> TermDictionary::Expand(std::string_view pattern, size_t limit) const {
+    std::vector<std::string> result;
+    if (limit == 0) {
+        return result;
+    }
+
+    // Буквальное начало шаблона ограничивает диапазон словаря
+    const std::string_view literal = pattern.substr(0, std::min(pattern.find_first_of("*?"), pattern.size()));
+    const bool prefix_only = literal.size() + 1 == pattern.size() && pattern.back() == '*';
+
+    Cursor cursor(*this);
+    for (bool found = cursor.Seek(literal); found && cursor.term().starts_with(literal); found = cursor.Next()) {
+        if (prefix_only || WildcardMatch(pattern, cursor.term())) {
+            result.emplace_back(cursor.term());
+            if (result.size() >= limit) {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> TermDictionary::ExpandFuzzy(std::string_view word, unsigned max_distance,
+                                                     size_t prefix_length, size_t limit) const {
+    // Символы слова и байты обязательного префикса
+    std::vector<uint32_t> query;
+    size_t literal_size = 0;
+    for (size_t pos = 0; pos < word.size();) {
+        const size_t length = std::min(utf8_length(word[pos]), word.size() - pos);
+        query.push_back(pack_symbol(word, pos, length));
+        pos += length;
+        if (query.size() <= prefix_length) {
+            literal_size = pos;
+        }
+    }
+    const std::string_view literal = word.substr(0, literal_size);
+    const size_t n = query.size();
+    const auto cutoff = (uint8_t)std::min<unsigned>(max_distance + 1, 255);
+
+    // Автомат Левенштейна в виде строк динамики: rows[pos] - расстояния от префиксов word
+    // до первых pos байт термина (заполнены только на границах символов).
+    // Соседние термины словаря делят префикс, поэтому строки для него пересчитывать не нужно.
+    std::vector<std::vector<uint8_t>> rows(1, std::vector<uint8_t>(n + 1));
+    for (size_t j = 0; j <= n; ++j) {
+        rows[0][j] = (uint8_t)std::min<size_t>(j, cutoff);
+    }
+    size_t computed = 0; // сколько байт текущего термина покрыто строками
+
+    std::vector<std::pair<uint8_t, std::string>> candidates;
+    Cursor cursor(*this);
+    bool found = cursor.Seek(literal);
+    while (found && cursor.term().starts_with(literal)) {
+        const std::string_view term = cursor.term();
+        size_t pos = std::min(computed, cursor.shared());
+        while (pos > 0 && pos < term.size() && ((uint8_t)term[pos] & 0xC0) == 0x80) {
+            --pos;
+        }
+
+        // Дочитываем термин по символам, пока строка не вышла за max_distance
+        bool dead = false;
+        while (pos < term.size()) {
+            const size_t length = std::min(utf8_length(term[pos]), term.size() - pos);
+            const uint32_t symbol = pack_symbol(term, pos, length);
+            if (rows.size() <= pos + length) {
+                rows.resize(pos + length + 1, std::vector<uint8_t>(n + 1));
+            }
+            const std::vector<uint8_t>& prev = rows[pos];
+            std::vector<uint8_t>& next = rows[pos + length];
+            next[0] = (uint8_t)std::min<unsigned>(prev[0] + 1u, cutoff);
+            uint8_t row_min = next[0];
+            for (size_t j = 1; j <= n; ++j) {
+                unsigned value = std::min<unsigned>(prev[j] + 1u, next[j - 1] + 1u);
+                value = std::min<unsigned>(value, prev[j - 1] + (query[j - 1] == symbol ? 0u : 1u));
+                next[j] = (uint8_t)std::min<unsigned>(value, cutoff);
+                row_min = std::min(row_min, next[j]);
+            }
+            pos += length;
+            if (row_min >= cutoff) {
+                dead = true;
+                break;
+            }
+        }
+        computed = pos;
+
+        if (!dead) {
+            if (rows[pos][n] < cutoff) {
+                candidates.emplace_back(rows[pos][n], term);
+            }
+            found = cursor.Next();
+            continue;
+        }
+
+        // Ни одно продолжение этого префикса не подойдёт - перескакиваем все термины с ним
+        std::string next_prefix(term.substr(0, pos));
+        while (!next_prefix.empty() && (uint8_t)next_prefix.back() == 0xFF) {
+            next_prefix.pop_back();
+        }
+        if (next_prefix.empty()) {
+            break;
+        }
+        next_prefix.back() = (char)((uint8_t)next_prefix.back() + 1);
+        found = cursor.Seek(next_prefix);
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<std::string> result;
+    for (size_t i = 0; i < candidates.size() && i < limit; ++i) {
+        result.push_back(std::move(candidates[i].second));
+    }
+    return result;
+}
+
+bool TermDictionary::ParseFuzzy(std::string_view word, FuzzyQuery& query) {
+    const size_t tilde = word.rfind('~');
+    if (tilde == std::string_view::npos || tilde == 0) {
+        return false;
+    }
+    const std::string_view suffix = word.substr(tilde + 1);
+    unsigned requested = 2;
+    if (suffix.size() == 1 && suffix[0] >= '0' && suffix[0] <= '2') {
+        requested = (unsigned)(suffix[0] - '0');
+    } else if (!suffix.empty()) {
+        return false;
+    }
+
+    query.word = word.substr(0, tilde);
+    size_t symbols = 0;
+    for (char c : query.word) {
+        symbols += ((uint8_t)c & 0xC0) != 0x80;
+    }
+    const unsigned allowed = symbols <= 2 ? 0 : symbols <= 5 ? 1 : 2;
+    query.max_distance = std::min(requested, allowed);
+    query.prefix_length = query.max_distance >= 2 ? 1 : 0;
+    return true;
+}
+
+bool TermDictionary::IsPattern(std::string_view word) {
+    return word.find_first_of("*?") != std::string_view::npos;
+}
+
+bool TermDictionary::WildcardMatch(std::string_view pattern, std::string_view text) {
+    // Жадное сопоставление с возвратом к последней '*'
+    size_t p = 0, t = 0;
+    size_t star = std::string_view::npos, star_text = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && pattern[p] == '?') {
+            ++p;
+            t += utf8_length(text[t]);
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_text = t;
+        } else if (p < pattern.size() && pattern[p] == text[t]) {
+            ++p;
+            ++t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            star_text += utf8_length(text[star_text]);
+            t = star_text;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size() && t == text.size();
+}
@@ -0,0 +1,74 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_TERMDICTIONARY_H
+#define SEARCH_ENGINE_TERMDICTIONARY_H
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Компактный отсортированный словарь терминов для раскрытия шаблонов.
+ * Термины хранятся блоками по BLOCK_SIZE с фронтальным сжатием: первый термин блока целиком,
+ * остальные - длиной общего с предыдущим префикса и оставшимся суффиксом.
+ * Поиск начала диапазона - двоичный по первым терминам блоков, дальше последовательное чтение.
+ */
+class TermDictionary {
+public:
+    static constexpr size_t BLOCK_SIZE = 16;
+
+    TermDictionary() = default;
+
+    // terms должны быть отсортированы по возрастанию и не повторяться
+    explicit TermDictionary(const std::vector<std::string_view>& terms);
+
+    size_t size() const { return _size; }
+
+    size_t memory_usage() const { return _data.capacity() + _blocks.capacity() * sizeof(uint32_t); }
+
+    /* Термины, подходящие под шаблон: '*' - любая последовательность символов, '?' - ровно один символ (UTF-8).
+    * Возвращается не больше limit первых по порядку терминов.
+    */
+    std::vector<std::string> Expand(std::string_view pattern, size_t limit) const;
+
+    /* Термины на расстоянии Левенштейна (в символах UTF-8) не больше max_distance от word,
+    * у которых первые prefix_length символов совпадают с word. Ближайшие - первыми, не больше limit.
+    */
+    std::vector<std::string> ExpandFuzzy(std::string_view word, unsigned max_distance, size_t prefix_length,
+                                         size_t limit) const;
+
+    // Разобранное нечёткое слово запроса: "word~" (расстояние по длине слова) или "word~1", "word~2"
+    struct FuzzyQuery {
+        std::string_view word;
+        unsigned max_distance = 0;
+        size_t prefix_length = 0;
+    };
+
+    /* false - слово не нечёткое. Модель стоимости: короткие слова (до 2 символов) не размываются, до 5 символов -
+    * не больше одной правки, для двух правок первый символ должен совпадать - иначе кандидатов слишком много.
+    */
+    static bool ParseFuzzy(std::string_view word, FuzzyQuery& query);
+
+    // Есть ли в слове символы шаблона
+    static bool IsPattern(std::string_view word);
+
+    static bool WildcardMatch(std::string_view pattern, std::string_view text);
+
+private:
+    // Последовательное чтение терминов с переходом к произвольному месту словаря
+    class Cursor;
+
+    // Первый термин блока
+    std::string_view _block_head(size_t block) const;
+
+    std::vector<char> _data;
+    std::vector<uint32_t> _blocks; // смещения блоков в _data
+    size_t _size = 0;
+};
+
+#endif //SEARCH_ENGINE_TERMDICTIONARY_H
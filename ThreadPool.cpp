@@ -0,0 +1,99 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t workers_count) {
+    try {
+        _workers.reserve(workers_count);
+        for (size_t i = 0; i < workers_count; ++i) {
+            _workers.emplace_back(&ThreadPool::_worker_loop, this);
+        }
+    } catch (...) {
+        // Деструктор не вызовется: уже запущенные потоки останавливаем здесь, иначе std::terminate
+        _stop_workers();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    _stop_workers();
+}
+
+void ThreadPool::_stop_workers() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _jobs_cv.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::_execute(Job& job) {
+    const size_t helpers = job.helpers; // после публикации поле меняют потоки пула
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(&job);
+    }
+    if (helpers == 1) {
+        _jobs_cv.notify_one();
+    } else {
+        _jobs_cv.notify_all();
+    }
+
+    _work(job);
+
+    // Индексы кончились; ждём потоки, которые ещё дорабатывают взятые индексы
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto queued = std::find(_jobs.begin(), _jobs.end(), &job);
+    if (queued != _jobs.end()) {
+        _jobs.erase(queued);
+    }
+    _done_cv.wait(lock, [&] { return job.active == 0; });
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
+
+void ThreadPool::_work(Job& job) {
+    for (size_t i = job.next.fetch_add(1, std::memory_order_relaxed); i < job.count;
+         i = job.next.fetch_add(1, std::memory_order_relaxed)) {
+        try {
+            job.run(job.context, i);
+        } catch (...) {
+            // Оставшиеся индексы не раздаём - задача всё равно завершится ошибкой
+            job.next = job.count;
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!job.error) {
+                job.error = std::current_exception();
+            }
+        }
+    }
+}
+
+void ThreadPool::_worker_loop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _jobs_cv.wait(lock, [this] { return _stop || !_jobs.empty(); });
+        if (_stop) {
+            return;
+        }
+        Job& job = *_jobs.front();
+        if (--job.helpers == 0) {
+            _jobs.pop_front();
+        }
+        ++job.active;
+        lock.unlock();
+
+        _work(job);
+
+        lock.lock();
+        if (--job.active == 0) {
+            _done_cv.notify_all();
+        }
+    }
+}
@@ -0,0 +1,87 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_THREADPOOL_H
+#define SEARCH_ENGINE_THREADPOOL_H
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/* Постоянный пул потоков для задач вида ParallelFor. В отличие от ParallelFor, потоки не создаются
+ * на каждый вызов. Вызывающий поток работает вместе с пулом, поэтому вложенные вызовы (из задачи пула)
+ * не блокируются: если свободных потоков нет, вложенная задача просто выполняется вызывающим потоком.
+ */
+class ThreadPool {
+public:
+    // Если поток не запустился, уже запущенные останавливаются и исключение пробрасывается
+    explicit ThreadPool(size_t workers_count);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t GetWorkersCount() const { return _workers.size(); }
+
+    /* Выполняет func(i) для i из [0, count) не более чем threads_count потоками, включая вызывающий.
+    * Возвращается, когда все индексы обработаны; первое исключение из func пробрасывается.
+    */
+    template <typename Func>
+    void ParallelFor(size_t count, size_t threads_count, Func&& func) {
+        threads_count = std::min({threads_count, count, _workers.size() + 1});
+        if (threads_count <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+            return;
+        }
+        Job job;
+        job.run = [](void* context, size_t i) { (*static_cast<std::remove_reference_t<Func>*>(context))(i); };
+        job.context = &func;
+        job.count = count;
+        job.helpers = threads_count - 1;
+        _execute(job);
+    }
+
+private:
+    struct Job {
+        void (*run)(void*, size_t) = nullptr;
+        void* context = nullptr;
+        size_t count = 0;
+        size_t helpers = 0;             // сколько ещё потоков пула может присоединиться
+        size_t active = 0;              // потоков пула, работающих над задачей (под _mutex)
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;       // первое исключение (под _mutex)
+    };
+
+    // Ставит задачу в очередь, выполняет её вместе с пулом и дожидается всех присоединившихся потоков
+    void _execute(Job& job);
+
+    // Разбирает индексы задачи, пока они не кончатся
+    void _work(Job& job);
+
+    void _worker_loop();
+
+    // Останавливает и дожидается всех запущенных потоков
+    void _stop_workers();
+
+    std::mutex _mutex;
+    std::condition_variable _jobs_cv;
+    std::condition_variable _done_cv;
+    std::deque<Job*> _jobs;
+    bool _stop = false;
+    std::vector<std::thread> _workers;
+};
+
+#endif //SEARCH_ENGINE_THREADPOOL_H
@@ -0,0 +1,434 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "UringLoader.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <initializer_list>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define SEARCH_ENGINE_IO_URING 1
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef SEARCH_ENGINE_IO_URING
+namespace {
+
+/* Минимальная обёртка над кольцами io_uring на сырых системных вызовах (без liburing).
+ * Используется из одного потока.
+ */
+class Ring {
+public:
+    explicit Ring(unsigned entries) {
+        io_uring_params params {};
+        _fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (_fd < 0) {
+            return;
+        }
+
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        }
+
+        _sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        _fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED) {
+            _sq_ring = nullptr;
+            return;
+        }
+        if (single_mmap) {
+            _cq_ring = _sq_ring;
+        } else {
+            _cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            _fd, IORING_OFF_CQ_RING);
+            if (_cq_ring == MAP_FAILED) {
+                _cq_ring = nullptr;
+                return;
+            }
+        }
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          _fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return;
+        }
+        _sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(_sq_ring);
+        _sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        _sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        _sq_entries = params.sq_entries;
+
+        char* cq = static_cast<char*>(_cq_ring);
+        _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        _cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // Кольцо без нужных операций бесполезно: лучше сразу уйти на запасной путь
+        if (!_supports({IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE})) {
+            munmap(_sqes, _sqes_size);
+            _sqes = nullptr;
+        }
+    }
+
+    ~Ring() {
+        if (_sqes != nullptr) {
+            munmap(_sqes, _sqes_size);
+        }
+        if (_cq_ring != nullptr && _cq_ring != _sq_ring) {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+        if (_sq_ring != nullptr) {
+            munmap(_sq_ring, _sq_ring_size);
+        }
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    bool is_ready() const { return _sqes != nullptr; }
+
+    unsigned capacity() const { return _sq_entries; }
+
+    // Свободный SQE или nullptr, если очередь отправки заполнена
+    io_uring_sqe* get_sqe() {
+        const unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+        if (_local_tail - head >= _sq_entries) {
+            return nullptr;
+        }
+        const unsigned index = _local_tail & _sq_mask;
+        io_uring_sqe* sqe = &_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        _sq_array[index] = index;
+        ++_local_tail;
+        return sqe;
+    }
+
+    /* Отправляет накопленные SQE и ждёт хотя бы wait_for завершений. Возвращает 0 или errno.
+    * Ядро может принять только часть SQE (тогда оно не ждёт завершений) - остаток уходит при следующем вызове.
+    */
+    int submit_and_wait(unsigned wait_for) {
+        __atomic_store_n(_sq_tail, _local_tail, __ATOMIC_RELEASE);
+        for (;;) {
+            // Не принятые ядром SQE лежат между его head и нашим tail
+            const unsigned to_submit = _local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+            long ret = syscall(__NR_io_uring_enter, _fd, to_submit, wait_for,
+                               wait_for > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (ret >= 0) {
+                return 0;
+            }
+            // Переполнена очередь завершений или не хватило памяти - сначала разбираем готовое
+            if (errno == EBUSY || errno == EAGAIN) {
+                return 0;
+            }
+            if (errno != EINTR) {
+                return errno;
+            }
+        }
+    }
+
+    // Свободных мест в очереди отправки
+    unsigned sq_space() const {
+        return _sq_entries - (_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE));
+    }
+
+    // Обходит готовые завершения и освобождает их слоты
+    template <typename Func>
+    void for_each_completion(Func&& func) {
+        unsigned head = *_cq_head;
+        const unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = _cqes[head & _cq_mask];
+            func(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    // Поддерживает ли ядро все операции (IORING_REGISTER_PROBE, Linux 5.6+; на старых ядрах - EINVAL)
+    bool _supports(std::initializer_list<int> opcodes) const {
+        std::vector<char> memory(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(memory.data());
+        if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+            return false;
+        }
+        for (int opcode : opcodes) {
+            if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int _fd = -1;
+    void* _sq_ring = nullptr;
+    void* _cq_ring = nullptr;
+    size_t _sq_ring_size = 0;
+    size_t _cq_ring_size = 0;
+    size_t _sqes_size = 0;
+    io_uring_sqe* _sqes = nullptr;
+
+    unsigned* _sq_head = nullptr;
+    unsigned* _sq_tail = nullptr;
+    unsigned* _sq_array = nullptr;
+    unsigned _sq_mask = 0;
+    unsigned _sq_entries = 0;
+    unsigned _local_tail = 0;
+
+    unsigned* _cq_head = nullptr;
+    unsigned* _cq_tail = nullptr;
+    unsigned _cq_mask = 0;
+    io_uring_cqe* _cqes = nullptr;
+};
+
+// Состояние чтения одного файла: openat + statx -> read (возможно, несколькими частями) -> close
+struct FileRead {
+    size_t path_index = 0;
+    int fd = -1;
+    struct statx stx {};
+    std::string data;
+    size_t done = 0;
+    int pending_meta = 0;
+    bool failed = false;
+};
+
+enum Operation : uint64_t { OP_OPEN = 0, OP_STATX = 1, OP_READ = 2, OP_CLOSE = 3 };
+
+uint64_t make_user_data(size_t slot, Operation op) {
+    return ((uint64_t)slot << 2) | op;
+}
+
+// Одна операция READ в io_uring ограничена 32-битной длиной
+constexpr size_t MAX_READ_CHUNK = 1u << 30;
+
+enum class RingResult {
+    Done,
+    Unsupported, // ядро отвергло io_uring_enter до первой операции - можно читать другим способом
+    Failed
+};
+
+RingResult run_ring(Ring& ring, const std::vector<std::string>& paths, const UringLoader::LoadedCallback& on_loaded) {
+    // На каждый файл одновременно приходится не больше двух операций (openat + statx)
+    const size_t max_files = std::max(1u, ring.capacity() / 2);
+    std::vector<FileRead> slots(max_files);
+    std::vector<size_t> free_slots;
+    for (size_t i = max_files; i > 0; --i) {
+        free_slots.push_back(i - 1);
+    }
+
+    size_t next_path = 0;
+    size_t finished = 0;
+    size_t inflight = 0;
+    bool submitted = false;
+    std::vector<size_t> deferred_reads; // чтения, которым не хватило места в очереди отправки
+
+    auto finish = [&](size_t slot) {
+        FileRead& file = slots[slot];
+        if (file.fd >= 0) {
+            // Закрытие тоже асинхронное, его завершение просто игнорируется
+            io_uring_sqe* sqe = ring.get_sqe();
+            if (sqe != nullptr) {
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = file.fd;
+                sqe->user_data = make_user_data(slot, OP_CLOSE);
+                ++inflight;
+            } else {
+                close(file.fd);
+            }
+        }
+        if (file.failed) {
+            on_loaded(file.path_index, DocumentBuffer());
+        } else {
+            file.data.resize(file.done);
+            on_loaded(file.path_index, DocumentBuffer::FromString(std::move(file.data)));
+        }
+        file = FileRead();
+        free_slots.push_back(slot);
+        ++finished;
+    };
+
+    auto submit_read = [&](size_t slot) {
+        FileRead& file = slots[slot];
+        io_uring_sqe* sqe = ring.get_sqe();
+        if (sqe == nullptr) {
+            deferred_reads.push_back(slot);
+            return;
+        }
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = file.fd;
+        sqe->addr = (uint64_t)(file.data.data() + file.done);
+        sqe->len = (unsigned)std::min(file.data.size() - file.done, MAX_READ_CHUNK);
+        sqe->off = file.done;
+        sqe->user_data = make_user_data(slot, OP_READ);
+        ++inflight;
+    };
+
+    while (finished < paths.size()) {
+        // 1. Сначала отложенные чтения, затем новые файлы, пока есть место в кольце
+        std::vector<size_t> reads;
+        reads.swap(deferred_reads);
+        for (size_t slot : reads) {
+            submit_read(slot);
+        }
+        while (next_path < paths.size() && !free_slots.empty() && deferred_reads.empty()
+               && inflight + 2 <= ring.capacity() && ring.sq_space() >= 2) {
+            const size_t slot = free_slots.back();
+            free_slots.pop_back();
+            FileRead& file = slots[slot];
+            file.path_index = next_path;
+            file.pending_meta = 2;
+            const char* path = paths[next_path].c_str();
+            ++next_path;
+
+            io_uring_sqe* open_sqe = ring.get_sqe();
+            open_sqe->opcode = IORING_OP_OPENAT;
+            open_sqe->fd = AT_FDCWD;
+            open_sqe->addr = (uint64_t)path;
+            open_sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            open_sqe->user_data = make_user_data(slot, OP_OPEN);
+
+            io_uring_sqe* statx_sqe = ring.get_sqe();
+            statx_sqe->opcode = IORING_OP_STATX;
+            statx_sqe->fd = AT_FDCWD;
+            statx_sqe->addr = (uint64_t)path;
+            statx_sqe->len = STATX_SIZE;
+            statx_sqe->off = (uint64_t)&file.stx;
+            statx_sqe->user_data = make_user_data(slot, OP_STATX);
+            inflight += 2;
+        }
+
+        // 2. Отправляем всё накопленное и ждём хотя бы одно завершение
+        if (const int error = ring.submit_and_wait(1); error != 0) {
+            return !submitted && (error == EINVAL || error == ENOSYS || error == EPERM)
+                   ? RingResult::Unsupported : RingResult::Failed;
+        }
+        submitted = true;
+
+        // 3. Продвигаем файлы по их завершениям. Каждое завершение порождает не больше одной операции
+        ring.for_each_completion([&](uint64_t user_data, int res) {
+            --inflight;
+            const size_t slot = user_data >> 2;
+            const auto op = (Operation)(user_data & 3);
+            if (op == OP_CLOSE) {
+                return;
+            }
+            FileRead& file = slots[slot];
+
+            if (op == OP_OPEN || op == OP_STATX) {
+                if (res < 0) {
+                    file.failed = true;
+                } else if (op == OP_OPEN) {
+                    file.fd = res;
+                }
+                if (--file.pending_meta > 0) {
+                    return;
+                }
+                if (file.failed || file.stx.stx_size == 0) {
+                    finish(slot);
+                    return;
+                }
+                file.data.resize(file.stx.stx_size);
+                submit_read(slot);
+                return;
+            }
+
+            // OP_READ
+            if (res < 0) {
+                file.failed = true;
+                finish(slot);
+            } else if (res == 0 || file.done + res == file.data.size()) {
+                file.done += res;
+                finish(slot);
+            } else {
+                file.done += res; // короткое чтение - дочитываем остаток
+                submit_read(slot);
+            }
+        });
+    }
+
+    // Дожидаемся асинхронных close, чтобы не оставить дескрипторы открытыми
+    while (inflight > 0) {
+        if (ring.submit_and_wait(1) != 0) {
+            return RingResult::Failed;
+        }
+        ring.for_each_completion([&](uint64_t, int) { --inflight; });
+    }
+    return RingResult::Done;
+}
+
+} // namespace
+#endif
+
+bool UringLoader::IsAvailable() {
+#ifdef SEARCH_ENGINE_IO_URING
+    Ring ring(2);
+    return ring.is_ready();
+#else
+    return false;
+#endif
+}
+
+void UringLoader::LoadDocuments(const std::vector<std::string>& paths, const LoadedCallback& on_loaded,
+                                unsigned queue_depth, size_t fallback_threads) {
+#ifdef SEARCH_ENGINE_IO_URING
+    Ring ring(std::max(2u, queue_depth));
+    if (ring.is_ready()) {
+        const RingResult result = run_ring(ring, paths, on_loaded);
+        if (result == RingResult::Done) {
+            return;
+        }
+        // Сбой io_enter посреди работы не ожидается; дальше безопаснее не продолжать
+        if (result == RingResult::Failed) {
+            throw std::runtime_error("io_uring submission failed");
+        }
+    }
+#endif
+    // Запасной путь: пул потоков с mmap/pread
+    std::cout << "io_uring is unavailable, loading documents with the thread pool." << std::endl;
+    std::mutex callback_mutex;
+    ParallelFor(paths.size(), fallback_threads, [&](size_t i) {
+        DocumentBuffer buffer = DocumentBuffer::FromFile(paths[i]);
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        on_loaded(i, std::move(buffer));
+    });
+}
+
+std::vector<DocumentBuffer> UringLoader::LoadDocuments(const std::vector<std::string>& paths,
+                                                       unsigned queue_depth, size_t fallback_threads) {
+    std::vector<DocumentBuffer> loaded(paths.size());
+    LoadDocuments(paths, [&loaded](size_t path_index, DocumentBuffer buffer) {
+        loaded[path_index] = std::move(buffer);
+    }, queue_depth, fallback_threads);
+
+    std::vector<DocumentBuffer> documents;
+    documents.reserve(loaded.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        if (!loaded[i].is_loaded()) {
+            std::cerr << "Warning: File not found at path: " << paths[i]
+                      << ". Skipping this document." << std::endl;
+            continue;
+        }
+        documents.push_back(std::move(loaded[i]));
+    }
+    return documents;
+}
@@ -0,0 +1,42 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_URINGLOADER_H
+#define SEARCH_ENGINE_URINGLOADER_H
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "DocumentLoader.h"
+
+/* Пакетное чтение множества мелких файлов через io_uring (Linux 5.6+).
+ * open, statx, read и close уходят в ядро асинхронно, в полёте держится до queue_depth операций,
+ * так что на файл не тратится ни одного блокирующего системного вызова.
+ * Если io_uring недоступен (другая ОС, старое ядро, запрет seccomp), используется DocumentLoader.
+ */
+class UringLoader {
+public:
+    // Вызывается в потоке загрузчика для каждого файла по мере готовности (порядок произвольный)
+    using LoadedCallback = std::function<void(size_t path_index, DocumentBuffer buffer)>;
+
+    static bool IsAvailable();
+
+    /* Читает paths и передаёт каждый готовый буфер в on_loaded.
+    * Файлы, которые не удалось прочитать, передаются с is_loaded() == false.
+    */
+    static void LoadDocuments(const std::vector<std::string>& paths, const LoadedCallback& on_loaded,
+                              unsigned queue_depth = DEFAULT_QUEUE_DEPTH, size_t fallback_threads = 0);
+
+    // То же, но результат собирается в порядке paths, непрочитанные файлы пропускаются с предупреждением
+    static std::vector<DocumentBuffer> LoadDocuments(const std::vector<std::string>& paths,
+                                                     unsigned queue_depth = DEFAULT_QUEUE_DEPTH,
+                                                     size_t fallback_threads = 0);
+
+    static constexpr unsigned DEFAULT_QUEUE_DEPTH = 256;
+};
+
+#endif //SEARCH_ENGINE_URINGLOADER_H
@@ -0,0 +1,330 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#include "WriteAheadLog.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Тонкие обёртки над файловыми дескрипторами POSIX / CRT
+int wal_open(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#else
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+}
+
+long wal_write(int fd, const char* data, size_t size) {
+#if defined(__unix__) || defined(__APPLE__)
+    return (long)write(fd, data, size);
+#else
+    return _write(fd, data, (unsigned)std::min<size_t>(size, 1u << 30));
+#endif
+}
+
+// 0 - успех
+int wal_sync(int fd) {
+#if defined(__APPLE__)
+    return fcntl(fd, F_FULLFSYNC) == -1 ? -1 : 0;
+#elif defined(__unix__)
+    return fdatasync(fd);
+#else
+    return _commit(fd);
+#endif
+}
+
+void wal_close(int fd) {
+#if defined(__unix__) || defined(__APPLE__)
+    close(fd);
+#else
+    _close(fd);
+#endif
+}
+
+constexpr size_t HEADER_SIZE = sizeof(uint32_t) * 2;
+constexpr size_t FIXED_PAYLOAD_SIZE = sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint64_t);
+// Больше не бывает: длина из оборванного заголовка не должна раздувать буфер чтения
+constexpr size_t MAX_RECORD_SIZE = 1u << 30;
+
+uint32_t crc32(const char* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t {};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+void put(std::vector<char>& out, T value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T get(const char* in) {
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    return value;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& path, uint64_t valid_bytes, uint64_t next_lsn)
+    : _path(path),
+      _next_lsn(next_lsn),
+      _durable_lsn(next_lsn - 1)
+{
+    // Отрезаем оборванный хвост, чтобы новые записи шли сразу за последней целой
+    {
+        std::error_code ec;
+        if (std::filesystem::exists(path, ec) && std::filesystem::file_size(path, ec) > valid_bytes) {
+            std::filesystem::resize_file(path, valid_bytes);
+        }
+    }
+
+    _fd = wal_open(path);
+    if (_fd < 0) {
+        throw std::runtime_error("Cannot open write-ahead log " + path);
+    }
+    _committer = std::thread(&WriteAheadLog::_commit_loop, this);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _pending_cv.notify_all();
+    _committer.join();
+    wal_close(_fd);
+}
+
+uint64_t WriteAheadLog::Append(Operation operation, uint64_t doc_id, std::string_view text) {
+    if (FIXED_PAYLOAD_SIZE + text.size() > MAX_RECORD_SIZE) {
+        throw std::length_error("Write-ahead log record is too large");
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    const uint64_t lsn = _next_lsn++;
+
+    const size_t header_pos = _pending.size();
+    _pending.resize(header_pos + HEADER_SIZE);
+    put(_pending, lsn);
+    put(_pending, (uint8_t)operation);
+    put(_pending, doc_id);
+    _pending.insert(_pending.end(), text.begin(), text.end());
+
+    const auto payload_size = (uint32_t)(_pending.size() - header_pos - HEADER_SIZE);
+    const uint32_t checksum = crc32(_pending.data() + header_pos + HEADER_SIZE, payload_size);
+    std::memcpy(_pending.data() + header_pos, &payload_size, sizeof(payload_size));
+    std::memcpy(_pending.data() + header_pos + sizeof(payload_size), &checksum, sizeof(checksum));
+
+    _pending_cv.notify_one();
+    return lsn;
+}
+
+void WriteAheadLog::WaitDurable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _durable_cv.wait(lock, [&] { return _durable_lsn >= lsn || _stop || !_error.empty(); });
+    if (_durable_lsn >= lsn) {
+        return;
+    }
+    if (!_error.empty()) {
+        throw std::runtime_error(_error);
+    }
+    throw std::runtime_error("Write-ahead log " + _path + " closed before record was written");
+}
+
+void WriteAheadLog::Truncate() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _durable_cv.wait(lock, [&] { return (_pending.empty() && !_writing) || _stop || !_error.empty(); });
+    if (!_error.empty()) {
+        throw std::runtime_error(_error);
+    }
+    std::filesystem::resize_file(_path, 0);
+    _sync();
+}
+
+void WriteAheadLog::SyncPath(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+#if defined(__APPLE__)
+    const int result = fcntl(fd, F_FULLFSYNC) == -1 ? -1 : 0;
+#else
+    const int result = fsync(fd);
+#endif
+    close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Error syncing " + path);
+    }
+#else
+    // Каталог в Windows так не открыть, а переименование и так фиксируется NTFS в журнале
+    if (std::filesystem::is_directory(path)) {
+        return;
+    }
+    const int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    const int result = _commit(fd);
+    _close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Error syncing " + path);
+    }
+#endif
+}
+
+uint64_t WriteAheadLog::LastLsn() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _next_lsn - 1;
+}
+
+void WriteAheadLog::_commit_loop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _pending_cv.wait(lock, [this] { return _stop || !_pending.empty(); });
+        if (_pending.empty()) {
+            return; // _stop и всё записано
+        }
+
+        // Всё, что накопилось, пока шла предыдущая фиксация, уходит одним write + fsync
+        std::vector<char> batch;
+        batch.swap(_pending);
+        const uint64_t batch_lsn = _next_lsn - 1;
+        _writing = true;
+        lock.unlock();
+
+        std::string error;
+        try {
+            _write_all(batch);
+            _sync();
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        lock.lock();
+        _writing = false;
+        if (!error.empty()) {
+            // Что дошло до диска, неизвестно: больше не фиксируем ничего, ждущие получат ошибку
+            _error = std::move(error);
+            _durable_cv.notify_all();
+            return;
+        }
+        _durable_lsn = batch_lsn;
+        _durable_cv.notify_all();
+    }
+}
+
+void WriteAheadLog::_write_all(const std::vector<char>& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        long n = wal_write(_fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+            throw std::runtime_error("Error writing write-ahead log " + _path);
+        }
+        done += (size_t)n;
+    }
+}
+
+void WriteAheadLog::_sync() {
+    if (wal_sync(_fd) != 0) {
+        throw std::runtime_error("Error syncing write-ahead log " + _path);
+    }
+}
+
+WriteAheadLog::ReplayResult WriteAheadLog::Replay(const std::string& path, uint64_t after_lsn,
+                                                  const std::function<void(Record&)>& callback) {
+    ReplayResult result;
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open()) {
+        return result;
+    }
+
+    std::error_code ec;
+    const uint64_t file_size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return result;
+    }
+
+    // Журнал читается крупными блоками; записи разбираются прямо из буфера
+    constexpr size_t CHUNK_SIZE = 4 << 20;
+    std::vector<char> buffer;
+    size_t begin = 0;
+    Record record;
+
+    // Гарантирует, что в буфере есть ещё хотя бы size байт. false - журнал кончился раньше
+    auto ensure = [&](size_t size) {
+        while (buffer.size() - begin < size) {
+            buffer.erase(buffer.begin(), buffer.begin() + (std::ptrdiff_t)begin);
+            begin = 0;
+            const size_t old_size = buffer.size();
+            buffer.resize(old_size + std::max(CHUNK_SIZE, size - old_size));
+            input.read(buffer.data() + old_size, (std::streamsize)(buffer.size() - old_size));
+            buffer.resize(old_size + (size_t)input.gcount());
+            if (input.gcount() == 0) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Неполная запись в конце - след оборванной при сбое дозаписи
+    while (ensure(HEADER_SIZE)) {
+        // Длине из заголовка верим, только если такая запись вообще может быть и умещается в файле
+        const auto payload_size = get<uint32_t>(buffer.data() + begin);
+        if (payload_size > MAX_RECORD_SIZE || result.valid_bytes + HEADER_SIZE + payload_size > file_size ||
+            !ensure(HEADER_SIZE + payload_size)) {
+            break;
+        }
+        const char* header = buffer.data() + begin;
+        const auto checksum = get<uint32_t>(header + sizeof(uint32_t));
+        const char* payload = header + HEADER_SIZE;
+        if (payload_size < FIXED_PAYLOAD_SIZE || crc32(payload, payload_size) != checksum) {
+            break; // повреждённая запись - всё после неё недостоверно
+        }
+
+        record.lsn = get<uint64_t>(payload);
+        record.operation = (Operation)get<uint8_t>(payload + sizeof(uint64_t));
+        record.doc_id = get<uint64_t>(payload + sizeof(uint64_t) + sizeof(uint8_t));
+        record.text.assign(payload + FIXED_PAYLOAD_SIZE, payload_size - FIXED_PAYLOAD_SIZE);
+
+        begin += HEADER_SIZE + payload_size;
+        result.valid_bytes += HEADER_SIZE + payload_size;
+        result.last_lsn = record.lsn;
+        if (record.lsn > after_lsn) {
+            callback(record);
+            ++result.applied;
+        }
+    }
+    return result;
+}
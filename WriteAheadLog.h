@@ -0,0 +1,100 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+
+#ifndef SEARCH_ENGINE_WRITEAHEADLOG_H
+#define SEARCH_ENGINE_WRITEAHEADLOG_H
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/* Журнал упреждающей записи для добавления и удаления документов.
+ * Запись: u32 длина, u32 crc32, затем u64 lsn, u8 операция, u64 doc_id и текст документа.
+ * Append только кладёт запись в буфер; отдельный поток пишет накопленное одним write и одним fsync
+ * (групповая фиксация), а WaitDurable ждёт, пока запись не окажется на диске.
+ * Ошибка записи на диск запоминается: журнал больше ничего не фиксирует, а WaitDurable и Truncate
+ * бросают её всем ждущим.
+ */
+class WriteAheadLog {
+public:
+    enum class Operation : uint8_t {
+        AddDocument = 1,
+        RemoveDocument = 2
+    };
+
+    struct Record {
+        uint64_t lsn = 0;
+        Operation operation = Operation::AddDocument;
+        uint64_t doc_id = 0;
+        std::string text;
+    };
+
+    struct ReplayResult {
+        size_t applied = 0;      // передано в callback (lsn > after_lsn)
+        uint64_t last_lsn = 0;   // последний корректный lsn в журнале
+        uint64_t valid_bytes = 0; // длина журнала без оборванного хвоста
+    };
+
+    /* Открывает журнал на дозапись. Всё после valid_bytes (оборванная при сбое запись) отрезается.
+    * next_lsn - номер следующей записи.
+    */
+    WriteAheadLog(const std::string& path, uint64_t valid_bytes, uint64_t next_lsn);
+
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Возвращает lsn записи. Запись ещё не надёжна - см. WaitDurable.
+    uint64_t Append(Operation operation, uint64_t doc_id, std::string_view text = {});
+
+    /* Ждёт, пока запись lsn не окажется на диске. Бросает std::runtime_error, если запись на диск
+    * не удалась или журнал закрыт раньше, чем запись была зафиксирована.
+    */
+    void WaitDurable(uint64_t lsn);
+
+    // Дожидается записи всего буфера и очищает журнал (после сохранения снимка индекса)
+    void Truncate();
+
+    // Сбрасывает на диск файл или каталог path (для каталога - записи о переименованных в нём файлах)
+    static void SyncPath(const std::string& path);
+
+    uint64_t LastLsn() const;
+
+    /* Последовательно читает журнал и вызывает callback для записей с lsn > after_lsn.
+    * Чтение останавливается на первой повреждённой или неполной записи.
+    */
+    static ReplayResult Replay(const std::string& path, uint64_t after_lsn,
+                               const std::function<void(Record&)>& callback);
+
+private:
+    void _commit_loop();
+
+    void _write_all(const std::vector<char>& data);
+
+    void _sync();
+
+    std::string _path;
+    int _fd = -1;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _pending_cv;
+    std::condition_variable _durable_cv;
+    std::vector<char> _pending;
+    uint64_t _next_lsn;
+    uint64_t _durable_lsn;
+    bool _writing = false;
+    bool _stop = false;
+    std::string _error; // первая ошибка записи; после неё журнал не фиксирует ничего
+    std::thread _committer;
+};
+
+#endif //SEARCH_ENGINE_WRITEAHEADLOG_H
@@ -0,0 +1,788 @@
+//
+// Created by ArtSolo on 19.10.2026.
+//
+// Замеры производительности отдельных стадий движка.
+// Запуск: search_benchmark <название> [параметры], без параметров - список замеров.
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../ConverterJSON.h"
+#include "../DocumentLoader.h"
+#include "../InvertedIndex.h"
+#include "../SearchServer.h"
+#include "../ShardedIndex.h"
+#include "../TermDictionary.h"
+#include "../UringLoader.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Счётчик выделений памяти для замеров search-alloc, index-alloc и dict-memory: глобальный operator new заменён на считающий
+namespace {
+std::atomic<size_t> allocation_count{0};
+std::atomic<size_t> allocation_bytes{0};
+} // namespace
+
+// GCC видит free на указателе из operator new и предупреждает (-Wmismatched-new-delete), не зная, что
+// operator new тоже заменён и выделяет через malloc
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+size_t arg_or(const std::vector<std::string>& args, size_t pos, size_t fallback) {
+    return args.size() > pos ? std::stoull(args[pos]) : fallback;
+}
+
+// requests-parse [кол-во запросов]: разбор requests.json через DOM и через SAX
+int bench_requests_parse(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 1000000);
+    const fs::path path = fs::temp_directory_path() / "bench_requests.json";
+    {
+        std::ofstream out(path);
+        out << "{\"requests\": [";
+        for (size_t i = 0; i < count; ++i) {
+            out << (i ? "," : "") << "\"milk water sugar request number " << i << "\"";
+        }
+        out << "]}";
+    }
+    const double size_mb = (double)fs::file_size(path) / (1024 * 1024);
+    std::cout << "requests.json: " << count << " requests, " << size_mb << " MB" << std::endl;
+
+    auto run = [&](const char* name, auto parse) {
+        std::ifstream in(path);
+        std::vector<std::string> requests;
+        std::string error;
+        auto start = Clock::now();
+        parse(in, requests, error);
+        double ms = elapsed_ms(start);
+        std::cout << "  " << name << ": " << ms << " ms, " << size_mb / (ms / 1000) << " MB/s, "
+                  << requests.size() << " requests" << std::endl;
+    };
+    run("DOM", ConverterJSON::ParseRequestsDom);
+    run("SAX", ConverterJSON::ParseRequestsSax);
+
+    fs::remove(path);
+    return 0;
+}
+
+std::vector<std::string> list_files(const std::string& dir) {
+    std::vector<std::string> paths;
+    for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+        if (entry.is_regular_file()) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    return paths;
+}
+
+/* Просим ядро выбросить страницы файлов из page cache, чтобы получить "холодное" чтение.
+ * Грязные и используемые страницы ядро может оставить, точный сброс требует drop_caches от root.
+ */
+void evict_page_cache(const std::vector<std::string>& paths) {
+#if defined(__linux__)
+    for (const std::string& path : paths) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+#else
+    (void)paths;
+#endif
+}
+
+// load-docs <каталог> [потоков]: ifstream+stringstream по одному файлу против параллельного mmap/pread
+int bench_load_docs(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::cerr << "Usage: search_benchmark load-docs <dir> [threads]" << std::endl;
+        return 1;
+    }
+    const std::vector<std::string> paths = list_files(args[0]);
+    const size_t threads = arg_or(args, 1, 0);
+    size_t total_bytes = 0;
+    for (const std::string& path : paths) {
+        total_bytes += fs::file_size(path);
+    }
+    const double size_mb = (double)total_bytes / (1024 * 1024);
+    std::cout << args[0] << ": " << paths.size() << " files, " << size_mb << " MB" << std::endl;
+
+    auto load_ifstream = [&] {
+        std::vector<std::string> documents;
+        for (const std::string& path : paths) {
+            std::ifstream document_file(path);
+            std::stringstream ss;
+            ss << document_file.rdbuf();
+            documents.push_back(ss.str());
+        }
+        return documents.size();
+    };
+    auto load_parallel = [&] {
+        return DocumentLoader::LoadDocuments(paths, threads).size();
+    };
+
+    auto run = [&](const char* name, bool cold, auto load) {
+        if (cold) {
+            evict_page_cache(paths);
+        }
+        auto start = Clock::now();
+        size_t loaded = load();
+        double ms = elapsed_ms(start);
+        std::cout << "  " << name << (cold ? " (cold): " : " (warm): ") << ms << " ms, "
+                  << size_mb / (ms / 1000) << " MB/s, " << loaded << " files" << std::endl;
+    };
+    run("ifstream", true, load_ifstream);
+    run("ifstream", false, load_ifstream);
+    run("mmap/pread", true, load_parallel);
+    run("mmap/pread", false, load_parallel);
+    return 0;
+}
+
+// uring-load <каталог> [глубина очереди] [потоков]: файлов в секунду у io_uring и у пула потоков
+int bench_uring_load(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::cerr << "Usage: search_benchmark uring-load <dir> [queue_depth] [threads]" << std::endl;
+        return 1;
+    }
+    const std::vector<std::string> paths = list_files(args[0]);
+    const unsigned queue_depth = (unsigned)arg_or(args, 1, UringLoader::DEFAULT_QUEUE_DEPTH);
+    const size_t threads = arg_or(args, 2, 0);
+    std::cout << args[0] << ": " << paths.size() << " files, io_uring "
+              << (UringLoader::IsAvailable() ? "available" : "unavailable (fallback is measured twice)") << std::endl;
+
+    auto run = [&](const char* name, bool cold, auto load) {
+        if (cold) {
+            evict_page_cache(paths);
+        }
+        auto start = Clock::now();
+        size_t loaded = load();
+        double ms = elapsed_ms(start);
+        std::cout << "  " << name << (cold ? " (cold): " : " (warm): ") << ms << " ms, "
+                  << (double)loaded / (ms / 1000) << " files/s" << std::endl;
+    };
+    auto load_pool = [&] { return DocumentLoader::LoadDocuments(paths, threads).size(); };
+    auto load_uring = [&] { return UringLoader::LoadDocuments(paths, queue_depth, threads).size(); };
+    run("thread pool", true, load_pool);
+    run("thread pool", false, load_pool);
+    run("io_uring", true, load_uring);
+    run("io_uring", false, load_uring);
+    return 0;
+}
+
+// wal-replay [кол-во документов] [документов в AddDocuments]: запись журнала и восстановление индекса по нему
+int bench_wal_replay(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 100000);
+    const size_t batch = std::max<size_t>(1, arg_or(args, 1, 100));
+    const fs::path dir = fs::temp_directory_path() / "bench_wal";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const std::string snapshot_path = (dir / "index.bin").string();
+    const std::string wal_path = (dir / "index.wal").string();
+
+    std::vector<std::string> documents;
+    documents.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::ostringstream doc;
+        for (size_t w = 0; w < 50; ++w) {
+            doc << "word" << (i * 31 + w * 7) % 5000 << ' ';
+        }
+        documents.push_back(doc.str());
+    }
+
+    {
+        InvertedIndex index;
+        index.SetSegmentPolicy(count + 1, std::chrono::hours(1), 4);
+        index.OpenStorage(snapshot_path, wal_path);
+        auto start = Clock::now();
+        for (size_t i = 0; i < count; i += batch) {
+            const size_t end = std::min(count, i + batch);
+            index.AddDocuments(std::vector<std::string>(documents.begin() + (std::ptrdiff_t)i,
+                                                        documents.begin() + (std::ptrdiff_t)end));
+        }
+        double ms = elapsed_ms(start);
+        std::cout << "append (" << batch << " docs per commit): " << ms << " ms, "
+                  << (double)count / (ms / 1000) << " docs/s, log " << fs::file_size(wal_path) / (1024 * 1024)
+                  << " MB" << std::endl;
+    }
+
+    {
+        InvertedIndex index;
+        auto start = Clock::now();
+        size_t replayed = index.OpenStorage(snapshot_path, wal_path);
+        double ms = elapsed_ms(start);
+        std::cout << "replay: " << ms << " ms, " << (double)replayed / (ms / 1000) << " docs/s" << std::endl;
+    }
+
+    {
+        InvertedIndex index;
+        auto start = Clock::now();
+        index.UpdateDocumentBase(documents);
+        double ms = elapsed_ms(start);
+        std::cout << "full rebuild from memory: " << ms << " ms, " << (double)count / (ms / 1000) << " docs/s"
+                  << std::endl;
+    }
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+// fuzzy-expand [кол-во слов] [кол-во запросов]: нечёткое раскрытие слов с опечатками по большому словарю
+int bench_fuzzy_expand(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 2000000);
+    const size_t queries_count = arg_or(args, 1, 200);
+    std::mt19937 rng(42);
+
+    std::set<std::string> words;
+    while (words.size() < count) {
+        std::string word;
+        for (size_t len = 4 + rng() % 9; len > 0; --len) {
+            word += (char)('a' + rng() % 26);
+        }
+        words.insert(std::move(word));
+    }
+    const std::vector<std::string_view> sorted(words.begin(), words.end());
+    auto start = Clock::now();
+    TermDictionary dictionary(sorted);
+    std::cout << count << " terms, build " << elapsed_ms(start) << " ms, "
+              << dictionary.memory_usage() / (1024 * 1024) << " MB front-coded" << std::endl;
+
+    // Запросы - слова словаря с одной случайной опечаткой
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < queries_count; ++i) {
+        std::string word(sorted[rng() % sorted.size()]);
+        word[1 + rng() % (word.size() - 1)] = (char)('a' + rng() % 26);
+        queries.push_back(std::move(word));
+    }
+
+    for (const char* suffix : {"~1", "~2"}) {
+        size_t expansions = 0;
+        start = Clock::now();
+        for (const std::string& query : queries) {
+            TermDictionary::FuzzyQuery fuzzy;
+            const std::string text = query + suffix;
+            TermDictionary::ParseFuzzy(text, fuzzy);
+            expansions += dictionary.ExpandFuzzy(fuzzy.word, fuzzy.max_distance, fuzzy.prefix_length, 128).size();
+        }
+        const double ms = elapsed_ms(start);
+        std::cout << "  " << suffix << ": " << ms / (double)queries.size() << " ms per query, "
+                  << (double)expansions / (double)queries.size() << " terms per query" << std::endl;
+    }
+    return 0;
+}
+
+// stem-index [каталог]: размер словаря и скорость индексации без выделения основ и с ним.
+// Без каталога индексируется синтетический корпус из словоформ русских и английских слов.
+int bench_stem_index(const std::vector<std::string>& args) {
+    std::vector<DocumentBuffer> source;
+    if (!args.empty()) {
+        source = DocumentLoader::LoadDocuments(list_files(args[0]));
+    } else {
+        // Основы из слогов: ка-ро-н, ми-ту-л, ...
+        const std::vector<std::string> syllables = {"ка", "ро", "ми", "ту", "ле", "на", "во", "ди"};
+        const std::vector<std::string> finals = {"р", "н", "л", "к", "т"};
+        std::vector<std::string> ru_stems;
+        for (const std::string& a : syllables) {
+            for (const std::string& b : syllables) {
+                for (const std::string& c : finals) {
+                    ru_stems.push_back(a + b + c);
+                }
+            }
+        }
+        const std::vector<std::string> ru_endings = {"", "а", "у", "ом", "е", "ы", "ов", "ам", "ами", "ах",
+                                                     "ой", "ою", "и", "ей", "ям", "ями"};
+        const std::vector<std::string> en_words = {"run", "running", "runs", "city", "cities", "connect",
+                                                   "connected", "connection", "connections", "national",
+                                                   "nationally", "nations", "hope", "hoped", "hoping", "hopes"};
+        std::mt19937 rng(5);
+        for (size_t d = 0; d < 20000; ++d) {
+            std::string text;
+            for (size_t w = 0; w < 100; ++w) {
+                if (rng() % 2) {
+                    text += ru_stems[rng() % ru_stems.size()] + ru_endings[rng() % ru_endings.size()];
+                } else {
+                    text += en_words[rng() % en_words.size()];
+                }
+                text += ' ';
+            }
+            source.push_back(DocumentBuffer::FromString(std::move(text)));
+        }
+    }
+    std::cout << source.size() << " documents" << std::endl;
+
+    for (bool stemming : {false, true}) {
+        std::vector<DocumentBuffer> docs;
+        for (const DocumentBuffer& doc : source) {
+            docs.push_back(DocumentBuffer::FromString(std::string(doc.view())));
+        }
+        InvertedIndex index;
+        index.SetStemming(stemming);
+        auto start = Clock::now();
+        index.UpdateDocumentBase(std::move(docs));
+        double ms = elapsed_ms(start);
+        std::cout << (stemming ? "  stemming: " : "  plain:    ") << index.GetFrequencyDictionary().size()
+                  << " unique words, " << ms << " ms, " << (double)source.size() / (ms / 1000) << " docs/s"
+                  << std::endl;
+    }
+    return 0;
+}
+
+// dense-search [кол-во документов] [повторов]: запросы из частых слов, которые есть в большинстве документов
+int bench_dense_search(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 200000);
+    const size_t repeats = arg_or(args, 1, 20);
+    std::mt19937 rng(9);
+
+    // Доля документов со словом: the - 90%, and - 70%, is - 50%, of - 30%, rare - 1%
+    const std::vector<std::pair<std::string, unsigned>> words = {
+        {"the", 90}, {"and", 70}, {"is", 50}, {"of", 30}, {"rare", 1}};
+    std::vector<std::string> docs;
+    docs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string text = "doc";
+        for (const auto& [word, percent] : words) {
+            if (rng() % 100 < percent) {
+                text += ' ' + word;
+            }
+        }
+        docs.push_back(std::move(text));
+    }
+    InvertedIndex index;
+    index.UpdateDocumentBase(docs);
+    SearchServer server(index);
+
+    for (const char* query : {"the and", "the and is of", "rare the and"}) {
+        size_t found = 0;
+        auto start = Clock::now();
+        for (size_t r = 0; r < repeats; ++r) {
+            found = server.search_one(query).size();
+        }
+        std::cout << "  \"" << query << "\": " << elapsed_ms(start) / (double)repeats << " ms, "
+                  << found << " documents" << std::endl;
+    }
+    return 0;
+}
+
+// query-plan [кол-во документов] [повторов]: запросы разной избирательности, в том числе булевы, и их планы (explain)
+int bench_query_plan(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 200000);
+    const size_t repeats = arg_or(args, 1, 20);
+    std::mt19937 rng(11);
+
+    // Доля документов со словом в промилле: от почти всех до единиц
+    const std::vector<std::pair<std::string, unsigned>> words = {
+        {"the", 900}, {"and", 600}, {"city", 100}, {"river", 20}, {"bridge", 2}};
+    std::vector<std::string> docs;
+    docs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string text = "doc";
+        for (const auto& [word, permille] : words) {
+            if (rng() % 1000 < permille) {
+                text += ' ' + word;
+            }
+        }
+        docs.push_back(std::move(text));
+    }
+    InvertedIndex index;
+    index.UpdateDocumentBase(docs);
+    SearchServer server(index);
+
+    for (const char* query : {"the and", "bridge the", "river city the", "city and", "the missing ri*",
+                              "bridge OR river", "city AND NOT the", "(bridge OR river) AND NOT (and OR city)"}) {
+        size_t found = 0;
+        auto start = Clock::now();
+        for (size_t r = 0; r < repeats; ++r) {
+            found = server.search_one(query).size();
+        }
+        std::cout << "  \"" << query << "\": " << elapsed_ms(start) / (double)repeats << " ms, "
+                  << found << " documents" << std::endl << server.explain(query);
+    }
+    return 0;
+}
+
+// search-alloc [кол-во документов] [повторов]: выделений памяти на запрос после прогрева
+int bench_search_alloc(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 200000);
+    const size_t repeats = arg_or(args, 1, 100);
+    std::mt19937 rng(13);
+
+    const std::vector<std::pair<std::string, unsigned>> words = {
+        {"the", 900}, {"and", 600}, {"city", 100}, {"river", 20}, {"bridge", 2}};
+    std::vector<std::string> docs;
+    docs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string text = "doc";
+        for (const auto& [word, permille] : words) {
+            if (rng() % 1000 < permille) {
+                text += ' ' + word;
+            }
+        }
+        docs.push_back(std::move(text));
+    }
+    InvertedIndex index;
+    index.UpdateDocumentBase(docs);
+    SearchServer server(index);
+
+    for (const char* query : {"bridge the", "river city the", "city and", "the and", "the missing"}) {
+        size_t found = server.search_one(query).size(); // прогрев буферов потока
+        const size_t before = allocation_count.load();
+        auto start = Clock::now();
+        for (size_t r = 0; r < repeats; ++r) {
+            found = server.search_one(query).size();
+        }
+        const double ms = elapsed_ms(start) / (double)repeats;
+        std::cout << "  \"" << query << "\": " << (double)(allocation_count.load() - before) / (double)repeats
+                  << " allocations/query, " << ms << " ms, " << found << " documents" << std::endl;
+    }
+    return 0;
+}
+
+// index-alloc [кол-во документов] [слов в документе]: выделений памяти на документ при индексации
+int bench_index_alloc(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 20000);
+    const size_t words_per_doc = arg_or(args, 1, 200);
+    std::mt19937 rng(17);
+
+    // Словарь со словами разной длины, в том числе длиннее буфера короткой строки
+    std::vector<std::string> vocabulary;
+    for (size_t i = 0; i < 5000; ++i) {
+        vocabulary.push_back("w" + std::to_string(i) + std::string(rng() % 20, 'x'));
+    }
+    std::vector<std::string> docs;
+    docs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string text;
+        for (size_t w = 0; w < words_per_doc; ++w) {
+            text += vocabulary[rng() % vocabulary.size()] + ' ';
+        }
+        docs.push_back(std::move(text));
+    }
+
+    std::vector<size_t> thread_counts = {1};
+    if (std::thread::hardware_concurrency() > 1) {
+        thread_counts.push_back(std::thread::hardware_concurrency());
+    }
+    for (size_t threads : thread_counts) {
+        InvertedIndex index;
+        index.SetIndexingThreads(threads);
+        const size_t before = allocation_count.load();
+        auto start = Clock::now();
+        index.UpdateDocumentBase(docs);
+        const double ms = elapsed_ms(start);
+        std::cout << "  " << threads << " thread(s): " << (double)(allocation_count.load() - before) / (double)count
+                  << " allocations/document, " << ms << " ms" << std::endl;
+    }
+    return 0;
+}
+
+// dict-memory [кол-во слов]: память словаря на слово - общий массив байт против std::map со строкой на слово
+int bench_dict_memory(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 1000000);
+    std::mt19937 rng(19);
+
+    // Слова длиной 4-20 байт, по 50 слов в документе
+    std::vector<std::string> docs;
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        std::string word = "t" + std::to_string(i);
+        while (word.size() < 4 + rng() % 17) {
+            word += (char)('a' + rng() % 26);
+        }
+        text += word + ' ';
+        if ((i + 1) % 50 == 0 || i + 1 == count) {
+            docs.push_back(std::move(text));
+            text.clear();
+        }
+    }
+    InvertedIndex index;
+    index.UpdateDocumentBase(docs);
+
+    const IndexSegment::MemoryUsage usage = index.GetMemoryUsage();
+    const auto per_term = [&](size_t bytes) { return (double)bytes / (double)usage.terms; };
+    std::cout << "  terms: " << usage.terms << ", bytes per term:" << std::endl
+              << "    term bytes:         " << per_term(usage.term_bytes) << std::endl
+              << "    term slots:         " << per_term(usage.term_slots) << std::endl
+              << "    dictionary total:   " << usage.dictionary_bytes_per_term() << std::endl
+              << "    postings:           " << per_term(usage.postings) << std::endl
+              << "    pattern dictionary: " << per_term(usage.pattern_dictionary) << std::endl;
+
+    // Тот же словарь в виде std::map<std::string, std::vector<Entry>>: узел и строка на каждое слово
+    const auto dictionary = index.GetFrequencyDictionary();
+    const size_t before = allocation_bytes.load();
+    {
+        std::map<std::string, std::vector<Entry>> map;
+        for (const auto& pair : dictionary) {
+            map.emplace(pair.first, std::vector<Entry>());
+        }
+        std::cout << "    std::map keys:      " << (double)(allocation_bytes.load() - before) / (double)map.size()
+                  << " (node + string, heap only)" << std::endl;
+    }
+    return 0;
+}
+
+// frozen-lookup [кол-во слов]: поиск слова в сегменте - двоичный поиск против совершенного хеша после Freeze
+int bench_frozen_lookup(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 1000000);
+    std::mt19937 rng(43);
+
+    std::vector<std::string> words;
+    std::vector<std::string> docs;
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        std::string word = "t" + std::to_string(rng());
+        text += word + ' ';
+        words.push_back(std::move(word));
+        if ((i + 1) % 50 == 0 || i + 1 == count) {
+            docs.push_back(std::move(text));
+            text.clear();
+        }
+    }
+    // Половина запросов - отсутствующие слова
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < 1000000; ++i) {
+        queries.push_back(i % 2 == 0 ? words[rng() % words.size()] : "x" + std::to_string(rng()));
+    }
+
+    InvertedIndex index;
+    index.UpdateDocumentBase(docs);
+    for (bool frozen : {false, true}) {
+        if (frozen) {
+            index.Freeze();
+        }
+        const IndexSegment& segment = *index.GetSnapshot()->segments.front();
+        size_t found = 0;
+        auto start = Clock::now();
+        for (const std::string& query : queries) {
+            found += segment.postings(query).size();
+        }
+        const double ms = elapsed_ms(start);
+        const IndexSegment::MemoryUsage usage = segment.memory_usage();
+        std::cout << "  " << (frozen ? "perfect hash: " : "binary search:") << " "
+                  << ms * 1e6 / (double)queries.size() << " ns/lookup, hash "
+                  << (double)usage.hash * 8 / (double)usage.terms << " bits/term (found " << found << ")" << std::endl;
+    }
+    return 0;
+}
+
+// skewed-index [МБ большого документа] [кол-во мелких документов]: индексация смеси 1 КБ страниц и одного большого файла
+int bench_skewed_index(const std::vector<std::string>& args) {
+    const size_t huge_mb = arg_or(args, 0, 64);
+    const size_t small = arg_or(args, 1, 20000);
+    std::mt19937 rng(45);
+
+    auto random_text = [&](size_t bytes) {
+        std::string text;
+        text.reserve(bytes + 16);
+        while (text.size() < bytes) {
+            text += "w" + std::to_string(rng() % 50000) + ' ';
+        }
+        return text;
+    };
+    std::vector<std::string> docs;
+    for (size_t i = 0; i < small; ++i) {
+        docs.push_back(random_text(1024));
+    }
+    docs.insert(docs.begin() + (std::ptrdiff_t)(small / 2), random_text(huge_mb * 1024 * 1024));
+
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    InvertedIndex index;
+    index.SetIndexingThreads(threads);
+    auto start = Clock::now();
+    index.UpdateDocumentBase(docs);
+    std::cout << "  " << threads << " thread(s): " << elapsed_ms(start) << " ms for " << small << " x 1 KB + "
+              << huge_mb << " MB" << std::endl;
+    return 0;
+}
+
+// ranking [кол-во документов]: время запроса для каждой формулы релевантности (count, tfidf, bm25, impact)
+int bench_ranking(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 200000);
+    std::mt19937 rng(47);
+    const std::vector<std::string> vocabulary = {"the", "and", "city", "river", "bridge", "tower", "park", "museum"};
+
+    std::vector<std::string> docs;
+    docs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string text;
+        for (size_t w = 0; w < 20; ++w) {
+            // Частота слова убывает с его номером
+            text += vocabulary[std::min<size_t>(vocabulary.size() - 1, std::countr_zero(rng() | 0x80u))] + ' ';
+        }
+        docs.push_back(std::move(text));
+    }
+    InvertedIndex index;
+    index.SetImpactQuantization(8);
+    index.UpdateDocumentBase(docs);
+    SearchServer server(index);
+    std::cout << "  impacts: " << index.GetMemoryUsage().impacts / 1024 << " KB" << std::endl;
+
+    const std::vector<std::string> queries = {"the and", "city river", "bridge tower park", "museum the"};
+    for (Ranking ranking : {Ranking::Count, Ranking::TfIdf, Ranking::Bm25, Ranking::Impact}) {
+        server.SetRanking(ranking);
+        size_t found = 0;
+        auto start = Clock::now();
+        for (size_t r = 0; r < 10; ++r) {
+            for (const std::string& query : queries) {
+                found += server.search_one(query).size();
+            }
+        }
+        const char* names[] = {"count", "tfidf", "bm25", "impact"};
+        std::cout << "  " << names[(int)ranking] << ": " << elapsed_ms(start) / (10.0 * (double)queries.size())
+                  << " ms/query (" << found / 10 << " results)" << std::endl;
+    }
+    return 0;
+}
+
+// query-threads [кол-во документов]: задержка тяжёлого запроса (частые слова) при 1, 2, 4 и 8 потоках на запрос
+int bench_query_threads(const std::vector<std::string>& args) {
+    const size_t count = arg_or(args, 0, 1000000);
+    std::mt19937 rng(49);
+    std::vector<std::string> docs;
+    docs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string text = "the";
+        for (size_t w = 0; w < 8; ++w) {
+            text += rng() % 2 ? " and" : " of";
+        }
+        docs.push_back(std::move(text));
+    }
+    InvertedIndex index;
+    index.UpdateDocumentBase(docs);
+    SearchServer server(index);
+    server.SetResultsLimit(5);
+
+    const std::vector<std::string> queries = {"the and", "the of", "and of"};
+    for (size_t threads : {1, 2, 4, 8}) {
+        server.SetQueryThreads(threads);
+        std::vector<double> latencies;
+        for (size_t r = 0; r < 10; ++r) {
+            for (const std::string& query : queries) {
+                auto start = Clock::now();
+                server.search_one(query);
+                latencies.push_back(elapsed_ms(start));
+            }
+        }
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "  " << threads << " threads: p50 " << latencies[latencies.size() / 2] << " ms, max "
+                  << latencies.back() << " ms" << std::endl;
+    }
+    return 0;
+}
+
+// sharded [кол-во шардов] [кол-во документов]: сборка и запросы одного индекса против шардированного
+int bench_sharded(const std::vector<std::string>& args) {
+    const size_t shards = arg_or(args, 0, 4);
+    const size_t count = arg_or(args, 1, 200000);
+    std::mt19937 rng(50);
+    const std::vector<std::string> vocabulary = {"the", "and", "city", "river", "bridge", "tower", "park", "museum"};
+    std::vector<std::string> docs;
+    docs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string text;
+        for (size_t w = 0; w < 20; ++w) {
+            text += vocabulary[std::min<size_t>(vocabulary.size() - 1, std::countr_zero(rng() | 0x80u))] + ' ';
+        }
+        docs.push_back(std::move(text));
+    }
+    const std::vector<std::string> queries = {"the and", "city river", "bridge tower park", "museum the"};
+
+    auto run = [&](const char* name, auto& index) {
+        auto start = Clock::now();
+        index.UpdateDocumentBase(docs);
+        const double build_ms = elapsed_ms(start);
+        SearchServer server(index);
+        server.SetRanking(Ranking::Bm25);
+        server.SetResultsLimit(5);
+        start = Clock::now();
+        for (size_t r = 0; r < 10; ++r) {
+            for (const std::string& query : queries) {
+                server.search_one(query);
+            }
+        }
+        std::cout << "  " << name << ": build " << build_ms << " ms, query "
+                  << elapsed_ms(start) / (10.0 * (double)queries.size()) << " ms" << std::endl;
+    };
+    InvertedIndex single;
+    run("1 index", single);
+    ShardedIndex sharded(shards);
+    run((std::to_string(shards) + " shards").c_str(), sharded);
+    return 0;
+}
+
+const std::map<std::string, std::function<int(const std::vector<std::string>&)>> benchmarks = {
+    {"requests-parse", bench_requests_parse},
+    {"load-docs", bench_load_docs},
+    {"uring-load", bench_uring_load},
+    {"wal-replay", bench_wal_replay},
+    {"fuzzy-expand", bench_fuzzy_expand},
+    {"stem-index", bench_stem_index},
+    {"dense-search", bench_dense_search},
+    {"query-plan", bench_query_plan},
+    {"search-alloc", bench_search_alloc},
+    {"index-alloc", bench_index_alloc},
+    {"dict-memory", bench_dict_memory},
+    {"frozen-lookup", bench_frozen_lookup},
+    {"skewed-index", bench_skewed_index},
+    {"ranking", bench_ranking},
+    {"query-threads", bench_query_threads},
+    {"sharded", bench_sharded},
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || !benchmarks.count(argv[1])) {
+        std::cout << "Usage: search_benchmark <name> [args]" << std::endl;
+        for (const auto& pair : benchmarks) {
+            std::cout << "  " << pair.first << std::endl;
+        }
+        return argc < 2 ? 0 : 1;
+    }
+    return benchmarks.at(argv[1])(std::vector<std::string>(argv + 2, argv + argc));
+}
@@ -3,15 +3,26 @@
 #include <filesystem>
 #include <vector>
 #include <random>
+#include <csignal>
 #include <ctime>
+#include <stop_token>
+#include <thread>
 #include "ConverterJSON.h"
 #include "InvertedIndex.h"
 #include "SearchServer.h"
+#include "ShardedIndex.h"
 #include "gtest/gtest.h"
 namespace fs = std::filesystem;
 
 extern void TestWord(InvertedIndex& index, const std::string& word);
 
+namespace {
+
+// Флаг Ctrl+C: из обработчика сигнала можно только записать volatile sig_atomic_t
+volatile std::sig_atomic_t interrupted = 0;
+
+} // namespace
+
 //функция для форматирования текст
 void PrintIndex(const std::map<std::string, std::vector<Entry>>& index) {
     std::cout << "\n--- Inverted Index Content ---" << std::endl;
@@ -67,7 +78,7 @@ void setup_test_environment() {
     std::ofstream("requests.json") << std::setw(4) << requests_content;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     setlocale(LC_ALL, "RUS"); // Clion не дружит с локалями, так что вывод в основном на английском
     srand(unsigned(time(NULL)));
 
@@ -138,24 +149,81 @@ int main() {
 
     try {
         // 1. Инициализация и загрузка конфигурации
-        ConverterJSON converter;
-        std::vector<std::string> docs_content = converter.GetTextDocuments();
-        std::vector<std::string> requests = converter.GetRequests();
+        // Необязательный аргумент - путь к запросам (requests.json или потоковый *.jsonl)
+        const std::string requests_path = argc > 1 ? argv[1] : "requests.json";
+        const bool stream_mode = fs::path(requests_path).extension() == ".jsonl";
+        ConverterJSON converter("config.json", requests_path, stream_mode ? "answers.jsonl" : "answers.json");
+        std::vector<DocumentBuffer> docs_content = converter.LoadTextDocuments();
+
+        // 2. Индексация документов: один индекс или несколько шардов ("index_shards")
+        auto configure = [&](auto& target) {
+            target.SetIndexingThreads(converter.GetIndexingThreads());
+            target.SetMemoryBudget(converter.GetIndexMemoryBudget());
+            target.SetMaxExpansions(converter.GetMaxTermExpansions());
+            target.SetStemming(converter.GetStemming());
+            target.SetImpactQuantization(converter.GetImpactBits());
+            target.SetProgressCallback([](const IndexingProgress& progress) {
+                if (!progress.finished) {
+                    std::cout << "Indexed " << progress.docs_done << "/" << progress.docs_total << " documents, "
+                              << progress.bytes_per_second() / (1024 * 1024) << " MB/s";
+                    // Пока скорость неизвестна, оценку не печатаем
+                    if (progress.eta_seconds() >= 0) {
+                        std::cout << ", ETA " << progress.eta_seconds() << " s";
+                    }
+                    std::cout << std::endl;
+                }
+            });
+        };
+
+        // Ctrl+C во время индексации отменяет сборку; обработчик сигнала только ставит флаг,
+        // а stop_source дёргает отдельный поток
+        std::stop_source indexing_stop;
+        std::signal(SIGINT, [](int) { interrupted = 1; });
+        std::jthread interrupt_watcher([&indexing_stop](std::stop_token watcher_stop) {
+            while (!watcher_stop.stop_requested() && !interrupted) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+            if (interrupted) {
+                indexing_stop.request_stop();
+            }
+        });
 
-        // 2. Индексация документов
         InvertedIndex index;
-        index.UpdateDocumentBase(docs_content); // Запустит многопоточную индексацию
+        std::unique_ptr<ShardedIndex> sharded;
+        if (converter.GetIndexShards() != 1) {
+            sharded = std::make_unique<ShardedIndex>(converter.GetIndexShards());
+            configure(*sharded);
+            sharded->UpdateDocumentBase(std::move(docs_content), indexing_stop.get_token()); // Шарды строятся параллельно
+        } else {
+            configure(index);
+            index.UpdateDocumentBase(std::move(docs_content), indexing_stop.get_token()); // Запустит многопоточную индексацию
+        }
+        interrupt_watcher.request_stop();
+        std::signal(SIGINT, SIG_DFL);
 
         // 3. Создание SearchServer
         std::cout << "\n--- ПОИСК ЗАПРОСОВ ---" << std::endl;
-        SearchServer server(index);
-
-        // 4. Запуск поиска
-        std::vector<std::vector<RelativeIndex>> answers = server.search(requests);
-
-        // 5. Запись результатов в answers.json
-        converter.putAnswers(answers);
+        SearchServer server = sharded ? SearchServer(*sharded) : SearchServer(index);
+        server.SetFuzzyFallback(converter.GetFuzzySearch());
+        server.SetRanking(ParseRanking(converter.GetRanking()));
+        server.SetQueryThreads(converter.GetQueryThreads());
+        server.SetResultsLimit((size_t)std::max(converter.GetResponsesLimit(), 0));
+
+        if (converter.IsRequestStream()) {
+            // 4-5. Запросы читаются, ищутся и записываются конвейером
+            converter.StreamAnswers(server);
+        } else {
+            // 4. Запуск поиска
+            std::vector<std::string> requests = converter.GetRequests();
+            std::vector<std::vector<RelativeIndex>> answers = server.search(requests);
+
+            // 5. Запись результатов в answers.json
+            converter.putAnswers(answers);
+        }
 
+    } catch (const IndexingCancelled&) {
+        std::cerr << "\nИндексация отменена (Ctrl+C)." << std::endl;
+        return 130;
     } catch (const std::exception& e) {
         std::cerr << "\n--- КРИТИЧЕСКАЯ ОШИБКА ---" << std::endl;
         std::cerr << "Ошибка: " << e.what() << std::endl;
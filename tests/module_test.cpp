@@ -3,11 +3,21 @@
 #include <filesystem>
 #include <vector>
 #include <random>
+#include <set>
 #include <ctime>
 #include "gtest/gtest.h"
 
+#include "..\IndexRuns.h"
 #include "..\InvertedIndex.h"
+#include "..\PerfectHash.h"
+#include "..\QueryParser.h"
+#include "..\RoaringBitmap.h"
 #include "..\SearchServer.h"
+#include "..\ShardedIndex.h"
+#include "..\Stemmer.h"
+#include "..\TermDictionary.h"
+#include "..\ThreadPool.h"
+#include "..\UringLoader.h"
 
 struct RelativeIndex;
 using namespace std;
@@ -164,4 +174,1315 @@ TEST(TestCaseSearchServer, TestTop5) {
     SearchServer srv(idx);
     std::vector<vector<RelativeIndex>> result = srv.search(request);
     ASSERT_EQ(result, expected);
-}
\ No newline at end of file
+}
+
+TEST(TestCaseConverterJSON, TestStreamAnswers) {
+    const fs::path dir = fs::temp_directory_path() / "stream_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const string config_path = (dir / "stream_config.json").string();
+    const string requests_path = (dir / "stream_requests.jsonl").string();
+    const string answers_path = (dir / "stream_answers.jsonl").string();
+    std::ofstream(config_path) << R"({"config": {"name": "StreamTest", "version": "1.0", "max_responses": 5}, "files": []})";
+    std::ofstream(requests_path) << "\"milk water\"\n\n{\"request\": \"sugar\"}\n\"americano\"\n";
+
+    const vector<string> docs = {
+        "milk milk milk milk water water water",
+        "milk water water",
+        "milk milk milk milk milk water water water water water",
+        "americano cappuccino"
+    };
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+
+    ConverterJSON converter(config_path, requests_path, answers_path);
+    ASSERT_TRUE(converter.IsRequestStream());
+    // Ёмкость очередей 1 - стадии конвейера постоянно блокируют друг друга
+    ASSERT_EQ(converter.StreamAnswers(srv, 2, 1), 3);
+
+    json answers;
+    {
+        std::ifstream answers_file(answers_path);
+        std::string line;
+        while (std::getline(answers_file, line)) {
+            answers.update(json::parse(line));
+        }
+    }
+    fs::remove_all(dir);
+    ASSERT_EQ(answers.size(), 3);
+    EXPECT_EQ(answers["request001"]["relevance"].size(), 3);
+    EXPECT_EQ(answers["request001"]["relevance"][0]["docid"], 2);
+    EXPECT_EQ(answers["request002"]["result"], "false");
+    EXPECT_EQ(answers["request003"]["docid"], 3);
+}
+
+TEST(TestCaseConverterJSON, TestRequestsSaxMatchesDom) {
+    const vector<string> inputs = {
+        R"({"requests": ["milk water", "sugar", ""], "extra": {"requests": [1]}})",
+        R"({"other": ["milk"]})",
+        R"({"requests": "milk"})",
+        R"({"requests": ["milk", 42]})",
+        R"({"requests": ["milk", ["nested"]]})",
+        R"({"requests": ["milk",)"
+    };
+    for (const string& input : inputs) {
+        vector<string> sax_requests, dom_requests;
+        string sax_error, dom_error;
+        std::istringstream sax_in(input), dom_in(input);
+        RequestsParseStatus sax_status = ConverterJSON::ParseRequestsSax(sax_in, sax_requests, sax_error);
+        RequestsParseStatus dom_status = ConverterJSON::ParseRequestsDom(dom_in, dom_requests, dom_error);
+        EXPECT_EQ(sax_status, dom_status) << input;
+        EXPECT_EQ(sax_requests, dom_requests) << input;
+    }
+}
+
+TEST(TestCaseConverterJSON, TestThreadSettingsClamped) {
+    const fs::path config_path = fs::temp_directory_path() / "threads_config.json";
+    auto read = [&](const string& settings) {
+        std::ofstream(config_path) << R"({"config": {"name": "ThreadsTest", "version": "1.0")" + settings + R"(}, "files": []})";
+        ConverterJSON converter(config_path.string(), "", "");
+        return std::make_pair(converter.GetQueryThreads(), converter.GetIndexingThreads());
+    };
+    auto shards = [&](const string& settings) {
+        std::ofstream(config_path) << R"({"config": {"name": "ThreadsTest", "version": "1.0")" + settings + R"(}, "files": []})";
+        return ConverterJSON(config_path.string(), "", "").GetIndexShards();
+    };
+
+    EXPECT_EQ(read(""), std::make_pair(size_t(1), size_t(0)));
+    EXPECT_EQ(read(R"(, "query_threads": 3, "indexing_threads": 2)"), std::make_pair(size_t(3), size_t(2)));
+    // Отрицательное - по умолчанию, огромное урезается
+    EXPECT_EQ(read(R"(, "query_threads": -1, "indexing_threads": -5)"), std::make_pair(size_t(1), size_t(0)));
+    const auto huge = read(R"(, "query_threads": 4294967295, "indexing_threads": 100000000000)");
+    EXPECT_LE(huge.first, 4 * ResolveThreadsCount(0));
+    EXPECT_LE(huge.second, 4 * ResolveThreadsCount(0));
+    EXPECT_EQ(shards(""), 1u);
+    EXPECT_EQ(shards(R"(, "index_shards": -2)"), 1u);
+    EXPECT_LE(shards(R"(, "index_shards": 4294967295)"), 4 * ResolveThreadsCount(0));
+    fs::remove(config_path);
+}
+
+TEST(TestCaseInvertedIndex, TestMappedDocumentsMatchStrings) {
+    const vector<string> docs = {
+        "milk milk milk milk water water water",
+        "milk\twater\r\nwater",
+        string(DocumentLoader::MMAP_THRESHOLD, 'x') + " milk",
+        ""
+    };
+    const fs::path dir = fs::temp_directory_path() / "loader_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    vector<string> paths;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        paths.push_back((dir / ("doc" + std::to_string(i) + ".txt")).string());
+        std::ofstream(paths.back(), std::ios::binary) << docs[i];
+    }
+    paths.insert(paths.begin() + 1, (dir / "missing.txt").string());
+
+    {
+        vector<DocumentBuffer> buffers = DocumentLoader::LoadDocuments(paths, 2);
+        ASSERT_EQ(buffers.size(), docs.size());
+        for (size_t i = 0; i < docs.size(); ++i) {
+            EXPECT_EQ(buffers[i].view(), docs[i]);
+        }
+
+        InvertedIndex from_strings, from_buffers;
+        from_strings.UpdateDocumentBase(docs);
+        from_buffers.UpdateDocumentBase(std::move(buffers));
+        EXPECT_EQ(from_buffers.GetDocuments(), docs);
+        for (const string word : {"milk", "water", "x"}) {
+            EXPECT_EQ(from_buffers.GetWordCount(word), from_strings.GetWordCount(word)) << word;
+        }
+    }
+    // Отображённые файлы удаляются только после того, как индекс отпустил буферы
+    fs::remove_all(dir);
+}
+
+TEST(TestCaseInvertedIndex, TestUringLoaderMatchesFiles) {
+    const fs::path dir = fs::temp_directory_path() / "uring_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    vector<string> paths;
+    vector<string> expected;
+    for (size_t i = 0; i < 50; ++i) {
+        paths.push_back((dir / ("doc" + std::to_string(i) + ".txt")).string());
+        expected.push_back(i % 7 == 0 ? "" : "doc " + string(i * 100, 'a' + i % 26));
+        std::ofstream(paths.back(), std::ios::binary) << expected.back();
+    }
+    paths.push_back((dir / "missing.txt").string());
+
+    // Глубина очереди 4 - файлы проходят через кольцо в несколько волн
+    vector<DocumentBuffer> buffers = UringLoader::LoadDocuments(paths, 4);
+    ASSERT_EQ(buffers.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(buffers[i].view(), expected[i]) << paths[i];
+    }
+
+    // Очередь на две операции: чтения и закрытия ждут свободного места в кольце
+    buffers = UringLoader::LoadDocuments(paths, 2);
+    ASSERT_EQ(buffers.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(buffers[i].view(), expected[i]) << paths[i];
+    }
+    buffers.clear();
+    fs::remove_all(dir);
+}
+
+TEST(TestCaseInvertedIndex, TestParallelIndexIsSortedAndDeterministic) {
+    std::mt19937 rng(42);
+    vector<string> docs(300);
+    for (string& doc : docs) {
+        size_t words = rng() % 200;
+        for (size_t i = 0; i < words; ++i) {
+            doc += "w" + std::to_string(rng() % 50) + " ";
+        }
+    }
+
+    // Эталон - последовательный подсчёт
+    std::map<string, vector<Entry>> expected;
+    for (size_t doc_id = 0; doc_id < docs.size(); ++doc_id) {
+        std::map<string, size_t> counts;
+        std::istringstream ss(docs[doc_id]);
+        string word;
+        while (ss >> word) {
+            counts[word]++;
+        }
+        for (const auto& [w, count] : counts) {
+            expected[w].emplace_back(doc_id, count);
+        }
+    }
+
+    for (size_t threads : {1, 3, 8}) {
+        InvertedIndex idx;
+        idx.SetIndexingThreads(threads);
+        idx.UpdateDocumentBase(docs);
+        EXPECT_EQ(idx.GetFrequencyDictionary(), expected) << threads << " threads";
+    }
+}
+
+TEST(TestCaseInvertedIndex, TestExternalBuildMatchesInMemory) {
+    std::mt19937 rng(7);
+    vector<string> docs(200);
+    for (string& doc : docs) {
+        size_t words = rng() % 100;
+        for (size_t i = 0; i < words; ++i) {
+            doc += "term" + std::to_string(rng() % 300) + " ";
+        }
+    }
+
+    InvertedIndex in_memory;
+    in_memory.SetIndexingThreads(3);
+    in_memory.UpdateDocumentBase(docs);
+
+    // Бюджет в 4 КБ заставляет сбрасывать прогоны почти после каждого документа
+    const fs::path runs_dir = fs::temp_directory_path() / "external_runs_test";
+    fs::remove_all(runs_dir);
+    InvertedIndex external;
+    external.SetIndexingThreads(3);
+    external.SetMemoryBudget(4 * 1024, runs_dir.string());
+    external.UpdateDocumentBase(docs);
+
+    EXPECT_EQ(external.GetFrequencyDictionary(), in_memory.GetFrequencyDictionary());
+    EXPECT_TRUE(fs::is_empty(runs_dir));
+    fs::remove_all(runs_dir);
+}
+
+TEST(TestCaseInvertedIndex, TestRunMergerBoundedFanIn) {
+    const fs::path dir = fs::temp_directory_path() / "run_merger_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    // 9 прогонов по 50 записей; при fan-in 2 слияние идёт в несколько проходов
+    std::mt19937 rng(11);
+    vector<RunRecord> expected;
+    vector<fs::path> runs;
+    for (size_t run = 0; run < 9; ++run) {
+        vector<RunRecord> records;
+        for (size_t i = 0; i < 50; ++i) {
+            records.push_back({"w" + std::to_string(rng() % 40), run * 50 + i, rng() % 5 + 1});
+        }
+        expected.insert(expected.end(), records.begin(), records.end());
+        runs.push_back(dir / ("run" + std::to_string(run) + ".bin"));
+        RunWriter::Write(runs.back(), records);
+    }
+    std::sort(expected.begin(), expected.end());
+
+    size_t passes = 0;
+    RunMerger::Reduce(runs, 2, [&] { return dir / ("merge" + std::to_string(passes++) + ".bin"); });
+    EXPECT_LE(runs.size(), 2u);
+    EXPECT_EQ(passes, 7u); // каждый проход уменьшает число прогонов на 1
+
+    vector<RunRecord> merged;
+    {
+        RunMerger merger(runs);
+        RunRecord record;
+        while (merger.Next(record)) {
+            merged.push_back(record);
+        }
+    }
+    ASSERT_EQ(merged.size(), expected.size());
+    for (size_t i = 0; i < merged.size(); ++i) {
+        EXPECT_EQ(merged[i].word, expected[i].word);
+        EXPECT_EQ(merged[i].doc_id, expected[i].doc_id);
+        EXPECT_EQ(merged[i].count, expected[i].count);
+    }
+    // Промежуточные прогоны удалены, остались только последние
+    EXPECT_EQ((size_t)std::distance(fs::directory_iterator(dir), fs::directory_iterator()), runs.size());
+    fs::remove_all(dir);
+}
+
+TEST(TestCaseInvertedIndex, TestSegmentedIngestionMatchesRebuild) {
+    const vector<string> docs = {
+        "london is the capital of great britain",
+        "paris is the capital of france",
+        "berlin is the capital of germany",
+        "rome is the capital of italy",
+        "madrid is the capital of spain",
+        "moscow is the capital of russia",
+        "welcome to moscow the capital of russia the third rome",
+        "amsterdam is the capital of netherlands",
+        "helsinki is the capital of finland",
+        "oslo is the capital of norway",
+        "stockholm is the capital of sweden"
+    };
+    const vector<string> requests = {"capital", "moscow russia", "rome", "tokyo"};
+
+    InvertedIndex rebuilt;
+    rebuilt.UpdateDocumentBase(docs);
+    SearchServer rebuilt_srv(rebuilt);
+
+    InvertedIndex segmented;
+    segmented.SetSegmentPolicy(2, std::chrono::milliseconds(5), 2);
+    segmented.UpdateDocumentBase(vector<string>(docs.begin(), docs.begin() + 3));
+    SearchServer segmented_srv(segmented);
+
+    // Поиск идёт параллельно с добавлением документов и фоновыми слияниями
+    std::atomic<bool> ingesting{true};
+    std::thread searcher([&] {
+        while (ingesting) {
+            segmented_srv.search(requests);
+        }
+    });
+    for (size_t i = 3; i < docs.size(); ++i) {
+        EXPECT_EQ(segmented.AddDocuments({docs[i]}), i);
+    }
+    segmented.Flush();
+    segmented.WaitForMerges();
+    ingesting = false;
+    searcher.join();
+
+    EXPECT_EQ(segmented.GetFrequencyDictionary(), rebuilt.GetFrequencyDictionary());
+    EXPECT_EQ(segmented_srv.search(requests), rebuilt_srv.search(requests));
+    EXPECT_EQ(segmented.GetDocuments(), docs);
+    // 8 новых документов: сегменты по 2 сливаются попарно
+    EXPECT_LE(segmented.GetSnapshot()->segments.size(), 3);
+}
+
+TEST(TestCaseInvertedIndex, TestWalRecovery) {
+    const vector<string> docs = {
+        "london is the capital of great britain",
+        "paris is the capital of france",
+        "berlin is the capital of germany",
+        "rome is the capital of italy",
+        "moscow is the capital of russia",
+        "welcome to moscow the capital of russia the third rome"
+    };
+    const vector<string> requests = {"capital", "moscow russia", "rome", "paris"};
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "search_engine_wal_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const string snapshot_path = (dir / "index.bin").string();
+    const string wal_path = (dir / "index.wal").string();
+
+    InvertedIndex expected;
+    expected.UpdateDocumentBase(docs);
+    expected.RemoveDocument(1);
+    SearchServer expected_srv(expected);
+
+    {
+        // База сохраняется при UpdateDocumentBase, остальные изменения попадают только в журнал
+        InvertedIndex index;
+        index.OpenStorage(snapshot_path, wal_path);
+        index.UpdateDocumentBase(vector<string>(docs.begin(), docs.begin() + 3));
+        index.AddDocuments(vector<string>(docs.begin() + 3, docs.end()));
+        EXPECT_TRUE(index.RemoveDocument(1));
+        EXPECT_FALSE(index.RemoveDocument(1));
+        EXPECT_FALSE(index.RemoveDocument(docs.size()));
+    }
+
+    // Оборванная при сбое запись в конце журнала
+    {
+        std::ofstream wal(wal_path, std::ios::binary | std::ios::app);
+        wal << "\x40\x00\x00\x00garbage";
+    }
+
+    InvertedIndex recovered;
+    EXPECT_EQ(recovered.OpenStorage(snapshot_path, wal_path), 4);
+    SearchServer recovered_srv(recovered);
+    EXPECT_EQ(recovered.GetDocuments(), docs);
+    EXPECT_EQ(recovered.GetFrequencyDictionary(), expected.GetFrequencyDictionary());
+    EXPECT_EQ(recovered_srv.search(requests), expected_srv.search(requests));
+
+    // После восстановления журнал продолжает писаться за последней целой записью
+    recovered.AddDocuments({"paris is beautiful"});
+    recovered.Checkpoint();
+    EXPECT_EQ(std::filesystem::file_size(wal_path), 0);
+
+    InvertedIndex reopened;
+    EXPECT_EQ(reopened.OpenStorage(snapshot_path, wal_path), 0);
+    EXPECT_EQ(reopened.GetWordCount("paris"), (vector<Entry>{{docs.size(), 1}}));
+    EXPECT_EQ(reopened.GetDocuments().size(), docs.size() + 1);
+
+    // Оборванный заголовок с огромной длиной: чтение останавливается, буфер под неё не выделяется
+    const string torn_path = (dir / "torn.wal").string();
+    {
+        std::ofstream wal(torn_path, std::ios::binary);
+        wal.write("\xF0\xFF\xFF\xFF\x00\x00\x00\x00tail", 12);
+    }
+    const auto torn = WriteAheadLog::Replay(torn_path, 0, [](WriteAheadLog::Record&) { FAIL(); });
+    EXPECT_EQ(torn.applied, 0);
+    EXPECT_EQ(torn.valid_bytes, 0);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST(TestCaseInvertedIndex, TestWildcardExpansion) {
+    const vector<string> docs = {
+        "london is the capital of great britain",
+        "the capitol hill",
+        "rome is the capital of italy",
+        "home sweet home",
+        "capitalism"
+    };
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+
+    EXPECT_EQ(idx.GetWordCount("capit*"), (vector<Entry>{{0, 1}, {1, 1}, {2, 1}, {4, 1}}));
+    EXPECT_EQ(idx.GetWordCount("capital?*"), (vector<Entry>{{4, 1}}));
+    EXPECT_EQ(idx.GetWordCount("?ome"), (vector<Entry>{{2, 1}, {3, 2}}));
+    EXPECT_EQ(idx.GetWordCount("x*"), vector<Entry>());
+
+    // Шаблон внутри запроса ведёт себя как одно слово с объединёнными вхождениями
+    const vector<RelativeIndex> expected = {{2, 1.0f}};
+    EXPECT_EQ(srv.search_one("capit* ?ome"), expected);
+
+    // Ограничение раскрытия: берутся первые по порядку слова
+    idx.SetMaxExpansions(2);
+    EXPECT_EQ(idx.GetWordCount("capit*"), (vector<Entry>{{0, 1}, {2, 1}, {4, 1}}));
+
+    // Сжатый словарь раскрывает шаблоны так же, как полный перебор
+    std::set<string> words;
+    std::mt19937 rng(7);
+    const vector<string> alphabet = {"a", "b", "c", "d", "e", "ф"};
+    for (int i = 0; i < 3000; ++i) {
+        string word;
+        for (size_t len = 1 + rng() % 8; len > 0; --len) {
+            word += alphabet[rng() % alphabet.size()];
+        }
+        words.insert(word);
+    }
+    const vector<std::string_view> sorted(words.begin(), words.end());
+    TermDictionary dictionary(sorted);
+    for (const string pattern : {"ab*", "a?c*", "*ed", "b*a*c", "ab", "*", "zz*"}) {
+        vector<string> brute;
+        for (const string& word : words) {
+            if (TermDictionary::WildcardMatch(pattern, word)) {
+                brute.push_back(word);
+            }
+        }
+        EXPECT_EQ(dictionary.Expand(pattern, words.size()), brute) << pattern;
+    }
+}
+
+namespace {
+
+// Расстояние Левенштейна по символам UTF-8 - эталон для нечёткого раскрытия
+size_t utf8_levenshtein(const string& a, const string& b) {
+    auto split = [](const string& s) {
+        vector<string> symbols;
+        for (size_t i = 0; i < s.size();) {
+            size_t length = ((unsigned char)s[i] & 0x80) == 0 ? 1 : 2;
+            symbols.push_back(s.substr(i, length));
+            i += length;
+        }
+        return symbols;
+    };
+    const vector<string> x = split(a), y = split(b);
+    vector<size_t> row(y.size() + 1);
+    for (size_t j = 0; j <= y.size(); ++j) row[j] = j;
+    for (size_t i = 1; i <= x.size(); ++i) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= y.size(); ++j) {
+            size_t up = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (x[i - 1] == y[j - 1] ? 0 : 1)});
+            diagonal = up;
+        }
+    }
+    return row[y.size()];
+}
+
+} // namespace
+
+TEST(TestCaseSearchServer, TestFuzzyMatching) {
+    const vector<string> docs = {
+        "moscow is the capital of russia",
+        "the capitol hill",
+        "copital typo in the text"
+    };
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+
+    EXPECT_EQ(idx.GetWordCount("capitol~1"), (vector<Entry>{{0, 1}, {1, 1}}));
+    EXPECT_EQ(idx.GetWordCount("capitol~"), (vector<Entry>{{0, 1}, {1, 1}, {2, 1}}));
+    EXPECT_EQ(idx.GetWordCount("capitol~0"), (vector<Entry>{{1, 1}}));
+    // Короткие слова не размываются
+    EXPECT_EQ(idx.GetWordCount("of~"), (vector<Entry>{{0, 1}}));
+
+    // Без нечёткого режима опечатка даёт пустой ответ
+    EXPECT_TRUE(srv.search_one("moscw russia").empty());
+    srv.SetFuzzyFallback(true);
+    const vector<RelativeIndex> expected = {{0, 1.0f}};
+    EXPECT_EQ(srv.search_one("moscw russia"), expected);
+
+    // Автомат по сжатому словарю находит те же слова, что и полный перебор
+    std::set<string> words;
+    std::mt19937 rng(11);
+    const vector<string> alphabet = {"a", "b", "c", "d", "ф", "ы"};
+    for (int i = 0; i < 5000; ++i) {
+        string word;
+        for (size_t len = 1 + rng() % 7; len > 0; --len) {
+            word += alphabet[rng() % alphabet.size()];
+        }
+        words.insert(word);
+    }
+    const vector<std::string_view> sorted(words.begin(), words.end());
+    TermDictionary dictionary(sorted);
+    for (const string query : {"abcd", "фыab", "dddd", "aфы", "b"}) {
+        for (unsigned distance : {1u, 2u}) {
+            std::set<string> brute;
+            for (const string& word : words) {
+                if (utf8_levenshtein(query, word) <= distance) {
+                    brute.insert(word);
+                }
+            }
+            vector<string> expanded = dictionary.ExpandFuzzy(query, distance, 0, words.size());
+            EXPECT_EQ(std::set<string>(expanded.begin(), expanded.end()), brute) << query << "~" << distance;
+        }
+    }
+}
+
+TEST(TestCaseInvertedIndex, TestStemmingMergesWordForms) {
+    // Эталонные основы алгоритмов Snowball
+    EXPECT_EQ(Stemmer::Stem("generously"), "generous");
+    EXPECT_EQ(Stemmer::Stem("relational"), "relat");
+    EXPECT_EQ(Stemmer::Stem("ponies"), "poni");
+    EXPECT_EQ(Stemmer::Stem("важнейшие"), "важн");
+    EXPECT_EQ(Stemmer::Stem("величественный"), "величествен");
+    EXPECT_EQ(Stemmer::Stem("книгами"), "книг");
+    EXPECT_EQ(Stemmer::Stem("file001"), "file001");
+    EXPECT_EQ(Stemmer::StemCached("столицы"), Stemmer::Stem("столицы"));
+
+    const vector<string> docs = {
+        "москва столица россии",
+        "столицы европы и мира",
+        "the capitals of europe",
+        "capital city"
+    };
+    InvertedIndex plain;
+    plain.UpdateDocumentBase(docs);
+    InvertedIndex stemmed;
+    stemmed.SetStemming(true);
+    stemmed.UpdateDocumentBase(docs);
+    SearchServer srv(stemmed);
+
+    EXPECT_LT(stemmed.GetFrequencyDictionary().size(), plain.GetFrequencyDictionary().size());
+    EXPECT_EQ(stemmed.GetWordCount("столицей"), (vector<Entry>{{0, 1}, {1, 1}}));
+    EXPECT_EQ(stemmed.GetWordCount("capital"), (vector<Entry>{{2, 1}, {3, 1}}));
+
+    EXPECT_EQ(srv.search_one("европейская столица"), vector<RelativeIndex>{});
+    EXPECT_EQ(srv.search_one("capitals europe"), (vector<RelativeIndex>{{2, 1.0f}}));
+    EXPECT_EQ(srv.search_one("столицей европы"), (vector<RelativeIndex>{{1, 1.0f}}));
+}
+
+TEST(TestCaseSearchServer, TestDensePostingsMatchSparse) {
+    // Битовая карта: массивные и плотные контейнеры, границы контейнеров
+    std::mt19937 rng(3);
+    vector<uint32_t> a, b;
+    for (uint32_t v = 0; v < 300000; ++v) {
+        if (rng() % 3 == 0 || (v > 70000 && v < 140000)) a.push_back(v);
+        if (rng() % 50 == 0 || (v > 100000 && v < 200000 && v % 2 == 0)) b.push_back(v);
+    }
+    RoaringBitmap bitmap_a = RoaringBitmap::FromSorted(a);
+    RoaringBitmap bitmap_b = RoaringBitmap::FromSorted(b);
+    EXPECT_EQ(bitmap_a.Cardinality(), a.size());
+    for (uint32_t v : {0u, 1u, 65535u, 65536u, 99999u, 131072u, 299999u}) {
+        EXPECT_EQ(bitmap_a.Contains(v), std::binary_search(a.begin(), a.end(), v)) << v;
+        EXPECT_EQ(bitmap_a.Rank(v), (size_t)(std::lower_bound(a.begin(), a.end(), v) - a.begin())) << v;
+    }
+    vector<uint32_t> expected_and, actual_and;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected_and));
+    RoaringBitmap::And(bitmap_a, bitmap_b).ForEach([&](uint32_t v) { actual_and.push_back(v); });
+    EXPECT_EQ(actual_and, expected_and);
+
+    // Поиск по плотным словам совпадает с полным перебором документов
+    vector<string> docs;
+    for (size_t i = 0; i < 6000; ++i) {
+        string text;
+        if (rng() % 10 < 9) text += "the ";
+        if (rng() % 10 < 6) text += "and and ";
+        if (rng() % 100 == 0) text += "rare ";
+        if (rng() % 4 == 0) text += "the ";
+        docs.push_back(text + "doc");
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+    const auto& segment = *idx.GetSnapshot()->segments.front();
+    EXPECT_NE(segment.bitmap(segment.postings("the")), nullptr);
+    EXPECT_EQ(segment.bitmap(segment.postings("rare")), nullptr);
+
+    for (const string query : {"the and", "and the doc", "rare the", "rare and"}) {
+        vector<string> words;
+        std::stringstream ss(query);
+        for (string word; ss >> word;) words.push_back(word);
+
+        std::map<size_t, size_t> relevance;
+        for (size_t doc_id = 0; doc_id < docs.size(); ++doc_id) {
+            size_t total = 0;
+            bool all = true;
+            for (const string& word : words) {
+                std::stringstream text(docs[doc_id]);
+                size_t count = 0;
+                for (string token; text >> token;) count += token == word;
+                all = all && count > 0;
+                total += count;
+            }
+            if (all) relevance[doc_id] = total;
+        }
+        size_t max_relevance = 0;
+        for (const auto& pair : relevance) max_relevance = std::max(max_relevance, pair.second);
+        vector<RelativeIndex> expected;
+        for (const auto& pair : relevance) expected.push_back({pair.first, (float)pair.second / max_relevance});
+        std::sort(expected.begin(), expected.end(), [](const RelativeIndex& x, const RelativeIndex& y) {
+            return fabs(x.rank - y.rank) > float_eps ? x.rank > y.rank : x.doc_id < y.doc_id;
+        });
+        EXPECT_EQ(srv.search_one(query), expected) << query;
+    }
+}
+
+TEST(TestCaseSearchServer, TestQueryPlan) {
+    // Слова по возрастанию df, пустое слово обрывает план
+    QueryPlan plan = QueryPlanner::Plan({{5000, false}, {10, false}, {800, false}}, 100000);
+    ASSERT_EQ(plan.steps.size(), 3u);
+    EXPECT_EQ(plan.steps[0].term, 1u);
+    EXPECT_EQ(plan.steps[1].term, 2u);
+    EXPECT_EQ(plan.steps[2].term, 0u);
+    EXPECT_EQ(plan.steps[0].method, IntersectMethod::Scan);
+    EXPECT_EQ(plan.steps[1].method, IntersectMethod::Galloping);
+    plan = QueryPlanner::Plan({{5000, true}, {0, false}}, 100000);
+    EXPECT_TRUE(plan.short_circuit);
+    EXPECT_EQ(plan.empty_term, 1u);
+    EXPECT_TRUE(plan.steps.empty());
+
+    // Два частых плотных слова - AND битовых карт, редкое - сначала обход и проверка по карте
+    plan = QueryPlanner::Plan({{90000, true}, {60000, true}}, 100000);
+    EXPECT_EQ(plan.steps[0].method, IntersectMethod::BitmapAnd);
+    EXPECT_EQ(plan.steps[1].method, IntersectMethod::BitmapAnd);
+    plan = QueryPlanner::Plan({{90000, true}, {100, false}}, 100000);
+    EXPECT_EQ(plan.steps[0].term, 1u);
+    EXPECT_EQ(plan.steps[1].method, IntersectMethod::BitmapProbe);
+
+    // explain: отсутствующее слово, фактическое число кандидатов
+    vector<string> docs;
+    for (size_t i = 0; i < 3000; ++i) {
+        docs.push_back(string("the and ") + (i % 3 == 0 ? "cat " : "") + (i % 100 == 0 ? "rare" : ""));
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+    EXPECT_NE(srv.explain("the missing ra*").find("short-circuit: \"missing\""), string::npos);
+    const string text = srv.explain("rare cat");
+    EXPECT_NE(text.find("rare"), string::npos);
+    EXPECT_NE(text.find("actual 10 "), string::npos) << text;
+    EXPECT_EQ(srv.search_one("rare cat").size(), 10u);
+}
+
+namespace {
+
+// Проверочное вычисление булева запроса по тексту документа: частота (0 - подошёл только через NOT)
+// или -1, если документ не подходит
+long long evaluate(const QueryNode& node, const string& text) {
+    switch (node.kind) {
+        case QueryNode::Kind::Term: {
+            std::stringstream ss(text);
+            long long count = 0;
+            for (string token; ss >> token;) {
+                count += TermDictionary::IsPattern(node.term) ? TermDictionary::WildcardMatch(node.term, token)
+                                                              : token == node.term;
+            }
+            return count > 0 ? count : -1;
+        }
+        case QueryNode::Kind::Not:
+            return evaluate(node.children.front(), text) >= 0 ? -1 : 0;
+        case QueryNode::Kind::And: {
+            long long total = 0;
+            for (const QueryNode& child : node.children) {
+                const long long score = evaluate(child, text);
+                if (score < 0) return -1;
+                total += score;
+            }
+            return node.children.empty() ? -1 : total;
+        }
+        case QueryNode::Kind::Or: {
+            long long total = -1;
+            for (const QueryNode& child : node.children) {
+                const long long score = evaluate(child, text);
+                if (score >= 0) total = std::max(total, 0LL) + score;
+            }
+            return total;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+TEST(TestCaseSearchServer, TestBooleanQueries) {
+    EXPECT_FALSE(QueryParser::IsBoolean("cat dog"));
+    EXPECT_TRUE(QueryParser::IsBoolean("cat OR dog"));
+    EXPECT_TRUE(QueryParser::IsBoolean("(cat dog)"));
+    EXPECT_EQ(QueryParser::ToString(QueryParser::Parse("cat dog OR bird NOT fish")),
+              "(cat AND dog) OR (bird AND NOT fish)");
+    EXPECT_EQ(QueryParser::ToString(QueryParser::Parse("(cat OR dog) (bird AND (fish AND ant))")),
+              "(cat OR dog) AND bird AND fish AND ant");
+    EXPECT_EQ(QueryParser::ToString(QueryParser::Parse("NOT NOT cat AND")), "cat");
+    EXPECT_EQ(QueryParser::ToString(QueryParser::Parse("cat NOT (dog OR ant)")), "cat AND NOT (dog OR ant)");
+    // Лишние скобки и операторы не мешают разбору
+    EXPECT_EQ(QueryParser::ToString(QueryParser::Parse(") cat OR (dog")), "cat OR dog");
+
+    std::mt19937 rng(5);
+    const vector<string> vocabulary = {"cat", "dog", "bird", "fish", "ant"};
+    vector<string> docs;
+    for (size_t i = 0; i < 4000; ++i) {
+        string text = "doc";
+        for (size_t w = 0; w < vocabulary.size(); ++w) {
+            const size_t repeats = rng() % (w + 3);
+            for (size_t r = 1; r < repeats; ++r) text += " " + vocabulary[w];
+        }
+        docs.push_back(text);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+
+    for (const string query : {"cat OR dog", "cat AND NOT dog", "(cat OR bird) AND NOT (fish OR ant)",
+                               "bird fish OR cat NOT ant", "NOT cat", "ant AND (dog OR missing)",
+                               "missing AND cat", "ca* AND NOT d?g", "(cat OR dog) (bird OR fish) NOT ant",
+                               "dog OR NOT cat", "NOT cat AND NOT dog", "NOT (cat OR missing)"}) {
+        const QueryNode root = QueryParser::Parse(query);
+        std::map<size_t, long long> relevance;
+        for (size_t doc_id = 0; doc_id < docs.size(); ++doc_id) {
+            const long long score = evaluate(root, docs[doc_id]);
+            if (score >= 0) relevance[doc_id] = score;
+        }
+        long long max_relevance = 0;
+        for (const auto& pair : relevance) max_relevance = std::max(max_relevance, pair.second);
+        vector<RelativeIndex> expected;
+        for (const auto& pair : relevance) {
+            expected.push_back({pair.first, max_relevance > 0 ? (float)pair.second / max_relevance : 1.0f});
+        }
+        std::sort(expected.begin(), expected.end(), [](const RelativeIndex& x, const RelativeIndex& y) {
+            return fabs(x.rank - y.rank) > float_eps ? x.rank > y.rank : x.doc_id < y.doc_id;
+        });
+        EXPECT_EQ(srv.search_one(query), expected) << query;
+        if (query != "missing AND cat") {
+            EXPECT_FALSE(expected.empty()) << query;
+        }
+    }
+
+    // Вложенность ограничена: разбор не уходит в глубокую рекурсию
+    EXPECT_THROW(QueryParser::Parse(string(QueryParser::MAX_DEPTH + 1, '(') + "cat"), std::invalid_argument);
+    string negations;
+    for (size_t i = 0; i <= QueryParser::MAX_DEPTH; ++i) {
+        negations += "NOT ";
+    }
+    EXPECT_THROW(QueryParser::Parse(negations + "cat"), std::invalid_argument);
+    EXPECT_EQ(QueryParser::ToString(QueryParser::Parse(string(QueryParser::MAX_DEPTH - 1, '(') + "cat")), "cat");
+}
+
+TEST(TestCaseInvertedIndex, TestTermArenaLookupAndMemory) {
+    vector<string> docs;
+    size_t word_bytes = 0;
+    std::set<string> vocabulary;
+    for (size_t i = 0; i < 500; ++i) {
+        string text;
+        for (size_t w = 0; w < 10; ++w) {
+            string word = "term" + std::to_string((i * 7 + w * 13) % 2000) + string(w, 'z');
+            if (vocabulary.insert(word).second) word_bytes += word.size();
+            text += word + " ";
+        }
+        docs.push_back(text);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+
+    // Каждое слово находится по string_view, отсутствующие - нет
+    const auto dictionary = idx.GetFrequencyDictionary();
+    ASSERT_EQ(dictionary.size(), vocabulary.size());
+    for (const auto& [word, entries] : dictionary) {
+        EXPECT_EQ(idx.GetWordCount(word), entries) << word;
+    }
+    EXPECT_TRUE(idx.GetWordCount("term").empty());
+    EXPECT_TRUE(idx.GetWordCount("term1zzzzzzzzzzzz").empty());
+
+    const IndexSegment::MemoryUsage usage = idx.GetMemoryUsage();
+    EXPECT_EQ(usage.terms, vocabulary.size());
+    // Память массива слов - по его ёмкости, поэтому не меньше суммы длин слов
+    EXPECT_GE(usage.term_bytes, word_bytes);
+    EXPECT_GT(usage.postings, 0u);
+    // Без отдельной строки на слово: байты слова плюс слот (смещение, длина, список)
+    EXPECT_LT(usage.dictionary_bytes_per_term(), (double)word_bytes / usage.terms + 40);
+}
+
+TEST(TestCaseInvertedIndex, TestFrozenPerfectHash) {
+    // Совершенный хеш: различные номера в [0, n), около 3 бит на ключ
+    std::mt19937_64 rng(43);
+    vector<uint64_t> hashes(20000);
+    for (uint64_t& hash : hashes) hash = rng();
+    PerfectHash mph(hashes);
+    vector<char> used(hashes.size(), 0);
+    for (uint64_t hash : hashes) {
+        const size_t index = mph.Lookup(hash);
+        ASSERT_LT(index, hashes.size());
+        EXPECT_FALSE(used[index]);
+        used[index] = 1;
+    }
+    EXPECT_LT(mph.memory_usage() * 8.0 / (double)hashes.size(), 4.5);
+
+    // Замороженный индекс отвечает так же, как сегментированный с удалениями
+    vector<string> docs;
+    for (size_t i = 0; i < 300; ++i) {
+        docs.push_back("word" + std::to_string(i % 97) + " common term" + std::to_string(i * 31 % 500));
+    }
+    InvertedIndex idx;
+    idx.SetSegmentPolicy(16, std::chrono::milliseconds(5), 4);
+    idx.AddDocuments(docs);
+    idx.RemoveDocument(5);
+    idx.Flush();
+    const auto expected = idx.GetFrequencyDictionary();
+
+    idx.Freeze();
+    EXPECT_TRUE(idx.IsFrozen());
+    ASSERT_EQ(idx.GetSnapshot()->segments.size(), 1u);
+    EXPECT_TRUE(idx.GetSnapshot()->segments.front()->frozen());
+    for (const auto& [word, entries] : expected) {
+        vector<Entry> live;
+        for (const Entry& entry : entries) {
+            if (entry.doc_id != 5) live.push_back(entry);
+        }
+        EXPECT_EQ(idx.GetWordCount(word), live) << word;
+    }
+    EXPECT_TRUE(idx.GetWordCount("word97").empty());
+    EXPECT_TRUE(idx.GetWordCount("absent").empty());
+    EXPECT_GT(idx.GetMemoryUsage().hash, 0u);
+
+    EXPECT_THROW(idx.AddDocuments({"new doc"}), std::logic_error);
+    EXPECT_THROW(idx.RemoveDocument(1), std::logic_error);
+
+    // Перестроение базы снимает заморозку
+    idx.UpdateDocumentBase(docs);
+    EXPECT_FALSE(idx.IsFrozen());
+    EXPECT_FALSE(idx.GetSnapshot()->segments.front()->frozen());
+}
+
+TEST(TestCaseInvertedIndex, TestCsrPostingsLayout) {
+    std::mt19937 rng(44);
+    vector<string> docs(300);
+    for (string& doc : docs) {
+        for (size_t i = rng() % 40; i > 0; --i) {
+            doc += "w" + std::to_string(rng() % 500) + " ";
+        }
+    }
+
+    for (size_t threads : {1, 5}) {
+        InvertedIndex idx;
+        idx.SetIndexingThreads(threads);
+        idx.UpdateDocumentBase(docs);
+        const IndexSegment& segment = *idx.GetSnapshot()->segments.front();
+
+        // Слова всех частей словаря слиты по возрастанию, вхождения лежат в одном массиве без зазоров
+        size_t entries = 0;
+        const Entry* first = segment.postings_at(0).data();
+        const Entry* last = first;
+        for (size_t i = 0; i < segment.term_count(); ++i) {
+            if (i > 0) {
+                EXPECT_LT(segment.term(i - 1), segment.term(i));
+            }
+            const std::span<const Entry> postings = segment.postings_at(i);
+            first = std::min(first, postings.data());
+            last = std::max(last, postings.data() + postings.size());
+            EXPECT_TRUE(std::is_sorted(postings.begin(), postings.end(),
+                                       [](const Entry& a, const Entry& b) { return a.doc_id < b.doc_id; }));
+            EXPECT_EQ(segment.postings(segment.term(i)).data(), postings.data());
+            entries += postings.size();
+        }
+        EXPECT_EQ((size_t)(last - first), entries) << threads << " threads";
+        EXPECT_EQ(segment.memory_usage().postings, entries * sizeof(Entry));
+    }
+}
+
+TEST(TestCaseInvertedIndex, TestHugeDocumentSplitIntoChunks) {
+    // Документ больше двух кусков индексации и мелкие документы вокруг него
+    vector<string> docs = {"alpha beta", "", "gamma alpha"};
+    string huge;
+    size_t alphas = 0;
+    for (size_t i = 0; huge.size() <= 2 * InvertedIndex::INDEX_CHUNK_BYTES; ++i) {
+        huge += (i % 3 == 0 ? "alpha" : "w" + std::to_string(i % 1000)) + (i % 17 == 0 ? "\n" : " ");
+        alphas += i % 3 == 0;
+    }
+    docs.insert(docs.begin() + 2, huge);
+    for (size_t i = 0; i < 2000; ++i) {
+        docs.push_back("tiny" + std::to_string(i % 7));
+    }
+
+    InvertedIndex idx;
+    idx.SetIndexingThreads(3);
+    idx.UpdateDocumentBase(docs);
+
+    // Куски большого документа сливаются в один doc_id, слова на границах кусков не разрезаются
+    const vector<Entry> expected = {{0, 1}, {2, alphas}, {3, 1}};
+    EXPECT_EQ(idx.GetWordCount("alpha"), expected);
+    EXPECT_EQ(idx.GetWordCount("w1").size(), 1u);
+    EXPECT_EQ(idx.GetWordCount("w1").front().doc_id, 2u);
+    EXPECT_EQ(idx.GetWordCount("tiny3").size(), 286u);
+    for (const auto& [word, entries] : idx.GetFrequencyDictionary()) {
+        EXPECT_FALSE(word.starts_with("lpha") || (word.starts_with("alph") && word != "alpha")) << word;
+    }
+}
+
+TEST(TestCaseInvertedIndex, TestIndexingProgressAndCancellation) {
+    vector<string> docs;
+    size_t bytes = 0;
+    for (size_t i = 0; i < 3000; ++i) {
+        docs.push_back("doc" + std::to_string(i % 50) + " common text");
+        bytes += docs.back().size();
+    }
+
+    InvertedIndex idx;
+    vector<IndexingProgress> reports;
+    idx.SetIndexingThreads(2);
+    idx.SetProgressCallback([&](const IndexingProgress& progress) { reports.push_back(progress); },
+                            std::chrono::milliseconds(0));
+    idx.UpdateDocumentBase(docs);
+
+    // Промежуточные отчёты не убывают, последний - полный, с числом слов
+    ASSERT_GE(reports.size(), 2u);
+    for (size_t i = 1; i < reports.size(); ++i) {
+        EXPECT_LE(reports[i - 1].bytes_done, reports[i].bytes_done);
+    }
+    const IndexingProgress& last = reports.back();
+    EXPECT_TRUE(last.finished);
+    EXPECT_EQ(last.docs_done, docs.size());
+    EXPECT_EQ(last.docs_total, docs.size());
+    EXPECT_EQ(last.bytes_done, bytes);
+    EXPECT_EQ(last.terms, 52u);
+    EXPECT_EQ(last.eta_seconds(), 0);
+
+    // Отмена из наблюдателя посреди сборки: прежний индекс не меняется
+    std::stop_source stop;
+    idx.SetProgressCallback([&](const IndexingProgress&) { stop.request_stop(); }, std::chrono::milliseconds(0));
+    EXPECT_THROW(idx.UpdateDocumentBase({"replacement"}, stop.get_token()), IndexingCancelled);
+    EXPECT_TRUE(idx.GetWordCount("replacement").empty());
+    EXPECT_EQ(idx.GetWordCount("common").size(), docs.size());
+
+    // Отмена до начала, в том числе при сборке через временные файлы
+    const fs::path runs_dir = fs::temp_directory_path() / "cancelled_runs_test";
+    fs::remove_all(runs_dir);
+    idx.SetMemoryBudget(4 * 1024, runs_dir.string());
+    EXPECT_THROW(idx.UpdateDocumentBase({"replacement"}, stop.get_token()), IndexingCancelled);
+    EXPECT_TRUE(!fs::exists(runs_dir) || fs::is_empty(runs_dir));
+    EXPECT_EQ(idx.GetWordCount("common").size(), docs.size());
+    fs::remove_all(runs_dir);
+}
+
+TEST(TestCaseSearchServer, TestRankingFormulas) {
+    // В документе 1 больше редкого слова, в документе 0 - частого; по сумме частот они равны
+    vector<string> docs = {"rare common common common", "rare rare rare common"};
+    for (size_t i = 0; i < 10; ++i) {
+        docs.push_back("common filler");
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer server(idx);
+
+    const vector<RelativeIndex> count = {{0, 1}, {1, 1}};
+    EXPECT_EQ(server.search_one("rare common"), count);
+
+    // TF-IDF: вес слова ln((N + 1) / (df + 1)) + 1
+    server.SetRanking(Ranking::TfIdf);
+    EXPECT_EQ(server.GetRanking(), Ranking::TfIdf);
+    const double rare = std::log(13.0 / 3.0) + 1;
+    const double common = 1;
+    const vector<RelativeIndex> tfidf = {{1, 1}, {0, (float)((rare + 3 * common) / (3 * rare + common))}};
+    EXPECT_EQ(server.search_one("rare common"), tfidf);
+
+    // BM25 насыщает частоту: три вхождения весят tf * (k1 + 1) / (tf + k1), а не втрое больше одного
+    server.SetRanking(Ranking::Bm25);
+    const vector<RelativeIndex> bm25 = server.search_one("rare common");
+    ASSERT_EQ(bm25.size(), 2u);
+    EXPECT_EQ(bm25[0].doc_id, 1u);
+    EXPECT_LT(bm25[1].rank, 1.0f);
+    const vector<RelativeIndex> saturated = server.search_one("common");
+    ASSERT_EQ(saturated.size(), docs.size());
+    EXPECT_EQ(saturated[0].doc_id, 0u);
+    EXPECT_NEAR(saturated.back().rank, (1.2 + 3) / (3 * 2.2), 1e-6);
+
+    // Булевы запросы ранжируются суммой частот при любой формуле
+    const vector<RelativeIndex> boolean = {{0, 1}, {1, 1}};
+    EXPECT_EQ(server.search_one("rare AND common"), boolean);
+
+    EXPECT_EQ(ParseRanking("bm25"), Ranking::Bm25);
+    EXPECT_THROW(ParseRanking("pagerank"), std::invalid_argument);
+}
+
+TEST(TestCaseSearchServer, TestImpactQuantization) {
+    vector<string> docs = {"rare common common common", "rare rare rare common"};
+    for (size_t i = 0; i < 10; ++i) {
+        docs.push_back("common filler");
+    }
+    InvertedIndex idx;
+    idx.SetImpactQuantization(16);
+    idx.UpdateDocumentBase(docs);
+    EXPECT_EQ(idx.GetImpactBits(), 16u);
+    EXPECT_GT(idx.GetMemoryUsage().impacts, 0u);
+    EXPECT_THROW(idx.SetImpactQuantization(12), std::invalid_argument);
+    EXPECT_THROW(idx.SetImpactQuantization(8), std::logic_error);
+    EXPECT_NO_THROW(idx.SetImpactQuantization(16));
+
+    // Сумма импактов упорядочивает документы так же, как точный BM25
+    SearchServer server(idx);
+    server.SetRanking(Ranking::Bm25);
+    const vector<RelativeIndex> bm25 = server.search_one("rare common");
+    server.SetRanking(Ranking::Impact);
+    EXPECT_EQ(server.GetRanking(), Ranking::Impact);
+    const vector<RelativeIndex> impact = server.search_one("rare common");
+    ASSERT_EQ(impact.size(), bm25.size());
+    for (size_t i = 0; i < impact.size(); ++i) {
+        EXPECT_EQ(impact[i].doc_id, bm25[i].doc_id);
+        EXPECT_NEAR(impact[i].rank, bm25[i].rank, 0.01);
+    }
+
+    // У раскрытого шаблона импактов нет - они считаются на лету по тем же правилам
+    EXPECT_EQ(server.search_one("ra* common"), impact);
+
+    // Импакт растёт с частотой и не бывает нулевым
+    EXPECT_GE(QuantizeImpact(1, 8), 1u);
+    EXPECT_LT(QuantizeImpact(1, 16), QuantizeImpact(3, 16));
+    EXPECT_LE(QuantizeImpact(1000, 8), 255u);
+
+    // Без квантования индекса подсчёт импактами недоступен
+    InvertedIndex plain;
+    plain.UpdateDocumentBase(docs);
+    SearchServer plain_server(plain);
+    EXPECT_THROW(plain_server.SetRanking(Ranking::Impact), std::logic_error);
+    EXPECT_EQ(plain_server.GetRanking(), Ranking::Count);
+
+    // Максимум и нормировка по плотному массиву сумм
+    const vector<uint32_t> scores = {3, 9, 1, 4, 7, 2, 8, 6, 5, 9, 0};
+    EXPECT_EQ(MaxScore<uint32_t>(scores), 9u);
+    vector<float> ranks(scores.size());
+    NormalizeScores<uint32_t>(scores, 9u, ranks);
+    EXPECT_FLOAT_EQ(ranks[1], 1.0f);
+    EXPECT_FLOAT_EQ(ranks[4], 7.0f / 9.0f);
+}
+
+TEST(TestCaseSearchServer, TestImpactRankingAcrossSegments) {
+    vector<string> docs = {"rare filler"};
+    for (size_t i = 1; i < 1000; ++i) {
+        docs.push_back("filler common" + string(i % 3, ' ') + " filler");
+    }
+    InvertedIndex idx;
+    idx.SetImpactQuantization(8);
+    idx.SetSegmentPolicy(1, std::chrono::milliseconds(10000), 2);
+    idx.UpdateDocumentBase(docs);
+
+    // Тот же документ в новом маленьком сегменте
+    EXPECT_EQ(idx.AddDocuments(vector<string>{"rare filler", "rare rare filler filler"}), 1000u);
+    idx.Flush();
+    ASSERT_GE(idx.GetSnapshot()->segments.size(), 2u);
+
+    SearchServer server(idx);
+    auto check = [&] {
+        server.SetRanking(Ranking::Bm25);
+        const vector<RelativeIndex> bm25 = server.search_one("rare filler");
+        server.SetRanking(Ranking::Impact);
+        const vector<RelativeIndex> impact = server.search_one("rare filler");
+        ASSERT_EQ(impact.size(), 3u);
+        ASSERT_EQ(impact.size(), bm25.size());
+        for (size_t i = 0; i < impact.size(); ++i) {
+            EXPECT_EQ(impact[i].doc_id, bm25[i].doc_id);
+            EXPECT_NEAR(impact[i].rank, bm25[i].rank, 0.01);
+        }
+        // Одинаковые документы 0 и 1000 из разных сегментов получают одинаковый вклад
+        auto rank_of = [&](size_t doc_id) {
+            return std::find_if(impact.begin(), impact.end(), [&](const RelativeIndex& r) { return r.doc_id == doc_id; })->rank;
+        };
+        EXPECT_EQ(rank_of(0), rank_of(1000));
+    };
+    check();
+
+    // Новые сегменты и их слияние меняют статистику, но не порядок относительно BM25
+    for (size_t i = 0; i < 4; ++i) {
+        idx.AddDocuments(vector<string>{"filler rare common"});
+        idx.Flush();
+    }
+    idx.AddDocuments(vector<string>(50, "common"));
+    idx.Flush();
+    server.SetRanking(Ranking::Bm25);
+    const vector<RelativeIndex> bm25 = server.search_one("rare common");
+    server.SetRanking(Ranking::Impact);
+    const vector<RelativeIndex> impact = server.search_one("rare common");
+    ASSERT_EQ(impact.size(), bm25.size());
+    for (size_t i = 0; i < impact.size(); ++i) {
+        EXPECT_EQ(impact[i].doc_id, bm25[i].doc_id);
+    }
+}
+
+TEST(TestCaseSearchServer, TestScratchReuseAcrossThreadsAndConfigs) {
+    vector<string> docs;
+    std::mt19937 rng(5);
+    for (size_t i = 0; i < 3000; ++i) {
+        string text;
+        for (size_t w = rng() % 12 + 1; w > 0; --w) {
+            text += "w" + std::to_string(rng() % 60) + " ";
+        }
+        docs.push_back(text);
+    }
+    const vector<string> queries = {"w1", "w2 w3", "w1 w7 w9", "w5 w59", "w4*", "nothing", "w10 w11 w12 w13",
+                                    "w1 OR w2", "w3 AND NOT w4"};
+
+    InvertedIndex idx;
+    idx.SetImpactQuantization(16);
+    idx.UpdateDocumentBase(docs);
+    ShardedIndex sharded(3);
+    sharded.UpdateDocumentBase(docs);
+
+    // Одна формула - один сервер; эталон считается последовательно через search()
+    vector<std::unique_ptr<SearchServer>> servers;
+    vector<vector<vector<RelativeIndex>>> expected;
+    for (Ranking ranking : {Ranking::Count, Ranking::TfIdf, Ranking::Bm25, Ranking::Impact}) {
+        servers.push_back(std::make_unique<SearchServer>(idx));
+        servers.back()->SetRanking(ranking);
+        expected.push_back(servers.back()->search(queries));
+    }
+    for (Ranking ranking : {Ranking::TfIdf, Ranking::Bm25}) {
+        servers.push_back(std::make_unique<SearchServer>(sharded));
+        servers.back()->SetRanking(ranking);
+        servers.back()->SetResultsLimit(3);
+        expected.push_back(servers.back()->search(queries));
+    }
+
+    // Буферы потока общие для всех серверов с одним типом суммы (TfIdf и Bm25, один индекс и шарды):
+    // запросы вперемешку из нескольких потоков не должны видеть чужих остатков
+    std::atomic<size_t> mismatches{0};
+    vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t round = 0; round < 20; ++round) {
+                for (size_t k = 0; k < servers.size() * queries.size(); ++k) {
+                    const size_t server = (k + t + round) % servers.size();
+                    const size_t query = (k * 7 + t) % queries.size();
+                    if (servers[server]->search_one(queries[query]) != expected[server][query]) {
+                        ++mismatches;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(mismatches, 0u);
+
+    // В одном потоке: запрос между двумя формулами с одним типом суммы, затем повтор первой
+    for (size_t query = 0; query < queries.size(); ++query) {
+        EXPECT_EQ(servers[1]->search_one(queries[query]), expected[1][query]) << queries[query];
+        EXPECT_EQ(servers[2]->search_one(queries[query]), expected[2][query]) << queries[query];
+        EXPECT_EQ(servers[5]->search_one(queries[query]), expected[5][query]) << queries[query];
+        EXPECT_EQ(servers[1]->search_one(queries[query]), expected[1][query]) << queries[query];
+    }
+}
+
+TEST(TestCaseSearchServer, TestIntraQueryRanges) {
+    // Частоты различаются по документам, чтобы порядок задавали суммы, а не только номера
+    vector<string> docs;
+    for (size_t i = 0; i < 70000; ++i) {
+        string text = "alpha";
+        for (size_t k = 0; k < i % 5; ++k) {
+            text += " beta";
+        }
+        if (i % 7 == 0) {
+            text += " gamma alpha";
+        }
+        docs.push_back(text);
+    }
+    InvertedIndex idx;
+    idx.UpdateDocumentBase(docs);
+    SearchServer serial(idx);
+    SearchServer parallel(idx);
+    parallel.SetQueryThreads(4);
+
+    // Разбиение по диапазонам doc_id не меняет ни состав, ни порядок ответа
+    for (const string query : {"alpha", "alpha beta", "beta gamma", "alpha gamma"}) {
+        EXPECT_EQ(parallel.search_one(query), serial.search_one(query)) << query;
+    }
+    EXPECT_NE(parallel.explain("alpha beta").find("parallel: 3 doc ranges"), string::npos);
+    EXPECT_EQ(serial.explain("alpha beta").find("parallel"), string::npos);
+
+    // Лучшие документы каждого диапазона сливаются в общие лучшие
+    vector<RelativeIndex> top = serial.search_one("alpha beta");
+    top.resize(5);
+    parallel.SetResultsLimit(5);
+    EXPECT_EQ(parallel.search_one("alpha beta"), top);
+
+    // Удалённый документ не занимает место среди лучших
+    ASSERT_TRUE(idx.RemoveDocument(top[0].doc_id));
+    const vector<RelativeIndex> after = parallel.search_one("alpha beta");
+    ASSERT_EQ(after.size(), 5u);
+    EXPECT_EQ(after[0].doc_id, top[1].doc_id);
+
+    // Обход карты по диапазону задевает крайние контейнеры лишь частично
+    vector<uint32_t> values;
+    for (uint32_t v = 65000; v < 140000; v += 3) {
+        values.push_back(v);
+    }
+    const RoaringBitmap bitmap = RoaringBitmap::FromSorted(values);
+    vector<uint32_t> visited;
+    bitmap.ForEach(65530, 131100, [&](uint32_t v) { visited.push_back(v); });
+    ASSERT_FALSE(visited.empty());
+    EXPECT_EQ(visited.front(), 65531u);
+    EXPECT_EQ(visited.back(), 131099u);
+    EXPECT_EQ(visited.size(), bitmap.Rank(131101) - bitmap.Rank(65530));
+}
+
+TEST(TestCaseSearchServer, TestQueryThreadPool) {
+    // Вложенные задачи (шарды -> диапазоны) выполняются и тогда, когда все потоки пула заняты
+    ThreadPool pool(2);
+    std::atomic<size_t> calls{0};
+    std::atomic<size_t> max_running{0};
+    std::atomic<size_t> running{0};
+    pool.ParallelFor(4, 3, [&](size_t) {
+        pool.ParallelFor(8, 3, [&](size_t) {
+            const size_t now = ++running;
+            size_t seen = max_running;
+            while (now > seen && !max_running.compare_exchange_weak(seen, now)) {
+            }
+            ++calls;
+            --running;
+        });
+    });
+    EXPECT_EQ(calls, 32u);
+    EXPECT_LE(max_running, 3u); // вызывающий поток и два потока пула
+
+    // Исключение задачи доходит до вызывающего потока, пул остаётся рабочим
+    EXPECT_THROW(pool.ParallelFor(16, 3, [](size_t i) {
+        if (i == 5) {
+            throw std::runtime_error("task failed");
+        }
+    }), std::runtime_error);
+    calls = 0;
+    pool.ParallelFor(10, 3, [&](size_t) { ++calls; });
+    EXPECT_EQ(calls, 10u);
+}
+
+TEST(TestCaseSearchServer, TestShardedIndexMatchesSingleIndex) {
+    vector<string> docs;
+    for (size_t i = 0; i < 200; ++i) {
+        string text = "city";
+        for (size_t k = 0; k < i % 4; ++k) {
+            text += " river";
+        }
+        text += i % 3 == 0 ? " bridge tower" : " park";
+        if (i % 11 == 0) {
+            text += " museum museum";
+        }
+        docs.push_back(text);
+    }
+    InvertedIndex single;
+    single.UpdateDocumentBase(docs);
+    ShardedIndex sharded(3);
+    IndexingProgress last;
+    size_t reports = 0;
+    sharded.SetProgressCallback([&](const IndexingProgress& progress) {
+        last = progress;
+        ++reports;
+    }, std::chrono::milliseconds(0));
+    sharded.UpdateDocumentBase(docs);
+    EXPECT_EQ(sharded.GetShardCount(), 3u);
+
+    // Ход сборки суммируется по шардам; последний отчёт - итоговый
+    EXPECT_GT(reports, 1u);
+    EXPECT_TRUE(last.finished);
+    EXPECT_EQ(last.docs_done, docs.size());
+    EXPECT_EQ(last.docs_total, docs.size());
+    EXPECT_GT(last.terms, 0u);
+
+    // Документ 4 - во втором шарде под номером 1
+    EXPECT_EQ(sharded.GlobalDocId(1, 1), 4u);
+    EXPECT_EQ(sharded.GetWordCount("museum"), single.GetWordCount("museum"));
+
+    // Веса слов считаются по всем шардам - ответы совпадают при любой формуле
+    SearchServer single_server(single);
+    SearchServer sharded_server(sharded);
+    const vector<string> queries = {"river", "city river", "museum river", "bridge park", "tower OR museum",
+                                    "riv*", "city AND NOT park"};
+    for (Ranking ranking : {Ranking::Count, Ranking::TfIdf, Ranking::Bm25}) {
+        single_server.SetRanking(ranking);
+        sharded_server.SetRanking(ranking);
+        for (const string& query : queries) {
+            EXPECT_EQ(sharded_server.search_one(query), single_server.search_one(query)) << query;
+        }
+    }
+    EXPECT_NE(sharded_server.explain("city river").find("shard 2:"), string::npos);
+
+    // Импакты зависят только от частоты, а idf считается по всем шардам - Ranking::Impact тоже совпадает
+    InvertedIndex single_impacts;
+    single_impacts.SetImpactQuantization(8);
+    single_impacts.UpdateDocumentBase(docs);
+    ShardedIndex sharded_impacts(3);
+    sharded_impacts.SetImpactQuantization(8);
+    sharded_impacts.UpdateDocumentBase(docs);
+    SearchServer single_impact_server(single_impacts);
+    SearchServer sharded_impact_server(sharded_impacts);
+    single_impact_server.SetRanking(Ranking::Impact);
+    sharded_impact_server.SetRanking(Ranking::Impact);
+    for (const string query : {"river", "city river", "museum river", "bridge park", "riv*"}) {
+        EXPECT_EQ(sharded_impact_server.search_one(query), single_impact_server.search_one(query)) << query;
+    }
+
+    // Лучшие документы шардов сливаются в общие лучшие
+    single_server.SetResultsLimit(5);
+    sharded_server.SetResultsLimit(5);
+    EXPECT_EQ(sharded_server.search_one("museum river"), single_server.search_one("museum river"));
+
+    // Добавление и удаление идут в тот шард, которому принадлежит общий номер
+    EXPECT_EQ(sharded.AddDocuments({"museum museum museum river"}), 200u);
+    single.AddDocuments({"museum museum museum river"});
+    sharded.Flush();
+    single.Flush();
+    EXPECT_TRUE(sharded.RemoveDocument(0));
+    EXPECT_TRUE(single.RemoveDocument(0));
+    EXPECT_FALSE(sharded.RemoveDocument(1000));
+    EXPECT_EQ(sharded_server.search_one("museum"), single_server.search_one("museum"));
+    EXPECT_EQ(sharded_server.search_one("museum")[0].doc_id, 200u);
+
+    // После запроса (в том числе без ответа) снимки не остаются в буферах потока
+    std::weak_ptr<const IndexSnapshot> old_snapshot = single.GetSnapshot();
+    single_server.search_one("museum");
+    single_server.search_one("nothing");
+    single.UpdateDocumentBase(docs);
+    EXPECT_TRUE(old_snapshot.expired());
+}